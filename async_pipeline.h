@@ -0,0 +1,698 @@
+#ifndef ASYNC_PIPELINE_H
+#define ASYNC_PIPELINE_H
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "elements.h"
+#include "element_container.h"
+#include "parallel_visit.h"
+#include "thread_pool.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Coroutine visitor pipeline
+//
+// Elements which arrive over time, from a socket or a file, are
+// decoded, visited and published in overlapping stages rather than
+// loaded in full before a single Accept:
+//
+//     source --> Channel<ElementBatch> --> VisitBatches --> Channel<BatchResult<Visitor>> --> publisher
+//
+// Each stage is a C++20 coroutine (PipelineTask) run by a
+// CoroutineScheduler on the calling thread. Blocking work, the reads
+// of the source and the Accept of each batch, is handed to a
+// ThreadPool with co_await Offload, and the coroutine is resumed on
+// the scheduler once it is done, so the next batch is decoded while
+// the previous ones are being visited:
+//
+//     CoroutineScheduler scheduler;
+//     Channel<ElementBatch> batches(scheduler, 4);
+//     Channel<BatchResult<SumVisitor>> results(scheduler, 4);
+//
+//     scheduler.Spawn(ReadBatches(scheduler, pool, source, batches));
+//     scheduler.Spawn(VisitBatches(scheduler, pool, batches, sum_visitor, results));
+//     scheduler.Spawn(MergeBatchResults(results, sum_visitor));
+//     scheduler.Run();
+//
+// Channels are bounded: a stage pushing into a full channel waits
+// until the next stage has taken a value, so at most the capacity of
+// each channel is held in memory however fast the source is.
+//
+// The stages reuse the visitors unchanged. Each batch is visited by a
+// clone of the visitor, as for ParallelAccept, and several VisitBatches
+// can share one channel of batches to visit them concurrently.
+// MergeBatchResults merges the partial results in batch order, so the
+// result does not depend on the scheduling.
+//
+// All coroutines are resumed on the thread running the scheduler, so
+// channels need no locking; only Offload runs code on other threads.
+//////////////////////////////////////////////////////////////////////
+
+class CoroutineScheduler;
+
+
+// Coroutine type of the pipeline stages. A task is started by
+// CoroutineScheduler::Spawn and runs until it returns; tasks cannot be
+// awaited by other tasks.
+class PipelineTask
+{
+
+public:
+
+    struct promise_type
+    {
+        CoroutineScheduler *scheduler = nullptr;
+
+        PipelineTask get_return_object()
+        {
+            return PipelineTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept
+            {
+                return false;
+            }
+
+            // Defined after CoroutineScheduler
+            void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+
+            void await_resume() noexcept
+            {
+            }
+        };
+
+        FinalAwaiter final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+            error = std::current_exception();
+        }
+
+        std::exception_ptr error;
+    };
+
+    PipelineTask(PipelineTask &&other) noexcept
+        : handle(std::exchange(other.handle, nullptr))
+    {
+    }
+
+    PipelineTask(const PipelineTask&) = delete;
+    PipelineTask& operator=(const PipelineTask&) = delete;
+    PipelineTask& operator=(PipelineTask&&) = delete;
+
+    // A task which was never spawned is destroyed unstarted
+    ~PipelineTask()
+    {
+        if(handle)
+        {
+            handle.destroy();
+        }
+    }
+
+private:
+
+    friend class CoroutineScheduler;
+
+    explicit PipelineTask(std::coroutine_handle<promise_type> handle)
+        : handle(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle;
+
+};
+
+
+class CoroutineScheduler
+{
+
+public:
+
+    CoroutineScheduler()
+        : active{0}
+        , pending{0}
+    {
+    }
+
+    CoroutineScheduler(const CoroutineScheduler&) = delete;
+    CoroutineScheduler& operator=(const CoroutineScheduler&) = delete;
+
+    // Tasks still suspended, after a failure, are destroyed unfinished
+    ~CoroutineScheduler()
+    {
+        for(std::coroutine_handle<PipelineTask::promise_type> task : tasks)
+        {
+            task.destroy();
+        }
+    }
+
+    // Take the task over and queue it to start when Run is called
+    void Spawn(PipelineTask task)
+    {
+        std::coroutine_handle<PipelineTask::promise_type> handle = std::exchange(task.handle, nullptr);
+
+        handle.promise().scheduler = this;
+        tasks.push_back(handle);
+        ++ active;
+
+        Schedule(handle);
+    }
+
+    // Resume the spawned tasks until every one has returned. The first
+    // exception thrown by a task is rethrown, once the work it left on
+    // a pool has completed, and the other tasks are not resumed again.
+    // Throws std::runtime_error if every remaining task is waiting on a
+    // channel which no task will ever push to or pop from.
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while(active > 0 && !error)
+        {
+            condition.wait(lock, [this]() { return !ready.empty() || pending == 0; });
+
+            if(ready.empty())
+            {
+                throw std::runtime_error("Error: every pipeline task is waiting on a channel");
+            }
+
+            std::coroutine_handle<> handle = ready.front();
+            ready.pop_front();
+
+            lock.unlock();
+            handle.resume();
+            lock.lock();
+        }
+
+        if(error)
+        {
+            condition.wait(lock, [this]() { return pending == 0; });
+            ready.clear();
+
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+    }
+
+    // Queue a suspended coroutine to be resumed by Run. Safe to call
+    // from any thread.
+    void Schedule(std::coroutine_handle<> handle)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        ready.push_back(handle);
+        condition.notify_one();
+    }
+
+private:
+
+    friend struct PipelineTask::promise_type::FinalAwaiter;
+
+    template<typename Function>
+    friend class OffloadAwaiter;
+
+    void Finish(PipelineTask::promise_type &promise)
+    {
+        -- active;
+
+        if(promise.error && !error)
+        {
+            error = promise.error;
+        }
+    }
+
+    // Work handed to another thread, whose coroutine is resumed by
+    // CompleteOffload
+    void BeginOffload()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++ pending;
+    }
+
+    // Notified under the lock, since Run may return, and the scheduler
+    // be destroyed, as soon as the lock is released
+    void CompleteOffload(std::coroutine_handle<> handle)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        ready.push_back(handle);
+        -- pending;
+        condition.notify_one();
+    }
+
+    std::vector<std::coroutine_handle<PipelineTask::promise_type>> tasks;
+    std::deque<std::coroutine_handle<>> ready;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::size_t active;                 // tasks which have not returned
+    std::size_t pending;                // offloaded calls not yet complete
+    std::exception_ptr error;
+
+};
+
+
+inline void PipelineTask::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+{
+    // The frame is kept until the scheduler is destroyed
+    handle.promise().scheduler->Finish(handle.promise());
+}
+
+
+// Awaitable running a function on a ThreadPool, which resumes the
+// awaiting coroutine on its scheduler with the function's result, or
+// rethrows its exception
+template<typename Function>
+class OffloadAwaiter
+{
+
+public:
+
+    using Result = std::invoke_result_t<Function&>;
+
+    OffloadAwaiter(CoroutineScheduler &scheduler, ThreadPool &pool, Function function)
+        : scheduler(scheduler)
+        , pool(pool)
+        , function(std::move(function))
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        scheduler.BeginOffload();
+
+        pool.Submit(
+            [this, handle]()
+            {
+                try
+                {
+                    if constexpr(std::is_void_v<Result>)
+                    {
+                        function();
+                    }
+                    else
+                    {
+                        result.emplace(function());
+                    }
+                }
+                catch(...)
+                {
+                    error = std::current_exception();
+                }
+
+                // The awaiter may be gone as soon as this returns
+                scheduler.CompleteOffload(handle);
+            });
+    }
+
+    Result await_resume()
+    {
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+
+        if constexpr(!std::is_void_v<Result>)
+        {
+            return std::move(*result);
+        }
+    }
+
+private:
+
+    using Storage = std::conditional_t<std::is_void_v<Result>, bool, Result>;
+
+    CoroutineScheduler &scheduler;
+    ThreadPool &pool;
+    Function function;
+    std::optional<Storage> result;
+    std::exception_ptr error;
+
+};
+
+// co_await Offload(scheduler, pool, function) runs function on the pool
+// and gives its result
+template<typename Function>
+OffloadAwaiter<Function> Offload(CoroutineScheduler &scheduler, ThreadPool &pool, Function function)
+{
+    return OffloadAwaiter<Function>(scheduler, pool, std::move(function));
+}
+
+
+// Bounded queue between pipeline stages, used by the coroutines of one
+// scheduler:
+//
+//     co_await channel.Push(value);                    // waits while full
+//     std::optional<T> value = co_await channel.Pop(); // waits while empty
+//
+// Pop gives std::nullopt once every producer has called Close and the
+// values left have been taken. Values are handed over in the order
+// they were pushed, and waiting coroutines are resumed in the order
+// they started waiting.
+template<typename T>
+class Channel
+{
+
+public:
+
+    Channel(CoroutineScheduler &scheduler, std::size_t capacity, std::size_t producer_count = 1)
+        : scheduler(scheduler)
+        , capacity(capacity)
+        , open_producers(producer_count)
+    {
+        if(capacity == 0)
+        {
+            throw std::invalid_argument("Error: a channel needs a capacity of at least one value");
+        }
+    }
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    class PushAwaiter
+    {
+
+    public:
+
+        PushAwaiter(Channel &channel, T value)
+            : channel(channel)
+            , value(std::move(value))
+        {
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        // Hand the value to a waiting consumer, or queue it if there is
+        // room, and otherwise wait for a consumer to take it
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            if(channel.IsClosed())
+            {
+                throw std::logic_error("Error: push to a closed channel");
+            }
+
+            if(!channel.poppers.empty())
+            {
+                PopAwaiter *popper = channel.poppers.front();
+                channel.poppers.pop_front();
+
+                popper->value.emplace(std::move(value));
+                channel.scheduler.Schedule(popper->handle);
+
+                return false;
+            }
+
+            if(channel.values.size() < channel.capacity)
+            {
+                channel.values.push_back(std::move(value));
+
+                return false;
+            }
+
+            this->handle = handle;
+            channel.pushers.push_back(this);
+
+            return true;
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+
+    private:
+
+        friend class Channel;
+
+        Channel &channel;
+        T value;
+        std::coroutine_handle<> handle;
+
+    };
+
+    class PopAwaiter
+    {
+
+    public:
+
+        explicit PopAwaiter(Channel &channel)
+            : channel(channel)
+        {
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        // Take the first value, moving a waiting producer's value into
+        // the room it leaves, or wait for one
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            if(!channel.values.empty())
+            {
+                value.emplace(std::move(channel.values.front()));
+                channel.values.pop_front();
+
+                if(!channel.pushers.empty())
+                {
+                    PushAwaiter *pusher = channel.pushers.front();
+                    channel.pushers.pop_front();
+
+                    channel.values.push_back(std::move(pusher->value));
+                    channel.scheduler.Schedule(pusher->handle);
+                }
+
+                return false;
+            }
+
+            if(channel.IsClosed())
+            {
+                return false;
+            }
+
+            this->handle = handle;
+            channel.poppers.push_back(this);
+
+            return true;
+        }
+
+        std::optional<T> await_resume()
+        {
+            return std::move(value);
+        }
+
+    private:
+
+        friend class Channel;
+
+        Channel &channel;
+        std::optional<T> value;
+        std::coroutine_handle<> handle;
+
+    };
+
+    PushAwaiter Push(T value)
+    {
+        return PushAwaiter(*this, std::move(value));
+    }
+
+    PopAwaiter Pop()
+    {
+        return PopAwaiter(*this);
+    }
+
+    // Called by each producer once it has pushed its last value. When
+    // the last producer closes the channel, the consumers waiting on
+    // it are resumed with std::nullopt.
+    void Close()
+    {
+        if(open_producers == 0)
+        {
+            throw std::logic_error("Error: channel closed more times than it has producers");
+        }
+
+        if(-- open_producers == 0)
+        {
+            for(PopAwaiter *popper : poppers)
+            {
+                scheduler.Schedule(popper->handle);
+            }
+
+            poppers.clear();
+        }
+    }
+
+    bool IsClosed() const
+    {
+        return open_producers == 0;
+    }
+
+    // Number of values queued
+    std::size_t Size() const
+    {
+        return values.size();
+    }
+
+    std::size_t Capacity() const
+    {
+        return capacity;
+    }
+
+private:
+
+    CoroutineScheduler &scheduler;
+    std::size_t capacity;
+    std::size_t open_producers;
+
+    std::deque<T> values;
+    std::deque<PushAwaiter*> pushers;   // producers waiting for room
+    std::deque<PopAwaiter*> poppers;    // consumers waiting for a value
+
+};
+
+
+// A batch of elements decoded by the source, numbered from zero in the
+// order it was read. The container is shared, so one batch can be
+// pushed to several stages.
+struct ElementBatch
+{
+    std::size_t sequence;
+    std::shared_ptr<const ElementContainer> elements;
+};
+
+// Result of visiting one batch: a clone of the visitor holding the
+// batch's partial result, to be merged into the caller's visitor
+template<typename Visitor>
+struct BatchResult
+{
+    std::size_t sequence;
+    Visitor visitor;
+    VisitResult result;
+};
+
+
+// Source stage. source is called on the pool until it returns
+// std::nullopt, and may block, for example on a socket; each batch it
+// returns is pushed to every one of outputs, which are then closed.
+// A batch is only read once the slowest output has room for it.
+template<typename Source>
+PipelineTask ReadBatches(CoroutineScheduler &scheduler, ThreadPool &pool, Source source,
+    std::vector<Channel<ElementBatch>*> outputs)
+{
+    for(std::size_t sequence = 0; ; ++ sequence)
+    {
+        std::optional<ElementContainer> elements =
+            co_await Offload(scheduler, pool, [&source]() -> std::optional<ElementContainer> { return source(); });
+
+        if(!elements)
+        {
+            break;
+        }
+
+        const ElementBatch batch{sequence, std::make_shared<const ElementContainer>(std::move(*elements))};
+
+        for(Channel<ElementBatch> *output : outputs)
+        {
+            co_await output->Push(batch);
+        }
+    }
+
+    for(Channel<ElementBatch> *output : outputs)
+    {
+        output->Close();
+    }
+}
+
+template<typename Source>
+PipelineTask ReadBatches(CoroutineScheduler &scheduler, ThreadPool &pool, Source source,
+    Channel<ElementBatch> &output)
+{
+    return ReadBatches(scheduler, pool, std::move(source), std::vector<Channel<ElementBatch>*>{&output});
+}
+
+// Visitor stage. Each batch taken from input is visited on the pool by
+// a clone of visitor, which is pushed to results. visitor itself is
+// only copied, and results is closed once input is. Several stages can
+// take their batches from one input and push to one results channel,
+// opened with one producer per stage.
+template<MergeableVisitor Visitor>
+PipelineTask VisitBatches(CoroutineScheduler &scheduler, ThreadPool &pool, Channel<ElementBatch> &input,
+    const Visitor &visitor, Channel<BatchResult<Visitor>> &results)
+{
+    while(std::optional<ElementBatch> batch = co_await input.Pop())
+    {
+        BatchResult<Visitor> partial{batch->sequence, detail::CloneVisitor(visitor), VisitResult{}};
+
+        partial.result = co_await Offload(scheduler, pool,
+            [&partial, &batch]() { return batch->elements->Accept(partial.visitor); });
+
+        co_await results.Push(std::move(partial));
+    }
+
+    results.Close();
+}
+
+// Publisher stage which merges every batch result into visitor, in
+// batch order whatever order the results arrive in, and adds up the
+// visited and skipped counts into result if given
+template<MergeableVisitor Visitor>
+PipelineTask MergeBatchResults(Channel<BatchResult<Visitor>> &results, Visitor &visitor, VisitResult *result = nullptr)
+{
+    std::map<std::size_t, BatchResult<Visitor>> early;
+    std::size_t next = 0;
+
+    while(std::optional<BatchResult<Visitor>> partial = co_await results.Pop())
+    {
+        early.emplace(partial->sequence, std::move(*partial));
+
+        auto first = early.begin();
+
+        while(first != early.end() && first->first == next)
+        {
+            visitor.Merge(first->second.visitor);
+
+            if(result != nullptr)
+            {
+                result->Merge(first->second.result);
+            }
+
+            first = early.erase(first);
+            ++ next;
+        }
+    }
+}
+
+#endif // ASYNC_PIPELINE_H
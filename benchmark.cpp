@@ -0,0 +1,1447 @@
+// Benchmarks comparing the classic (virtual) dispatch engine with the
+// static (std::variant) dispatch engine.
+//
+// Both engines visit the same mixed batch of SingleElement and small
+// ArrayElement values, which is the case where the dispatch overhead
+// rather than the reduction itself dominates.
+//
+// The BM_Matrix benchmarks cover every visitor and element type
+// combination, for node-based (std::list) and contiguous (std::vector)
+// storage and for both engines. They are named
+//
+//     BM_Matrix/<Visitor>/<Element>/<Storage>/<Dispatch>/<values>
+//
+// and report time/element alongside the payload bandwidth. The number
+// of payload values goes from 1 up to BENCHMARK_MAX_VALUES in powers
+// of 10; build with -DBENCHMARK_MAX_VALUES=100000000 for the full range,
+// which needs several GB of memory for the node-based storage.
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+#include <numeric>
+#include <string>
+#include <algorithm>
+
+#include "elements.h"
+#include "visitors.h"
+#include "variant_visitors.h"
+#include "element_container.h"
+#include "fused_visitor.h"
+#include "parallel_visit.h"
+#include "work_stealing.h"
+#include "element_file.h"
+#include "string_stream.h"
+#include "cached_visit.h"
+#include "live_aggregate.h"
+#include "checksum_visitors.h"
+#include "async_pipeline.h"
+#include "streaming_workers.h"
+#include "type_list_visitor.h"
+#include "shard_visit.h"
+
+
+#ifndef BENCHMARK_MAX_VALUES
+#define BENCHMARK_MAX_VALUES 1000000
+#endif
+
+
+namespace
+{
+
+// Every second element is a SingleElement and the remainder are small
+// ArrayElement values, so that the branch on the element type is not
+// trivially predictable
+std::vector<Element> MakeElements(std::size_t count)
+{
+    std::vector<Element> elements;
+    elements.reserve(count);
+
+    for(std::size_t i = 0; i < count; ++ i)
+    {
+        double v = static_cast<double>(i % 10);
+
+        if(i % 2 == 0)
+        {
+            elements.emplace_back(SingleElement(v));
+        }
+        else
+        {
+            elements.emplace_back(ArrayElement({v, v + 1.0, v + 2.0}));
+        }
+    }
+
+    return elements;
+}
+
+std::vector<std::unique_ptr<AbstractElement>> MakeAbstractElements(std::size_t count)
+{
+    std::vector<std::unique_ptr<AbstractElement>> elements;
+    elements.reserve(count);
+
+    for(const Element &element : MakeElements(count))
+    {
+        std::visit(
+            [&elements](const auto &concrete)
+            {
+                using T = std::decay_t<decltype(concrete)>;
+                elements.push_back(std::make_unique<T>(concrete));
+            },
+            element);
+    }
+
+    return elements;
+}
+
+
+template<typename Visitor>
+void BM_VirtualDispatch(benchmark::State &state)
+{
+    auto elements = MakeAbstractElements(state.range(0));
+
+    Visitor visitor;
+
+    for(auto _ : state)
+    {
+        visitor.Reset();
+
+        for(auto &element : elements)
+        {
+            element->Accept(visitor);
+        }
+
+        benchmark::DoNotOptimize(visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// The same elements in an ElementSequence, each dispatched through the
+// adapter's generated table
+template<typename Visitor>
+void BM_TypeListDispatch(benchmark::State &state)
+{
+    ElementSequence<BuiltinElementList> sequence;
+
+    for(const Element &element : MakeElements(state.range(0)))
+    {
+        std::visit([&sequence](const auto &concrete) { sequence.Add(concrete); }, element);
+    }
+
+    Visitor visitor;
+    ClassicVisitorAdapter<Visitor, BuiltinElementList> adapter(visitor);
+
+    for(auto _ : state)
+    {
+        visitor.Reset();
+
+        sequence.Accept(adapter);
+
+        benchmark::DoNotOptimize(visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename Visitor>
+void BM_VariantDispatch(benchmark::State &state)
+{
+    auto elements = MakeElements(state.range(0));
+
+    Visitor visitor;
+
+    for(auto _ : state)
+    {
+        visitor.Reset();
+
+        VisitAll(elements, visitor);
+
+        benchmark::DoNotOptimize(visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+
+// Array reduction kernels, in Strict and Reassociate mode
+template<ReductionMode mode>
+void BM_SumKernel(benchmark::State &state)
+{
+    std::vector<double> values(state.range(0));
+    std::iota(values.begin(), values.end(), 1.0);
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(kernels::Sum(values, mode));
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(double));
+    state.SetLabel(mode == ReductionMode::Strict ? "strict" : kernels::GetInstructionSetName());
+}
+
+// A large array summed with each summation policy of BasicSumVisitor.
+// The values span many magnitudes and cancel, and the relative error
+// against the exact sum (ReproducibleSummation) is reported.
+template<typename Policy>
+void BM_SumPolicy(benchmark::State &state)
+{
+    std::vector<double> values(state.range(0));
+
+    for(std::size_t i = 0; i < values.size(); ++ i)
+    {
+        double magnitude = static_cast<double>(1 << (i % 24));
+
+        values[i] = (i % 2 == 0 ? magnitude : -0.999 * magnitude) + 0.1 * static_cast<double>(i % 7);
+    }
+
+    BasicSumVisitor<Policy> sum_visitor(ReductionMode::Reassociate);
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+        sum_visitor.ProcessArrayView(values);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    BasicSumVisitor<ReproducibleSummation> exact_visitor;
+    exact_visitor.ProcessArrayView(values);
+
+    const double exact = exact_visitor.GetValue();
+
+    state.counters["relative_error"] = std::abs(sum_visitor.GetValue() - exact) / std::abs(exact);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(double));
+}
+
+template<ReductionMode mode>
+void BM_ProductKernel(benchmark::State &state)
+{
+    std::vector<double> values(state.range(0), 1.0);
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(kernels::Product(values, mode));
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(double));
+    state.SetLabel(mode == ReductionMode::Strict ? "strict" : kernels::GetInstructionSetName());
+}
+
+// A large array multiplied with each product policy of
+// BasicMultiplyVisitor. The factors are spread around 1, so the
+// naive product only stays in range by construction.
+template<typename Policy, ReductionMode mode>
+void BM_ProductPolicy(benchmark::State &state)
+{
+    std::vector<double> values(state.range(0));
+
+    for(std::size_t i = 0; i < values.size(); ++ i)
+    {
+        values[i] = i % 2 == 0 ? 1.0 + 1e-3 * static_cast<double>(i % 5) : 1.0 / (1.0 + 1e-3 * static_cast<double>((i - 1) % 5));
+    }
+
+    BasicMultiplyVisitor<Policy> multiply_visitor(mode);
+
+    for(auto _ : state)
+    {
+        multiply_visitor.Reset();
+        multiply_visitor.ProcessArrayView(values);
+
+        benchmark::DoNotOptimize(multiply_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(double));
+    state.SetLabel(mode == ReductionMode::Strict ? "strict" : kernels::GetInstructionSetName());
+}
+
+// A SumVisitor over a typed array in Reassociate mode. The float and
+// int32_t arrays move half the bytes of the double array of the same
+// length, and the integer arrays are summed exactly.
+template<typename T>
+void BM_TypedArraySum(benchmark::State &state)
+{
+    std::vector<T> values(state.range(0));
+
+    for(std::size_t i = 0; i < values.size(); ++ i)
+    {
+        values[i] = static_cast<T>(i % 100);
+    }
+
+    BasicArrayElement<T> element{std::span<const T>(values)};
+    SumVisitor sum_visitor(ReductionMode::Reassociate);
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+        element.Accept(sum_visitor);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(T));
+}
+
+
+// String kernels over a payload of mixed text and digits
+std::string MakeText(std::size_t size)
+{
+    std::string text(size, ' ');
+
+    for(std::size_t i = 0; i < size; ++ i)
+    {
+        text[i] = (i % 3 == 0) ? static_cast<char>('0' + i % 10) : static_cast<char>('a' + i % 26);
+    }
+
+    return text;
+}
+
+// Visits of the same strings, of range(0) bytes each, scanned on every
+// visit or read from their digit index
+template<bool indexed>
+void BM_StringRevisit(benchmark::State &state)
+{
+    std::vector<StringElement> strings;
+
+    for(int i = 0; i < 16; ++ i)
+    {
+        strings.emplace_back(MakeText(state.range(0)));
+        strings.back().EnableDigitIndex(indexed);
+    }
+
+    SumVisitor sum_visitor;
+    XORVisitor xor_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+        xor_visitor.Reset();
+
+        for(StringElement &element : strings)
+        {
+            element.Accept(sum_visitor);
+            element.Accept(xor_visitor);
+        }
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+        benchmark::DoNotOptimize(xor_visitor.GetValue());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<std::int64_t>(strings.size()));
+}
+
+void BM_DigitSumKernel(benchmark::State &state)
+{
+    std::string text = MakeText(state.range(0));
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(kernels::DigitSum(text));
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    state.SetLabel(kernels::GetInstructionSetName());
+}
+
+void BM_DigitProductKernel(benchmark::State &state)
+{
+    std::string text = MakeText(state.range(0));
+
+    // Without a '0' digit the product would not stop early
+    std::replace(text.begin(), text.end(), '0', '2');
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(kernels::DigitProduct(text));
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    state.SetLabel(kernels::GetInstructionSetName());
+}
+
+void BM_XorChecksumKernel(benchmark::State &state)
+{
+    std::string text = MakeText(state.range(0));
+
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(kernels::XorChecksum(text));
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    state.SetLabel(kernels::GetInstructionSetName());
+}
+
+
+// The wider checksums over the same text as BM_XorChecksumKernel
+template<typename Visitor>
+void BM_ChecksumVisitor(benchmark::State &state)
+{
+    std::string text = MakeText(state.range(0));
+
+    Visitor visitor;
+
+    for(auto _ : state)
+    {
+        visitor.Reset();
+        visitor.ProcessStringView(text);
+
+        benchmark::DoNotOptimize(visitor.GetValue());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    state.SetLabel(kernels::GetInstructionSetName());
+}
+
+// A digit sum with a CRC32C and an XXH64 of a container of strings,
+// with one traversal per visitor or one fused traversal
+ElementContainer MakeStringContainer(std::size_t byte_count)
+{
+    ElementContainer container;
+
+    for(std::size_t i = 0; i < 256; ++ i)
+    {
+        container.Add(StringElement(MakeText(byte_count / 256)));
+    }
+
+    return container;
+}
+
+void BM_SeparateChecksums(benchmark::State &state)
+{
+    ElementContainer container = MakeStringContainer(state.range(0));
+
+    SumVisitor sum_visitor;
+    Crc32cVisitor crc_visitor;
+    Xxh64Visitor xxh_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+        crc_visitor.Reset();
+        xxh_visitor.Reset();
+
+        container.Accept(sum_visitor);
+        container.Accept(crc_visitor);
+        container.Accept(xxh_visitor);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+        benchmark::DoNotOptimize(crc_visitor.GetValue());
+        benchmark::DoNotOptimize(xxh_visitor.GetValue());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_FusedChecksums(benchmark::State &state)
+{
+    ElementContainer container = MakeStringContainer(state.range(0));
+
+    SumVisitor sum_visitor;
+    Crc32cVisitor crc_visitor;
+    Xxh64Visitor xxh_visitor;
+    FusedVisitor fused_visitor(sum_visitor, crc_visitor, xxh_visitor);
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+        crc_visitor.Reset();
+        xxh_visitor.Reset();
+
+        container.Accept(fused_visitor);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+        benchmark::DoNotOptimize(crc_visitor.GetValue());
+        benchmark::DoNotOptimize(xxh_visitor.GetValue());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// Sum and product of a container of large arrays, with one traversal
+// per visitor or one fused traversal
+ElementContainer MakeArrayContainer(std::size_t value_count)
+{
+    ElementContainer container;
+
+    for(std::size_t i = 0; i < 16; ++ i)
+    {
+        container.Add(ArrayElement(std::pmr::vector<double>(value_count / 16, 1.0)));
+    }
+
+    return container;
+}
+
+void BM_SeparateTraversals(benchmark::State &state)
+{
+    ElementContainer container = MakeArrayContainer(state.range(0));
+
+    SumVisitor sum_visitor(ReductionMode::Reassociate);
+    MultiplyVisitor multiply_visitor(ReductionMode::Reassociate);
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+        multiply_visitor.Reset();
+
+        container.Accept(sum_visitor);
+        container.Accept(multiply_visitor);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+        benchmark::DoNotOptimize(multiply_visitor.GetValue());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(double));
+}
+
+void BM_FusedTraversal(benchmark::State &state)
+{
+    ElementContainer container = MakeArrayContainer(state.range(0));
+
+    SumVisitor sum_visitor(ReductionMode::Reassociate);
+    MultiplyVisitor multiply_visitor(ReductionMode::Reassociate);
+    FusedVisitor fused_visitor(sum_visitor, multiply_visitor);
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+        multiply_visitor.Reset();
+
+        container.Accept(fused_visitor);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+        benchmark::DoNotOptimize(multiply_visitor.GetValue());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(double));
+}
+
+
+// Sum of a container of singles and small arrays on a pool of a given
+// number of threads, to show how ParallelAccept scales
+ElementContainer MakeMixedContainer(std::size_t element_count)
+{
+    ElementContainer container;
+
+    for(std::size_t i = 0; i < element_count; ++ i)
+    {
+        double v = static_cast<double>(i % 10);
+
+        if(i % 2 == 0)
+        {
+            container.Add(SingleElement(v));
+        }
+        else
+        {
+            container.Add(ArrayElement({v, v + 1.0, v + 2.0, v + 3.0}));
+        }
+    }
+
+    return container;
+}
+
+void BM_ParallelAccept(benchmark::State &state)
+{
+    ElementContainer container = MakeMixedContainer(state.range(0));
+    ThreadPool pool(state.range(1));
+
+    SumVisitor sum_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        ParallelAccept(container, sum_visitor, pool);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(std::to_string(state.range(1)) + " threads");
+}
+
+
+// A few huge arrays among a great many singles. ParallelAccept hands
+// each chunk of elements to one thread whatever its payload, so the
+// thread which gets a huge array holds up the others, while
+// WorkStealingAccept splits the arrays and balances on bytes.
+ElementContainer MakeSkewedContainer(std::size_t single_count, std::size_t huge_array_count)
+{
+    ElementContainer container;
+
+    for(std::size_t i = 0; i < single_count; ++ i)
+    {
+        container.Add(SingleElement(static_cast<double>(i % 10)));
+    }
+
+    for(std::size_t i = 0; i < huge_array_count; ++ i)
+    {
+        container.Add(ArrayElement(std::vector<double>(1 << 22, 1.0)));
+    }
+
+    return container;
+}
+
+void BM_SkewedParallelAccept(benchmark::State &state)
+{
+    static const ElementContainer container = MakeSkewedContainer(1 << 22, 4);
+    ThreadPool pool(state.range(0));
+
+    SumVisitor sum_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        ParallelAccept(container, sum_visitor, pool);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * container.Size());
+    state.SetLabel(std::to_string(state.range(0)) + " threads");
+}
+
+void BM_SkewedWorkStealingAccept(benchmark::State &state)
+{
+    static const ElementContainer container = MakeSkewedContainer(1 << 22, 4);
+    WorkStealingScheduler scheduler(state.range(0));
+
+    SumVisitor sum_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        WorkStealingAccept(container, sum_visitor, scheduler);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * container.Size());
+    state.SetLabel(std::to_string(state.range(0)) + " threads");
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Visitor x element x storage x dispatch matrix
+//////////////////////////////////////////////////////////////////////
+
+// Payload of the array and string elements, so that a collection of
+// a given number of values holds about value_count / length elements
+constexpr std::size_t matrix_array_length = 16;
+constexpr std::size_t matrix_string_length = 64;
+
+struct SumVisitors
+{
+    using Virtual = SumVisitor;
+    using Static = StaticSumVisitor;
+    static constexpr const char *name = "Sum";
+};
+
+struct MultiplyVisitors
+{
+    using Virtual = MultiplyVisitor;
+    using Static = StaticMultiplyVisitor;
+    static constexpr const char *name = "Multiply";
+};
+
+struct XORVisitors
+{
+    using Virtual = XORVisitor;
+    using Static = StaticXORVisitor;
+    static constexpr const char *name = "XOR";
+};
+
+// Make the elements of a collection holding value_count payload values
+template<typename T>
+std::vector<T> MakeConcreteElements(std::size_t value_count)
+{
+    std::vector<T> elements;
+
+    if constexpr(std::is_same_v<T, SingleElement>)
+    {
+        elements.reserve(value_count);
+
+        for(std::size_t i = 0; i < value_count; ++ i)
+        {
+            elements.emplace_back(static_cast<double>(i % 10));
+        }
+    }
+    else if constexpr(std::is_same_v<T, ArrayElement>)
+    {
+        for(std::size_t first = 0; first < value_count; first += matrix_array_length)
+        {
+            std::pmr::vector<double> values(std::min(matrix_array_length, value_count - first));
+
+            for(std::size_t i = 0; i < values.size(); ++ i)
+            {
+                values[i] = static_cast<double>((first + i) % 10);
+            }
+
+            elements.emplace_back(std::move(values));
+        }
+    }
+    else
+    {
+        for(std::size_t first = 0; first < value_count; first += matrix_string_length)
+        {
+            elements.emplace_back(MakeText(std::min(matrix_string_length, value_count - first)));
+        }
+    }
+
+    return elements;
+}
+
+template<typename T>
+std::size_t PayloadBytes(const T &element)
+{
+    if constexpr(std::is_same_v<T, SingleElement>)
+    {
+        return sizeof(double);
+    }
+    else
+    {
+        return element.GetView().size() * sizeof(element.GetView()[0]);
+    }
+}
+
+enum class Storage { List, Contiguous };
+enum class Dispatch { Virtual, Variant };
+
+// Store the elements as the engine sees them: by value for the static
+// engine, and behind AbstractElement for the classic engine. Contiguous
+// storage keeps the concrete elements by value in one buffer, so the
+// classic engine still pays both virtual calls per element but walks
+// memory linearly.
+template<typename T, Storage storage, Dispatch dispatch>
+auto MakeStorage(std::vector<T> elements)
+{
+    if constexpr(dispatch == Dispatch::Variant && storage == Storage::List)
+    {
+        return std::list<Element>(elements.begin(), elements.end());
+    }
+    else if constexpr(dispatch == Dispatch::Variant)
+    {
+        return std::vector<Element>(elements.begin(), elements.end());
+    }
+    else if constexpr(storage == Storage::List)
+    {
+        std::list<std::unique_ptr<AbstractElement>> list;
+
+        for(T &element : elements)
+        {
+            list.push_back(std::make_unique<T>(std::move(element)));
+        }
+
+        return list;
+    }
+    else
+    {
+        return elements;
+    }
+}
+
+template<typename Element>
+AbstractElement& AsAbstract(Element &element)
+{
+    return element;
+}
+
+template<typename Element>
+AbstractElement& AsAbstract(std::unique_ptr<Element> &element)
+{
+    return *element;
+}
+
+template<typename Visitors, typename T, Storage storage, Dispatch dispatch>
+void BM_Matrix(benchmark::State &state)
+{
+    std::vector<T> concrete = MakeConcreteElements<T>(state.range(0));
+
+    const std::size_t element_count = concrete.size();
+    std::size_t payload_bytes = 0;
+
+    for(const T &element : concrete)
+    {
+        payload_bytes += PayloadBytes(element);
+    }
+
+    auto elements = MakeStorage<T, storage, dispatch>(std::move(concrete));
+
+    if constexpr(dispatch == Dispatch::Virtual)
+    {
+        typename Visitors::Virtual visitor;
+        AbstractVisitor &abstract_visitor = visitor;
+
+        for(auto _ : state)
+        {
+            visitor.Reset();
+
+            for(auto &element : elements)
+            {
+                AsAbstract(element).Accept(abstract_visitor);
+            }
+
+            benchmark::DoNotOptimize(visitor.GetValue());
+        }
+    }
+    else
+    {
+        typename Visitors::Static visitor;
+
+        for(auto _ : state)
+        {
+            visitor.Reset();
+
+            if constexpr(storage == Storage::Contiguous)
+            {
+                VisitAll(elements, visitor);
+            }
+            else
+            {
+                // One node at a time, skipping the element types the
+                // visitor does not support as VisitAll does
+                for(const Element &element : elements)
+                {
+                    VisitAll(std::span<const Element>(&element, 1), visitor);
+                }
+            }
+
+            benchmark::DoNotOptimize(visitor.GetValue());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * element_count);
+    state.SetBytesProcessed(state.iterations() * payload_bytes);
+    state.counters["time/element"] = benchmark::Counter(
+        static_cast<double>(state.iterations() * element_count),
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+template<typename Visitors, typename T, Storage storage, Dispatch dispatch>
+void RegisterMatrixBenchmark(const char *element_name)
+{
+    std::string name = std::string("BM_Matrix/") + Visitors::name + "/" + element_name
+        + (storage == Storage::List ? "/List" : "/Contiguous")
+        + (dispatch == Dispatch::Virtual ? "/Virtual" : "/Variant");
+
+    benchmark::internal::Benchmark *benchmark =
+        benchmark::RegisterBenchmark(name.c_str(), BM_Matrix<Visitors, T, storage, dispatch>);
+
+    for(long long value_count = 1; value_count <= BENCHMARK_MAX_VALUES; value_count *= 10)
+    {
+        benchmark->Arg(value_count);
+    }
+}
+
+template<typename Visitors, typename T>
+void RegisterMatrixBenchmarks(const char *element_name)
+{
+    RegisterMatrixBenchmark<Visitors, T, Storage::List, Dispatch::Virtual>(element_name);
+    RegisterMatrixBenchmark<Visitors, T, Storage::List, Dispatch::Variant>(element_name);
+    RegisterMatrixBenchmark<Visitors, T, Storage::Contiguous, Dispatch::Virtual>(element_name);
+    RegisterMatrixBenchmark<Visitors, T, Storage::Contiguous, Dispatch::Variant>(element_name);
+}
+
+template<typename Visitors>
+void RegisterMatrixBenchmarks()
+{
+    RegisterMatrixBenchmarks<Visitors, SingleElement>("Single");
+    RegisterMatrixBenchmarks<Visitors, ArrayElement>("Array");
+    RegisterMatrixBenchmarks<Visitors, StringElement>("String");
+}
+
+const bool matrix_registered = []()
+{
+    RegisterMatrixBenchmarks<SumVisitors>();
+    RegisterMatrixBenchmarks<MultiplyVisitors>();
+    RegisterMatrixBenchmarks<XORVisitors>();
+
+    return true;
+}();
+
+
+// Build a batch of small arrays and strings and release it, with the
+// default allocator or with every allocation from one arena
+template<bool use_arena>
+void BM_BuildBatch(benchmark::State &state)
+{
+    const std::size_t element_count = state.range(0);
+    const std::string text = MakeText(32);
+
+    for(auto _ : state)
+    {
+        std::pmr::monotonic_buffer_resource arena;
+        std::pmr::memory_resource *resource = use_arena ? &arena : std::pmr::get_default_resource();
+
+        ElementContainer container(resource);
+
+        for(std::size_t i = 0; i < element_count; ++ i)
+        {
+            double v = static_cast<double>(i % 10);
+
+            container.Emplace<SingleElement>(v);
+            container.Emplace<ArrayElement>(std::initializer_list<double>{v, v + 1.0, v + 2.0});
+            container.Emplace<StringElement>(std::string_view(text));
+        }
+
+        benchmark::DoNotOptimize(container.Size());
+    }
+
+    state.SetItemsProcessed(state.iterations() * element_count * 3);
+    state.SetLabel(use_arena ? "monotonic" : "default");
+}
+
+
+// Copies every element of a file into a container, so the file can be
+// visited as it would be without MappedElementFile: decoded first,
+// visited afterwards
+class ContainerLoader : public AbstractVisitor
+{
+
+public:
+
+    explicit ContainerLoader(ElementContainer &container)
+        : container(container)
+    {
+    }
+
+    void ProcessSingleElement(const SingleElement& element) override
+    {
+        container.Add(element);
+    }
+
+    void ProcessArrayElement(const ArrayElement& element) override
+    {
+        container.Add(element);
+    }
+
+    void ProcessStringElement(const StringElement& element) override
+    {
+        container.Add(element);
+    }
+
+private:
+
+    ElementContainer &container;
+
+};
+
+std::filesystem::path WriteElementFile(std::size_t element_count)
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() /
+        ("visitor_pattern_benchmark_" + std::to_string(element_count) + ".bin");
+
+    ElementFileWriter writer(path.string());
+    writer.Write(MakeMixedContainer(element_count));
+    writer.Close();
+
+    return path;
+}
+
+// Sum of an element file, visited straight from the mapping or loaded
+// into a container first
+template<bool load_first>
+void BM_ElementFileAccept(benchmark::State &state)
+{
+    const std::filesystem::path path = WriteElementFile(state.range(0));
+    SumVisitor sum_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        MappedElementFile file(path.string());
+
+        if constexpr(load_first)
+        {
+            ElementContainer container;
+            ContainerLoader loader(container);
+
+            file.Accept(loader);
+            container.Accept(sum_visitor);
+        }
+        else
+        {
+            file.Accept(sum_visitor);
+        }
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    std::filesystem::remove(path);
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(load_first ? "load then accept" : "mapped");
+}
+
+
+// Digit sum of a string fed to a StringStream in chunks, as it would
+// arrive from a socket, or visited whole
+constexpr std::size_t stream_chunk_size = 4096;
+
+template<bool chunked>
+void BM_StringStream(benchmark::State &state)
+{
+    const std::string text = MakeText(state.range(0));
+    const std::string_view view(text);
+
+    SumVisitor sum_visitor;
+    StringStream stream(sum_visitor);
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        if constexpr(chunked)
+        {
+            for(std::size_t offset = 0; offset < view.size(); offset += stream_chunk_size)
+            {
+                stream.Write(view.substr(offset, stream_chunk_size));
+            }
+
+            stream.Finish();
+        }
+        else
+        {
+            sum_visitor.ProcessStringView(view);
+        }
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+    state.SetLabel(chunked ? "chunked" : "whole");
+}
+
+
+// Build and visit a container of arrays of 1 to 4 values, the sizes
+// held inline by ArrayElement
+void BM_SmallArrayBuild(benchmark::State &state)
+{
+    const std::size_t element_count = state.range(0);
+
+    for(auto _ : state)
+    {
+        ElementContainer container;
+
+        for(std::size_t i = 0; i < element_count; ++ i)
+        {
+            double values[4] = {1.0, 2.0, 3.0, 4.0};
+
+            container.Emplace<ArrayElement>(std::span<const double>(values, i % 4 + 1));
+        }
+
+        benchmark::DoNotOptimize(container.Size());
+    }
+
+    state.SetItemsProcessed(state.iterations() * element_count);
+}
+
+void BM_SmallArrayAccept(benchmark::State &state)
+{
+    ElementContainer container;
+
+    for(long long i = 0; i < state.range(0); ++ i)
+    {
+        double values[4] = {1.0, 2.0, 3.0, 4.0};
+
+        container.Emplace<ArrayElement>(std::span<const double>(values, i % 4 + 1));
+    }
+
+    SumVisitor sum_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        container.Accept(sum_visitor);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+
+// Re-visit a container of arrays after changing a few of them, in
+// full or with the memoized results
+constexpr std::size_t changed_per_tick = 8;
+
+ElementContainer MakeSmallArrayContainer(std::size_t element_count)
+{
+    ElementContainer container;
+
+    for(std::size_t i = 0; i < element_count; ++ i)
+    {
+        double v = static_cast<double>(i % 10);
+        container.Add(ArrayElement({v, v + 1.0, v + 2.0, v + 3.0}));
+    }
+
+    return container;
+}
+
+void ChangeElements(ElementContainer &container, std::size_t tick)
+{
+    std::span<ArrayElement> arrays = container.GetArrayElements();
+
+    for(std::size_t i = 0; i < changed_per_tick; ++ i)
+    {
+        double v = static_cast<double>(tick % 10);
+        arrays[(tick * changed_per_tick + i) * 7919 % arrays.size()].SetValue({v, v, v, v});
+    }
+}
+
+void BM_FullUpdate(benchmark::State &state)
+{
+    ElementContainer container = MakeSmallArrayContainer(state.range(0));
+    SumVisitor sum_visitor;
+    std::size_t tick = 0;
+
+    for(auto _ : state)
+    {
+        ChangeElements(container, ++ tick);
+
+        sum_visitor.Reset();
+        container.Accept(sum_visitor);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_CachedUpdate(benchmark::State &state)
+{
+    ElementContainer container = MakeSmallArrayContainer(state.range(0));
+    CachedAccept<SumVisitor> cached_sum;
+    std::size_t tick = 0;
+
+    cached_sum.Update(container);
+
+    for(auto _ : state)
+    {
+        ChangeElements(container, ++ tick);
+
+        cached_sum.Update(container);
+
+        benchmark::DoNotOptimize(cached_sum.GetResult().GetValue());
+    }
+
+    // Only the changed elements are visited again
+    state.SetItemsProcessed(state.iterations() * changed_per_tick);
+}
+
+void BM_LiveUpdate(benchmark::State &state)
+{
+    ElementContainer container = MakeSmallArrayContainer(state.range(0));
+    LiveSum live_sum(container);
+    std::size_t tick = 0;
+
+    for(auto _ : state)
+    {
+        ChangeElements(container, ++ tick);
+
+        benchmark::DoNotOptimize(live_sum.GetValue());
+    }
+
+    // Only the changed elements are applied to the aggregate
+    state.SetItemsProcessed(state.iterations() * changed_per_tick);
+}
+
+
+// A container of SingleElement values visited with one virtual call
+// per element, or with one call into the visitor's batch hook
+template<ReductionMode mode>
+void BM_PerElementAccept(benchmark::State &state)
+{
+    ElementContainer container;
+
+    for(long long i = 0; i < state.range(0); ++ i)
+    {
+        container.Add(SingleElement(static_cast<double>(i % 10)));
+    }
+
+    SumVisitor sum_visitor(mode);
+    AbstractVisitor &visitor = sum_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        for(const SingleElement &element : container.GetSingleElements())
+        {
+            visitor.ProcessSingleElement(element);
+        }
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// TruncatingSumVisitor shows the cost of truncating each value to an
+// int against the exact sum of SumVisitor
+template<typename Visitor, ReductionMode mode>
+void BM_BatchAccept(benchmark::State &state)
+{
+    ElementContainer container;
+
+    for(long long i = 0; i < state.range(0); ++ i)
+    {
+        container.Add(SingleElement(static_cast<double>(i % 10)));
+    }
+
+    Visitor sum_visitor(mode);
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        container.Accept(sum_visitor);
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+
+// Decoding one batch of range(0) elements, standing in for a read from
+// a socket or a file
+ElementContainer DecodeBatch(long long size)
+{
+    ElementContainer container;
+
+    for(long long i = 0; i < size; ++ i)
+    {
+        container.Add(SingleElement(static_cast<double>(i % 10)));
+    }
+
+    return container;
+}
+
+constexpr std::size_t pipeline_batch_count = 64;
+
+// Every batch is decoded before the first is visited
+void BM_LoadThenAccept(benchmark::State &state)
+{
+    SumVisitor sum_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        std::vector<ElementContainer> batches;
+
+        for(std::size_t i = 0; i < pipeline_batch_count; ++ i)
+        {
+            batches.push_back(DecodeBatch(state.range(0)));
+        }
+
+        for(const ElementContainer &batch : batches)
+        {
+            batch.Accept(sum_visitor);
+        }
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0) * pipeline_batch_count);
+}
+
+// Decoding, visiting and merging overlap, with at most a few batches
+// in flight
+void BM_PipelinedAccept(benchmark::State &state)
+{
+    ThreadPool pool;
+    SumVisitor sum_visitor;
+
+    for(auto _ : state)
+    {
+        sum_visitor.Reset();
+
+        CoroutineScheduler scheduler;
+        Channel<ElementBatch> batches(scheduler, 4);
+        Channel<BatchResult<SumVisitor>> results(scheduler, 4);
+
+        std::size_t batches_left = pipeline_batch_count;
+        const long long size = state.range(0);
+
+        auto source = [&batches_left, size]() -> std::optional<ElementContainer>
+        {
+            if(batches_left == 0)
+            {
+                return std::nullopt;
+            }
+
+            -- batches_left;
+
+            return DecodeBatch(size);
+        };
+
+        scheduler.Spawn(ReadBatches(scheduler, pool, source, batches));
+        scheduler.Spawn(VisitBatches(scheduler, pool, batches, sum_visitor, results));
+        scheduler.Spawn(MergeBatchResults(results, sum_visitor));
+        scheduler.Run();
+
+        benchmark::DoNotOptimize(sum_visitor.GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0) * pipeline_batch_count);
+}
+
+
+// Elements pushed one at a time by the benchmark thread and visited by
+// long-lived workers, until all of them have been visited
+void BM_StreamingIngest(benchmark::State &state)
+{
+    SumVisitor sum_visitor;
+    StreamingVisitorPool<SumVisitor> pool(sum_visitor, 1);
+
+    for(auto _ : state)
+    {
+        for(long long i = 0; i < state.range(0); ++ i)
+        {
+            pool.Push(SingleElement(static_cast<double>(i % 10)));
+        }
+
+        pool.Drain();
+    }
+
+    benchmark::DoNotOptimize(pool.Snapshot().GetValue());
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+
+// Aggregating the reports of range(0) shards: decoding each report,
+// and merging the states in shard order, with the bytes received
+template<typename Visitor>
+void BM_ShardAggregate(benchmark::State &state)
+{
+    const std::size_t shard_count = state.range(0);
+
+    Visitor visitor;
+    std::vector<std::vector<std::byte>> reports;
+    std::size_t report_bytes = 0;
+
+    for(std::size_t shard = 0; shard < shard_count; ++ shard)
+    {
+        ShardDriver<Visitor> driver(visitor, shard, shard_count);
+        driver.Run(MakeStringContainer(4096));
+
+        reports.push_back(driver.GetReport());
+        report_bytes += reports.back().size();
+    }
+
+    for(auto _ : state)
+    {
+        ShardAggregator<Visitor> aggregator(visitor, shard_count);
+
+        for(const std::vector<std::byte> &report : reports)
+        {
+            aggregator.Receive(report);
+        }
+
+        benchmark::DoNotOptimize(aggregator.GetResult().GetValue());
+    }
+
+    state.SetItemsProcessed(state.iterations() * shard_count);
+    state.SetBytesProcessed(state.iterations() * report_bytes);
+}
+
+} // namespace
+
+
+BENCHMARK_TEMPLATE(BM_VirtualDispatch, SumVisitor)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_TypeListDispatch, SumVisitor)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_VariantDispatch, StaticSumVisitor)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_VirtualDispatch, MultiplyVisitor)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_TypeListDispatch, MultiplyVisitor)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+BENCHMARK_TEMPLATE(BM_StringRevisit, false)->RangeMultiplier(16)->Range(16, 1 << 16);
+BENCHMARK_TEMPLATE(BM_StringRevisit, true)->RangeMultiplier(16)->Range(16, 1 << 16);
+BENCHMARK_TEMPLATE(BM_VariantDispatch, StaticMultiplyVisitor)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+BENCHMARK_TEMPLATE(BM_SumKernel, ReductionMode::Strict)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_SumKernel, ReductionMode::Reassociate)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_SumPolicy, NaiveSummation)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_SumPolicy, PairwiseSummation)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_SumPolicy, CompensatedSummation)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_SumPolicy, ReproducibleSummation)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ProductKernel, ReductionMode::Strict)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ProductKernel, ReductionMode::Reassociate)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+BENCHMARK_TEMPLATE(BM_ProductPolicy, NaiveProduct, ReductionMode::Strict)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ProductPolicy, ScaledProduct, ReductionMode::Strict)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ProductPolicy, NaiveProduct, ReductionMode::Reassociate)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ProductPolicy, ScaledProduct, ReductionMode::Reassociate)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+BENCHMARK_TEMPLATE(BM_TypedArraySum, double)->RangeMultiplier(16)->Range(16, 1 << 22);
+BENCHMARK_TEMPLATE(BM_TypedArraySum, float)->RangeMultiplier(16)->Range(16, 1 << 22);
+BENCHMARK_TEMPLATE(BM_TypedArraySum, std::int32_t)->RangeMultiplier(16)->Range(16, 1 << 22);
+BENCHMARK_TEMPLATE(BM_TypedArraySum, std::int64_t)->RangeMultiplier(16)->Range(16, 1 << 22);
+
+BENCHMARK(BM_DigitSumKernel)->RangeMultiplier(16)->Range(16, 1 << 22);
+BENCHMARK(BM_DigitProductKernel)->RangeMultiplier(16)->Range(16, 1 << 22);
+BENCHMARK(BM_XorChecksumKernel)->RangeMultiplier(16)->Range(16, 1 << 22);
+BENCHMARK_TEMPLATE(BM_ChecksumVisitor, XORVisitor)->RangeMultiplier(16)->Range(16, 1 << 22);
+BENCHMARK_TEMPLATE(BM_ChecksumVisitor, XorFold64Visitor)->RangeMultiplier(16)->Range(16, 1 << 22);
+BENCHMARK_TEMPLATE(BM_ChecksumVisitor, Crc32cVisitor)->RangeMultiplier(16)->Range(16, 1 << 22);
+BENCHMARK_TEMPLATE(BM_ChecksumVisitor, Xxh64Visitor)->RangeMultiplier(16)->Range(16, 1 << 22);
+
+BENCHMARK_TEMPLATE(BM_BuildBatch, false)->RangeMultiplier(16)->Range(16, 1 << 16);
+BENCHMARK_TEMPLATE(BM_BuildBatch, true)->RangeMultiplier(16)->Range(16, 1 << 16);
+BENCHMARK(BM_SmallArrayBuild)->RangeMultiplier(16)->Range(16, 1 << 16);
+BENCHMARK(BM_SmallArrayAccept)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+BENCHMARK_TEMPLATE(BM_ElementFileAccept, false)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ElementFileAccept, true)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+BENCHMARK_TEMPLATE(BM_StringStream, true)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+BENCHMARK_TEMPLATE(BM_StringStream, false)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+BENCHMARK_TEMPLATE(BM_PerElementAccept, ReductionMode::Strict)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_BatchAccept, SumVisitor, ReductionMode::Strict)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_BatchAccept, TruncatingSumVisitor, ReductionMode::Strict)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_PerElementAccept, ReductionMode::Reassociate)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_BatchAccept, SumVisitor, ReductionMode::Reassociate)->RangeMultiplier(16)->Range(16, 1 << 20);
+BENCHMARK_TEMPLATE(BM_BatchAccept, TruncatingSumVisitor, ReductionMode::Reassociate)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+BENCHMARK(BM_FullUpdate)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+BENCHMARK(BM_CachedUpdate)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+BENCHMARK(BM_LiveUpdate)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+BENCHMARK(BM_LoadThenAccept)->RangeMultiplier(16)->Range(16, 1 << 16)->UseRealTime();
+BENCHMARK(BM_PipelinedAccept)->RangeMultiplier(16)->Range(16, 1 << 16)->UseRealTime();
+
+BENCHMARK(BM_StreamingIngest)->RangeMultiplier(16)->Range(1 << 8, 1 << 20)->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_ShardAggregate, SumVisitor)->RangeMultiplier(16)->Range(16, 1 << 12);
+BENCHMARK_TEMPLATE(BM_ShardAggregate, BasicSumVisitor<ReproducibleSummation>)->RangeMultiplier(16)->Range(16, 1 << 12);
+BENCHMARK_TEMPLATE(BM_ShardAggregate, Xxh64Visitor)->RangeMultiplier(16)->Range(16, 1 << 12);
+
+BENCHMARK(BM_SeparateTraversals)->RangeMultiplier(16)->Range(1 << 12, 1 << 24);
+BENCHMARK(BM_FusedTraversal)->RangeMultiplier(16)->Range(1 << 12, 1 << 24);
+
+BENCHMARK(BM_ParallelAccept)->ArgsProduct({{1 << 16, 1 << 20}, {1, 2, 4, 8}})->UseRealTime();
+BENCHMARK(BM_SkewedParallelAccept)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+BENCHMARK(BM_SkewedWorkStealingAccept)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+BENCHMARK(BM_SeparateChecksums)->RangeMultiplier(16)->Range(1 << 16, 1 << 24);
+BENCHMARK(BM_FusedChecksums)->RangeMultiplier(16)->Range(1 << 16, 1 << 24);
+
+BENCHMARK_MAIN();
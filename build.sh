@@ -1 +1,9 @@
-g++ -std=c++20 -fmax-errors=1 main.cpp -o a.out
\ No newline at end of file
+#!/bin/sh
+# Configure and build one of the presets in CMakePresets.json, release
+# by default: ./build.sh lto
+set -e
+
+preset="${1:-release}"
+
+cmake --preset "$preset"
+cmake --build --preset "$preset"
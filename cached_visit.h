@@ -0,0 +1,384 @@
+#ifndef CACHED_VISIT_H
+#define CACHED_VISIT_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "elements.h"
+#include "element_container.h"
+#include "parallel_visit.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Memoized visitation
+//
+// CachedAccept keeps the result of one visitor over a container which
+// changes a little between visits. The partial result of each element
+// is cached with the element's version (AbstractElement::GetVersion),
+// and Update only visits again the elements whose version changed,
+// which are those given a new value with SetValue or assignment since
+// the last Update:
+//
+//     CachedAccept<SumVisitor> cached_sum;
+//
+//     cached_sum.Update(element_container);      // visits everything
+//     element_container.GetArrayElements()[3].SetValue(values);
+//     cached_sum.Update(element_container);      // visits one element
+//
+// CachedAccept subscribes to the container as an ElementObserver and
+// queues each element which is given a new value, so an Update after k
+// changes costs O(k log n) merges, whatever the size of the container.
+// After a structural change, an element added, Clear or a reallocation
+// of the storage, the next Update scans the versions of all the
+// elements instead. The cache follows one container at a time:
+// updating from another one starts over with a full visit. It
+// unsubscribes itself when destroyed, and must not outlive the last
+// container it was updated from.
+//
+// The partials are combined with Merge in a balanced tree. Each total
+// is recombined exactly from the current partials, rather than by
+// undoing the old partial, so there is no drift in floating point sums
+// and products are unaffected by zeros. The association of the
+// partials follows the tree, and can differ from Accept in the last
+// bits of a floating point result.
+//
+// The tree holds two Visitor copies per leaf, with the number of
+// leaves rounded up to a power of two: between 2n and 4n copies of the
+// visitor for n elements, plus a version per leaf.
+//
+// Elements are identified by their position in visiting order, single
+// elements first, then arrays, then strings.
+//////////////////////////////////////////////////////////////////////
+
+template<MergeableVisitor Visitor>
+class CachedAccept : public ElementObserver
+{
+
+public:
+
+    // Partials are computed by reset clones of prototype, so that any
+    // configuration of the visitor, such as its ReductionMode, is kept
+    explicit CachedAccept(const Visitor &prototype = Visitor())
+        : identity(detail::CloneVisitor(prototype))
+        , leaf_count{0}
+        , recomputed_count{0}
+        , container(nullptr)
+        , full_scan(true)
+        , last_storage{}
+    {
+        tree.assign(2 * min_capacity, identity);
+        versions.assign(min_capacity, no_version);
+    }
+
+    CachedAccept(const CachedAccept&) = delete;
+    CachedAccept& operator=(const CachedAccept&) = delete;
+
+    virtual
+    ~CachedAccept()
+    {
+        if(container != nullptr)
+        {
+            container->Unsubscribe(*this);
+        }
+    }
+
+    // Bring the cached result up to date with the container. Element
+    // types the visitor does not support are skipped and counted.
+    VisitResult Update(ElementContainer &container)
+    {
+        if(this->container != &container)
+        {
+            if(this->container != nullptr)
+            {
+                this->container->Unsubscribe(*this);
+            }
+
+            this->container = &container;
+            container.Subscribe(*this);
+
+            full_scan = true;
+        }
+
+        std::span<const SingleElement> singles = container.GetSingleElements();
+        std::span<const ArrayElement> arrays = container.GetArrayElements();
+        std::span<const StringElement> strings = container.GetStringElements();
+
+        recomputed_count = 0;
+
+        const std::array<const void*, 3> storage = {singles.data(), arrays.data(), strings.data()};
+
+        if(full_scan || container.Size() != leaf_count || storage != last_storage)
+        {
+            Resize(container.Size());
+
+            UpdateSegment(ElementType::Single, singles, 0);
+            UpdateSegment(ElementType::Array, arrays, singles.size());
+            UpdateSegment(ElementType::String, strings, singles.size() + arrays.size());
+        }
+        else
+        {
+            for(const AbstractElement *element : changed)
+            {
+                std::size_t index;
+
+                if(Locate(element, singles, index))
+                {
+                    UpdateLeaf(ElementType::Single, singles[index], index);
+                }
+                else if(Locate(element, arrays, index))
+                {
+                    UpdateLeaf(ElementType::Array, arrays[index], singles.size() + index);
+                }
+                else if(Locate(element, strings, index))
+                {
+                    UpdateLeaf(ElementType::String, strings[index], singles.size() + arrays.size() + index);
+                }
+            }
+        }
+
+        changed.clear();
+        full_scan = false;
+        last_storage = storage;
+
+        Recombine();
+
+        VisitResult result;
+
+        CountSegment(ElementType::Single, singles.size(), result);
+        CountSegment(ElementType::Array, arrays.size(), result);
+        CountSegment(ElementType::String, strings.size(), result);
+
+        return result;
+    }
+
+    // The result over the container as of the last Update
+    const Visitor& GetResult() const
+    {
+        return tree[1];
+    }
+
+    // Number of elements visited by the last Update
+    std::size_t GetRecomputedCount() const
+    {
+        return recomputed_count;
+    }
+
+    // Drop every cached partial, so the next Update visits everything
+    void Invalidate()
+    {
+        std::fill(versions.begin(), versions.end(), no_version);
+
+        full_scan = true;
+        changed.clear();
+    }
+
+    // ElementObserver: elements are followed rather than their values
+    void OnChange(const AbstractElement &element)
+    {
+        if(!full_scan)
+        {
+            changed.push_back(&element);
+
+            // Past this point a scan of the versions is cheaper
+            if(changed.size() > leaf_count)
+            {
+                full_scan = true;
+                changed.clear();
+            }
+        }
+    }
+
+    void OnClear()
+    {
+        full_scan = true;
+        changed.clear();
+    }
+
+    void OnInsert(double value) {}
+    void OnErase(double value) {}
+
+    void OnInsert(std::span<const double> values) {}
+    void OnErase(std::span<const double> values) {}
+
+    void OnInsert(std::string_view text) {}
+    void OnErase(std::string_view text) {}
+
+private:
+
+    // Version 0 is never given to an element, which makes it safe to
+    // mark empty or invalidated leaves
+    static constexpr std::uint64_t no_version = 0;
+
+    // With at least two leaves the root is never a leaf
+    static constexpr std::size_t min_capacity = 2;
+
+    // Grow the tree to a power of two number of leaves at least
+    // element_count, and reset the leaves past element_count
+    void Resize(std::size_t element_count)
+    {
+        if(element_count > leaf_count)
+        {
+            std::size_t capacity = min_capacity;
+
+            while(capacity < element_count)
+            {
+                capacity *= 2;
+            }
+
+            if(capacity > tree.size() / 2)
+            {
+                tree.assign(2 * capacity, identity);
+                versions.assign(capacity, no_version);
+            }
+        }
+        else
+        {
+            for(std::size_t leaf = element_count; leaf < leaf_count; ++ leaf)
+            {
+                SetLeaf(leaf, identity, no_version);
+            }
+        }
+
+        leaf_count = element_count;
+    }
+
+    // Find the position of element in elements, if it is one of them
+    template<typename Element>
+    static bool Locate(const AbstractElement *element, std::span<const Element> elements, std::size_t &index)
+    {
+        const std::less<const AbstractElement*> before;
+
+        if(elements.empty() || before(element, &elements.front()) || before(&elements.back(), element))
+        {
+            return false;
+        }
+
+        index = static_cast<const Element*>(element) - elements.data();
+
+        return true;
+    }
+
+    template<typename Element>
+    void UpdateSegment(ElementType type, std::span<const Element> elements, std::size_t first_leaf)
+    {
+        for(std::size_t index = 0; index < elements.size(); ++ index)
+        {
+            UpdateLeaf(type, elements[index], first_leaf + index);
+        }
+    }
+
+    // Visit element again if its version changed. Elements of a type
+    // the visitor does not support keep the identity as their partial.
+    template<typename Element>
+    void UpdateLeaf(ElementType type, const Element &element, std::size_t leaf)
+    {
+        if(versions[leaf] == element.GetVersion())
+        {
+            return;
+        }
+
+        if(VisitorSupports(identity, type))
+        {
+            Visitor partial(identity);
+            Process(partial, element);
+
+            SetLeaf(leaf, partial, element.GetVersion());
+
+            ++ recomputed_count;
+        }
+        else
+        {
+            SetLeaf(leaf, identity, element.GetVersion());
+        }
+    }
+
+    void CountSegment(ElementType type, std::size_t element_count, VisitResult &result) const
+    {
+        if(VisitorSupports(identity, type))
+        {
+            result.AddVisited(element_count);
+        }
+        else
+        {
+            result.AddSkipped(element_count);
+        }
+    }
+
+    static void Process(Visitor &visitor, const SingleElement &element)
+    {
+        visitor.ProcessSingleElement(element);
+    }
+
+    static void Process(Visitor &visitor, const ArrayElement &element)
+    {
+        visitor.ProcessArrayElement(element);
+    }
+
+    static void Process(Visitor &visitor, const StringElement &element)
+    {
+        visitor.ProcessStringElement(element);
+    }
+
+    // Store a leaf, its ancestors are recombined by Recombine
+    void SetLeaf(std::size_t leaf, const Visitor &partial, std::uint64_t version)
+    {
+        versions[leaf] = version;
+        tree[tree.size() / 2 + leaf] = partial;
+
+        dirty.push_back((tree.size() / 2 + leaf) / 2);
+    }
+
+    // Recombine the ancestors of the leaves set since the last call,
+    // one level at a time, so that each node is merged only once
+    void Recombine()
+    {
+        std::sort(dirty.begin(), dirty.end());
+
+        while(!dirty.empty())
+        {
+            dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+            for(std::size_t &node : dirty)
+            {
+                tree[node] = tree[2 * node];
+                tree[node].Merge(tree[2 * node + 1]);
+
+                node /= 2;
+            }
+
+            if(dirty.front() == 0)
+            {
+                dirty.clear();
+            }
+        }
+    }
+
+    Visitor identity;
+
+    // Implicit binary tree: node i has children 2i and 2i + 1, the
+    // root is node 1 and the leaves are the second half
+    std::vector<Visitor> tree;
+    std::vector<std::uint64_t> versions;
+    std::vector<std::size_t> dirty;
+
+    std::size_t leaf_count;
+    std::size_t recomputed_count;
+
+    // The container subscribed to, the elements given a new value since
+    // the last Update, and whether the next Update has to scan them all
+    ElementContainer *container;
+    std::vector<const AbstractElement*> changed;
+    bool full_scan;
+
+    // Where the elements were stored at the last Update
+    std::array<const void*, 3> last_storage;
+
+};
+
+#endif // CACHED_VISIT_H
@@ -0,0 +1,475 @@
+#ifndef CHECKSUM_VISITORS_H
+#define CHECKSUM_VISITORS_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "elements.h"
+#include "kernels.h"
+#include "visitor_state.h"
+
+//////////////////////////////////////////////////////////////////////
+// Checksum visitors
+//
+// XORVisitor reduces each string to one byte, which is enough to catch
+// a flipped bit but not to tell payloads apart. The checksum visitors
+// compute a wider digest of each string, 8 to 64 bytes per step:
+//
+// - XorFold64Visitor: XOR of the string as 64-bit words
+//   (kernels::XorFold64), as cheap as XORVisitor but 8 bytes wide
+// - Crc32cVisitor: CRC-32C (kernels::Crc32c), with the SSE4.2 or ARMv8
+//   CRC32 instructions where available
+// - Xxh64Visitor: the 64-bit xxHash (XXH64, seed 0), a fast
+//   non-cryptographic hash suited to deduplication
+//
+// As for XORVisitor, only strings are supported. The digests of the
+// strings visited are combined by XOR into GetValue, which does not
+// depend on the order of the strings, so the visitors can be merged
+// for ParallelAccept and CachedAccept. GetValue is an integrity value
+// for a whole collection, not a key: two equal strings cancel out, so
+// it cannot tell duplicates apart.
+//
+// The digest of each string on its own is given by GetLastDigest, for
+// elements visited one at a time, or recorded with RecordDigests in
+// the order the strings are visited, whatever the path: one element,
+// a batch of elements, chunks or a FusedVisitor. Merge appends the
+// digests of the other visitor, so ParallelAccept, which merges its
+// partials in element order, records them in the order of the
+// container too.
+//
+// The visitors take strings in chunks, and can be fused with the
+// built-in reductions, in which case each string is read from memory
+// once for all of them (see FusedVisitor).
+//////////////////////////////////////////////////////////////////////
+
+// Hashers compute the digest of one string, given in one or more
+// pieces through Update, and are default constructible to the empty
+// string. The state_tag tells the visitors' states apart.
+
+class XorFold64Hasher
+{
+
+public:
+
+    static constexpr std::uint32_t state_tag = 1;
+
+    // A piece starting at an offset which is not a multiple of 8 is
+    // rotated into place, so the words line up with the whole string
+    void Update(std::string_view text)
+    {
+        fold ^= std::rotl(kernels::XorFold64(text), static_cast<int>(8 * (offset % 8)));
+        offset += text.size();
+    }
+
+    std::uint64_t Digest() const
+    {
+        return fold;
+    }
+
+private:
+
+    std::uint64_t fold = 0;
+    std::size_t offset = 0;
+
+};
+
+
+class Crc32cHasher
+{
+
+public:
+
+    static constexpr std::uint32_t state_tag = 2;
+
+    void Update(std::string_view text)
+    {
+        crc = kernels::Crc32c(text, crc);
+    }
+
+    std::uint64_t Digest() const
+    {
+        return crc;
+    }
+
+private:
+
+    std::uint32_t crc = 0;
+
+};
+
+
+// XXH64 as specified by the xxHash reference implementation, processing
+// 32 bytes per step in four independent lanes
+class Xxh64Hasher
+{
+
+public:
+
+    static constexpr std::uint32_t state_tag = 3;
+
+    void Update(std::string_view text)
+    {
+        const unsigned char *data = reinterpret_cast<const unsigned char*>(text.data());
+        std::size_t size = text.size();
+
+        total_size += size;
+
+        // Complete a stripe left over from the previous piece
+        if(buffered > 0)
+        {
+            const std::size_t taken = std::min(stripe_size - buffered, size);
+
+            std::memcpy(buffer + buffered, data, taken);
+            buffered += taken;
+            data += taken;
+            size -= taken;
+
+            if(buffered < stripe_size)
+            {
+                return;
+            }
+
+            ConsumeStripe(buffer);
+            buffered = 0;
+        }
+
+        for(; size >= stripe_size; data += stripe_size, size -= stripe_size)
+        {
+            ConsumeStripe(data);
+        }
+
+        std::memcpy(buffer, data, size);
+        buffered = size;
+    }
+
+    std::uint64_t Digest() const
+    {
+        std::uint64_t hash;
+
+        if(total_size >= stripe_size)
+        {
+            hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+
+            for(std::uint64_t lane : lanes)
+            {
+                hash = MergeRound(hash, lane);
+            }
+        }
+        else
+        {
+            hash = prime5;
+        }
+
+        hash += total_size;
+
+        std::size_t index = 0;
+
+        for(; index + 8 <= buffered; index += 8)
+        {
+            hash ^= Round(0, Read<std::uint64_t>(buffer + index));
+            hash = std::rotl(hash, 27) * prime1 + prime4;
+        }
+
+        if(index + 4 <= buffered)
+        {
+            hash ^= static_cast<std::uint64_t>(Read<std::uint32_t>(buffer + index)) * prime1;
+            hash = std::rotl(hash, 23) * prime2 + prime3;
+            index += 4;
+        }
+
+        for(; index < buffered; ++ index)
+        {
+            hash ^= buffer[index] * prime5;
+            hash = std::rotl(hash, 11) * prime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+
+        return hash;
+    }
+
+private:
+
+    static constexpr std::uint64_t prime1 = 0x9e3779b185ebca87;
+    static constexpr std::uint64_t prime2 = 0xc2b2ae3d27d4eb4f;
+    static constexpr std::uint64_t prime3 = 0x165667b19e3779f9;
+    static constexpr std::uint64_t prime4 = 0x85ebca77c2b2ae63;
+    static constexpr std::uint64_t prime5 = 0x27d4eb2f165667c5;
+
+    static constexpr std::size_t stripe_size = 32;
+
+    // xxHash reads its input as little endian words
+    template<typename T>
+    static T Read(const unsigned char *data)
+    {
+        static_assert(std::endian::native == std::endian::little, "Xxh64Hasher assumes a little endian machine");
+
+        T value;
+        std::memcpy(&value, data, sizeof(value));
+
+        return value;
+    }
+
+    static std::uint64_t Round(std::uint64_t lane, std::uint64_t input)
+    {
+        lane += input * prime2;
+        lane = std::rotl(lane, 31);
+
+        return lane * prime1;
+    }
+
+    static std::uint64_t MergeRound(std::uint64_t hash, std::uint64_t lane)
+    {
+        hash ^= Round(0, lane);
+
+        return hash * prime1 + prime4;
+    }
+
+    void ConsumeStripe(const unsigned char *data)
+    {
+        for(std::size_t lane = 0; lane < 4; ++ lane)
+        {
+            lanes[lane] = Round(lanes[lane], Read<std::uint64_t>(data + 8 * lane));
+        }
+    }
+
+    std::uint64_t lanes[4] = {prime1 + prime2, prime2, 0, 0 - prime1};
+    std::uint64_t total_size = 0;
+
+    unsigned char buffer[stripe_size];
+    std::size_t buffered = 0;
+
+};
+
+
+template<typename Hasher>
+class BasicChecksumVisitor : public AbstractVisitor
+{
+
+public:
+
+    BasicChecksumVisitor()
+        : value{0}
+        , last_digest{0}
+        , pending{}
+        , unsupported_count{0}
+        , record_digests{false}
+    {
+    }
+
+    ~BasicChecksumVisitor()
+    {
+        // I do nothing
+    }
+
+    // Checksums are only defined for strings
+    static constexpr bool SupportsElementType(ElementType type)
+    {
+        return type == ElementType::String;
+    }
+
+    bool Supports(ElementType type) const
+    {
+        return SupportsElementType(type);
+    }
+
+    // As for XORVisitor, numeric elements passed here directly are only
+    // counted as unsupported
+    void ProcessSingleElement(const SingleElement& element)
+    {
+        ++ unsupported_count;
+    }
+
+    void ProcessSingleElements(std::span<const SingleElement> elements)
+    {
+        unsupported_count += elements.size();
+    }
+
+    void ProcessArrayElement(const ArrayElement& element)
+    {
+        ++ unsupported_count;
+    }
+
+    void ProcessArrayElements(std::span<const ArrayElement> elements)
+    {
+        unsupported_count += elements.size();
+    }
+
+    void ProcessArrayView(std::span<const double> v)
+    {
+        ++ unsupported_count;
+    }
+
+    void ProcessArrayElementPool(const ArrayElementPool& pool)
+    {
+        unsupported_count += pool.Size();
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<float>& element)
+    {
+        ++ unsupported_count;
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<std::int32_t>& element)
+    {
+        ++ unsupported_count;
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<std::int64_t>& element)
+    {
+        ++ unsupported_count;
+    }
+
+    void ProcessStringElement(const StringElement& element)
+    {
+        ProcessStringView(element.GetView());
+    }
+
+    void ProcessStringElements(std::span<const StringElement> elements)
+    {
+        for(const StringElement &element : elements)
+        {
+            ProcessStringView(element.GetView());
+        }
+    }
+
+    void ProcessStringView(std::string_view v)
+    {
+        Hasher hasher;
+        hasher.Update(v);
+
+        Accumulate(hasher.Digest());
+    }
+
+    bool SupportsStringChunks() const
+    {
+        return true;
+    }
+
+    void ProcessStringChunk(std::string_view chunk)
+    {
+        pending.Update(chunk);
+    }
+
+    void FinishString()
+    {
+        Accumulate(pending.Digest());
+        pending = Hasher{};
+    }
+
+    // Fold in the digest of a string computed elsewhere
+    void Accumulate(std::uint64_t digest)
+    {
+        value ^= digest;
+        last_digest = digest;
+
+        if(record_digests)
+        {
+            digests.push_back(digest);
+        }
+    }
+
+    // The last digest is not carried over, being that of a single
+    // string of the other visitor
+    void Merge(const BasicChecksumVisitor& other)
+    {
+        value ^= other.value;
+        unsupported_count += other.unsupported_count;
+
+        if(record_digests)
+        {
+            digests.insert(digests.end(), other.digests.begin(), other.digests.end());
+        }
+    }
+
+    // Keep the digest of every string visited from now on. Reset clears
+    // the digests recorded but keeps recording, and copies record too,
+    // so the partials of a parallel traversal do.
+    void RecordDigests(bool record = true)
+    {
+        record_digests = record;
+    }
+
+    // The digest of each string since the last Reset, in visiting order
+    std::span<const std::uint64_t> GetDigests() const
+    {
+        return digests;
+    }
+
+    static constexpr std::uint32_t state_tag = 0x400 + Hasher::state_tag;
+
+    // The checksum and the count only: neither the last digest, the
+    // recorded digests, one per string, nor an unfinished chunked
+    // string
+    void SaveState(StateWriter &writer) const
+    {
+        writer.WriteFixed64(value);
+        writer.WriteVarint(unsupported_count);
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        value = reader.ReadFixed64();
+        last_digest = 0;
+        unsupported_count = reader.ReadVarint();
+        digests.clear();
+    }
+
+    std::uint64_t GetValue() const
+    {
+        return value;
+    }
+
+    std::uint64_t GetLastDigest() const
+    {
+        return last_digest;
+    }
+
+    std::size_t GetUnsupportedCount() const
+    {
+        return unsupported_count;
+    }
+
+    void Reset()
+    {
+        value = 0;
+        last_digest = 0;
+        pending = Hasher{};
+        unsupported_count = 0;
+        digests.clear();
+    }
+
+private:
+
+    std::uint64_t value;
+    std::uint64_t last_digest;
+    Hasher pending;             // digest of an unfinished chunked string
+    std::size_t unsupported_count;
+    bool record_digests;
+    std::vector<std::uint64_t> digests;
+
+};
+
+using XorFold64Visitor = BasicChecksumVisitor<XorFold64Hasher>;
+using Crc32cVisitor = BasicChecksumVisitor<Crc32cHasher>;
+using Xxh64Visitor = BasicChecksumVisitor<Xxh64Hasher>;
+
+
+template<typename Visitor>
+struct IsChecksumVisitor : std::false_type {};
+
+template<typename Hasher>
+struct IsChecksumVisitor<BasicChecksumVisitor<Hasher>> : std::true_type {};
+
+#endif // CHECKSUM_VISITORS_H
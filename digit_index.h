@@ -0,0 +1,208 @@
+#ifndef DIGIT_INDEX_H
+#define DIGIT_INDEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "kernels.h"
+#include "multiplication.h"
+
+//////////////////////////////////////////////////////////////////////
+// Digit index of a string
+//
+// What the built-in visitors compute from the digits of a string,
+// computed once so that repeated visits of the same string need not
+// scan it again. StringElement builds it on demand when the index is
+// enabled (see StringElement::EnableDigitIndex).
+//
+// The values are computed by the same kernels as the visitors, so a
+// visit through the index gives exactly the same result as a scan.
+//////////////////////////////////////////////////////////////////////
+
+struct StringDigitIndex
+{
+    std::size_t digit_count = 0;
+    double digit_sum = 0.0;
+    bool has_zero_digit = false;
+    unsigned char checksum = 0;             // XOR of all bytes
+
+    // Product of the digits as computed by each built-in product
+    // policy, starting from one
+    NaiveProduct digit_product;
+    ScaledProduct scaled_digit_product;
+
+    // Offsets of the digits in the string, if requested
+    std::vector<std::size_t> digit_positions;
+
+    // The digit product in the given product policy, or nullptr for a
+    // policy the index does not hold
+    template<typename Policy>
+    const Policy* GetDigitProduct() const
+    {
+        if constexpr(std::is_same_v<Policy, NaiveProduct>)
+        {
+            return &digit_product;
+        }
+        else if constexpr(std::is_same_v<Policy, ScaledProduct>)
+        {
+            return &scaled_digit_product;
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+};
+
+inline StringDigitIndex BuildDigitIndex(std::string_view text, bool with_positions = false)
+{
+    StringDigitIndex index;
+
+    const kernels::StringStatistics statistics = kernels::ScanString(text);
+
+    index.digit_sum = statistics.digit_sum;
+    index.checksum = statistics.checksum;
+    index.digit_product.MultiplyDigits(text);
+    index.scaled_digit_product.MultiplyDigits(text);
+
+    for(std::size_t i = 0; i < text.size(); ++ i)
+    {
+        if(text[i] >= '0' && text[i] <= '9')
+        {
+            ++ index.digit_count;
+            index.has_zero_digit = index.has_zero_digit || text[i] == '0';
+
+            if(with_positions)
+            {
+                index.digit_positions.push_back(i);
+            }
+        }
+    }
+
+    return index;
+}
+
+
+namespace detail
+{
+
+// Lazily built digit index owned by a StringElement. Get may be called
+// from several threads at once, for example by concurrent traversals
+// of the same elements: each builds the index if there is none yet, and
+// the first to publish it wins. Enabling, disabling and invalidating
+// need exclusive access, as changing the string does.
+class DigitIndexCache
+{
+
+public:
+
+    DigitIndexCache()
+        : enabled{false}
+        , with_positions{false}
+        , index{nullptr}
+    {
+    }
+
+    // A copy enables the index if the original does, and takes a copy
+    // of the index already built
+    DigitIndexCache(const DigitIndexCache &other)
+        : enabled(other.enabled)
+        , with_positions(other.with_positions)
+        , index{nullptr}
+    {
+        if(const StringDigitIndex *built = other.index.load(std::memory_order_acquire))
+        {
+            index.store(new StringDigitIndex(*built), std::memory_order_relaxed);
+        }
+    }
+
+    DigitIndexCache(DigitIndexCache &&other) noexcept
+        : enabled(other.enabled)
+        , with_positions(other.with_positions)
+        , index{other.index.exchange(nullptr, std::memory_order_relaxed)}
+    {
+    }
+
+    // Only the index is dropped: whether it is enabled belongs to the
+    // element assigned to
+    DigitIndexCache& operator=(const DigitIndexCache&)
+    {
+        Invalidate();
+
+        return *this;
+    }
+
+    ~DigitIndexCache()
+    {
+        Invalidate();
+    }
+
+    void Enable(bool enable, bool positions)
+    {
+        if(enable != enabled || positions != with_positions)
+        {
+            Invalidate();
+        }
+
+        enabled = enable;
+        with_positions = positions;
+    }
+
+    bool IsEnabled() const
+    {
+        return enabled;
+    }
+
+    // The index of text, built on first use, or nullptr if the index is
+    // not enabled
+    const StringDigitIndex* Get(std::string_view text) const
+    {
+        if(!enabled)
+        {
+            return nullptr;
+        }
+
+        const StringDigitIndex *built = index.load(std::memory_order_acquire);
+
+        if(built == nullptr)
+        {
+            StringDigitIndex *fresh = new StringDigitIndex(BuildDigitIndex(text, with_positions));
+
+            if(index.compare_exchange_strong(built, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                built = fresh;
+            }
+            else
+            {
+                delete fresh;
+            }
+        }
+
+        return built;
+    }
+
+    bool IsBuilt() const
+    {
+        return index.load(std::memory_order_acquire) != nullptr;
+    }
+
+    // Drop the index, to be built again on the next Get
+    void Invalidate()
+    {
+        delete index.exchange(nullptr, std::memory_order_acq_rel);
+    }
+
+private:
+
+    bool enabled;
+    bool with_positions;
+    mutable std::atomic<const StringDigitIndex*> index;
+
+};
+
+} // namespace detail
+
+#endif // DIGIT_INDEX_H
@@ -0,0 +1,485 @@
+#ifndef ELEMENT_CONTAINER_H
+#define ELEMENT_CONTAINER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <vector>
+#include <type_traits>
+#include <utility>
+
+#include "elements.h"
+#include "instrumentation.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Heterogeneous element container
+//
+// Holds a mixed collection of elements in type-segregated contiguous
+// storage, one buffer per concrete element type. Visiting the
+// collection runs type-by-type over each buffer: the concrete type is
+// known for the whole run, so each buffer is handed to the visitor's
+// batch hook in a single call instead of an Accept +
+// ProcessXxxElement pair per element, and the access pattern is a
+// linear walk over memory which the prefetcher can follow.
+//
+// Insertion order is only retained within each element type.
+//
+// The container is allocator-aware (see elements.h): the buffers and
+// the payloads of the elements added to it all come from the memory
+// resource it was constructed with. An element from another resource
+// is copied into the container's resource when it is added.
+//
+// Observers, such as the live aggregates of live_aggregate.h, can
+// subscribe to the container. They are given every element already in
+// the container, then each element added, each change of value made
+// to an element in place, and Clear. A subscribed observer must be
+// unsubscribed before it is destroyed, and must not outlive the
+// container. Copying or moving a container does not copy or move its
+// subscriptions.
+//////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+
+// Fans the changes of the elements of one container out to all its
+// observers. The elements point to the list, which has a fixed
+// address and always stays with the container the observers
+// subscribed to.
+class ObserverList : public ElementObserver
+{
+
+public:
+
+    void Add(ElementObserver &observer)
+    {
+        observers.push_back(&observer);
+    }
+
+    void Remove(ElementObserver &observer)
+    {
+        observers.erase(std::remove(observers.begin(), observers.end(), &observer), observers.end());
+    }
+
+    void OnChange(const AbstractElement &element) { ForEach([&element](ElementObserver &observer) { observer.OnChange(element); }); }
+
+    void OnInsert(double value) { ForEach([value](ElementObserver &observer) { observer.OnInsert(value); }); }
+    void OnErase(double value) { ForEach([value](ElementObserver &observer) { observer.OnErase(value); }); }
+
+    void OnInsert(std::span<const double> values) { ForEach([values](ElementObserver &observer) { observer.OnInsert(values); }); }
+    void OnErase(std::span<const double> values) { ForEach([values](ElementObserver &observer) { observer.OnErase(values); }); }
+
+    void OnInsert(std::string_view text) { ForEach([text](ElementObserver &observer) { observer.OnInsert(text); }); }
+    void OnErase(std::string_view text) { ForEach([text](ElementObserver &observer) { observer.OnErase(text); }); }
+
+    void OnClear() { ForEach([](ElementObserver &observer) { observer.OnClear(); }); }
+
+private:
+
+    template<typename Function>
+    void ForEach(Function function)
+    {
+        for(ElementObserver *observer : observers)
+        {
+            function(*observer);
+        }
+    }
+
+    std::vector<ElementObserver*> observers;
+
+};
+
+} // namespace detail
+
+
+class ElementContainer
+{
+
+public:
+
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    explicit ElementContainer(const allocator_type &allocator = {})
+        : single_elements(allocator)
+        , array_elements(allocator)
+        , string_elements(allocator)
+    {
+    }
+
+    // The copy has the same elements, in the same memory resource, and
+    // no observers
+    ElementContainer(const ElementContainer &other)
+        : ElementContainer(other, other.get_allocator())
+    {
+    }
+
+    // The copy has the same elements, in the memory resource of
+    // allocator, and no observers
+    ElementContainer(const ElementContainer &other, const allocator_type &allocator)
+        : single_elements(other.single_elements, allocator)
+        , array_elements(other.array_elements, allocator)
+        , string_elements(other.string_elements, allocator)
+    {
+    }
+
+    // The observers stay with the container they subscribed to: the
+    // moved elements have no observer, and the emptied container
+    // reports a Clear to its own
+    ElementContainer(ElementContainer &&other) noexcept
+        : single_elements(std::move(other.single_elements))
+        , array_elements(std::move(other.array_elements))
+        , string_elements(std::move(other.string_elements))
+    {
+        SetObservers(nullptr);
+        other.Clear();
+    }
+
+    ElementContainer& operator=(const ElementContainer &other)
+    {
+        if(this != &other)
+        {
+            Clear();
+
+            for(const SingleElement &element : other.single_elements)
+            {
+                Add(element);
+            }
+
+            for(const ArrayElement &element : other.array_elements)
+            {
+                Add(element);
+            }
+
+            for(const StringElement &element : other.string_elements)
+            {
+                Add(element);
+            }
+        }
+
+        return *this;
+    }
+
+    // As for the copy, the observers of this container see a Clear and
+    // then the new elements, and those of other see a Clear
+    ElementContainer& operator=(ElementContainer &&other)
+    {
+        if(this != &other)
+        {
+            // Detached first, since with different memory resources the
+            // elements are moved into the existing ones one by one
+            SetObservers(nullptr);
+
+            if(observers)
+            {
+                observers->OnClear();
+            }
+
+            single_elements = std::move(other.single_elements);
+            array_elements = std::move(other.array_elements);
+            string_elements = std::move(other.string_elements);
+
+            other.Clear();
+
+            SetObservers(observers.get());
+
+            if(observers)
+            {
+                Report(*observers);
+            }
+        }
+
+        return *this;
+    }
+
+    allocator_type get_allocator() const
+    {
+        return single_elements.get_allocator();
+    }
+
+    void Add(SingleElement element)
+    {
+        Attach(single_elements.emplace_back(std::move(element)));
+    }
+
+    void Add(ArrayElement element)
+    {
+        Attach(array_elements.emplace_back(std::move(element)));
+    }
+
+    void Add(StringElement element)
+    {
+        Attach(string_elements.emplace_back(std::move(element)));
+    }
+
+    // Construct an element in place, its payload allocated directly
+    // from the container's memory resource
+    template<typename Element, typename... Args>
+    Element& Emplace(Args&&... args)
+    {
+        Element &element = GetElements<Element>().emplace_back(std::forward<Args>(args)...);
+        Attach(element);
+
+        return element;
+    }
+
+    // Subscribe an observer, which is first given every element already
+    // in the container
+    void Subscribe(ElementObserver &observer)
+    {
+        if(!observers)
+        {
+            observers = std::make_unique<detail::ObserverList>();
+
+            SetObservers(observers.get());
+        }
+
+        observers->Add(observer);
+
+        Report(observer);
+    }
+
+    void Unsubscribe(ElementObserver &observer)
+    {
+        if(observers)
+        {
+            observers->Remove(observer);
+        }
+    }
+
+    void Reserve(std::size_t single_count, std::size_t array_count, std::size_t string_count)
+    {
+        single_elements.reserve(single_count);
+        array_elements.reserve(array_count);
+        string_elements.reserve(string_count);
+    }
+
+    void Clear()
+    {
+        if(observers)
+        {
+            observers->OnClear();
+        }
+
+        single_elements.clear();
+        array_elements.clear();
+        string_elements.clear();
+    }
+
+    std::size_t Size() const
+    {
+        return single_elements.size() + array_elements.size() + string_elements.size();
+    }
+
+    bool Empty() const
+    {
+        return Size() == 0;
+    }
+
+    std::span<const SingleElement> GetSingleElements() const
+    {
+        return single_elements;
+    }
+
+    std::span<const ArrayElement> GetArrayElements() const
+    {
+        return array_elements;
+    }
+
+    std::span<const StringElement> GetStringElements() const
+    {
+        return string_elements;
+    }
+
+    // Mutable access, to update elements in place with SetValue
+    std::span<SingleElement> GetSingleElements()
+    {
+        return single_elements;
+    }
+
+    std::span<ArrayElement> GetArrayElements()
+    {
+        return array_elements;
+    }
+
+    std::span<StringElement> GetStringElements()
+    {
+        return string_elements;
+    }
+
+    // Classic engine: one virtual call per element type, into the
+    // visitor's batch hooks. Element types the visitor does not support
+    // are skipped as a whole, which costs one call to Supports per
+    // element type.
+    VisitResult Accept(AbstractVisitor &visitor) const
+    {
+        VisitResult result;
+
+        if(visitor.Supports(ElementType::Single))
+        {
+            VISIT_INSTRUMENTATION_SCOPE(visitor, single_elements);
+
+            visitor.ProcessSingleElements(single_elements);
+
+            result.AddVisited(single_elements.size());
+        }
+        else
+        {
+            VISIT_INSTRUMENTATION_SKIPPED(visitor, single_elements);
+
+            result.AddSkipped(single_elements.size());
+        }
+
+        if(visitor.Supports(ElementType::Array))
+        {
+            VISIT_INSTRUMENTATION_SCOPE(visitor, array_elements);
+
+            visitor.ProcessArrayElements(array_elements);
+
+            result.AddVisited(array_elements.size());
+        }
+        else
+        {
+            VISIT_INSTRUMENTATION_SKIPPED(visitor, array_elements);
+
+            result.AddSkipped(array_elements.size());
+        }
+
+        if(visitor.Supports(ElementType::String))
+        {
+            VISIT_INSTRUMENTATION_SCOPE(visitor, string_elements);
+
+            visitor.ProcessStringElements(string_elements);
+
+            result.AddVisited(string_elements.size());
+        }
+        else
+        {
+            VISIT_INSTRUMENTATION_SKIPPED(visitor, string_elements);
+
+            result.AddSkipped(string_elements.size());
+        }
+
+        return result;
+    }
+
+    // Static engine: the visitor is any function object with an
+    // overload for each element type, such as StaticSumVisitor. There
+    // is no dispatch at all, each loop calls one overload directly,
+    // and unsupported element types are skipped at compile time.
+    template<typename Visitor>
+    VisitResult Visit(Visitor &visitor) const
+    {
+        VisitResult result;
+
+        VisitSegment<ElementType::Single>(single_elements, visitor, result);
+        VisitSegment<ElementType::Array>(array_elements, visitor, result);
+        VisitSegment<ElementType::String>(string_elements, visitor, result);
+
+        return result;
+    }
+
+private:
+
+    // Point a newly added element to the observers and report it
+    template<typename Element>
+    void Attach(Element &element)
+    {
+        element.SetObserver(observers.get());
+
+        if(observers)
+        {
+            if constexpr(std::is_same_v<Element, SingleElement>)
+            {
+                observers->OnInsert(element.GetValue());
+            }
+            else
+            {
+                observers->OnInsert(element.GetView());
+            }
+        }
+    }
+
+    // Give observer every element of the container
+    void Report(ElementObserver &observer) const
+    {
+        for(const SingleElement &element : single_elements)
+        {
+            observer.OnInsert(element.GetValue());
+        }
+
+        for(const ArrayElement &element : array_elements)
+        {
+            observer.OnInsert(element.GetView());
+        }
+
+        for(const StringElement &element : string_elements)
+        {
+            observer.OnInsert(element.GetView());
+        }
+    }
+
+    void SetObservers(ElementObserver *observer)
+    {
+        for(SingleElement &element : single_elements)
+        {
+            element.SetObserver(observer);
+        }
+
+        for(ArrayElement &element : array_elements)
+        {
+            element.SetObserver(observer);
+        }
+
+        for(StringElement &element : string_elements)
+        {
+            element.SetObserver(observer);
+        }
+    }
+
+    template<typename Element>
+    std::pmr::vector<Element>& GetElements()
+    {
+        if constexpr(std::is_same_v<Element, SingleElement>)
+        {
+            return single_elements;
+        }
+        else if constexpr(std::is_same_v<Element, ArrayElement>)
+        {
+            return array_elements;
+        }
+        else
+        {
+            static_assert(std::is_same_v<Element, StringElement>, "ElementContainer cannot hold this element type");
+            return string_elements;
+        }
+    }
+
+    template<ElementType type, typename Element, typename Visitor>
+    static void VisitSegment(const std::pmr::vector<Element> &elements, Visitor &visitor, VisitResult &result)
+    {
+        if constexpr(SupportsElementType<Visitor>(type))
+        {
+            for(const Element &element : elements)
+            {
+                visitor(element);
+            }
+
+            result.AddVisited(elements.size());
+        }
+        else
+        {
+            result.AddSkipped(elements.size());
+        }
+    }
+
+    std::pmr::vector<SingleElement> single_elements;
+    std::pmr::vector<ArrayElement> array_elements;
+    std::pmr::vector<StringElement> string_elements;
+
+    std::unique_ptr<detail::ObserverList> observers;
+
+};
+
+#endif // ELEMENT_CONTAINER_H
@@ -0,0 +1,412 @@
+#ifndef ELEMENT_FILE_H
+#define ELEMENT_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "elements.h"
+#include "element_container.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Binary element files
+//
+// A compact on-disk format for element batches, which can be visited
+// straight from a memory mapping without building any elements.
+//
+// The file starts with an 8 byte header, the magic "VPEF" followed by
+// a 32 bit format version, and then holds one record per element:
+//
+//     uint32   element type (ElementType)
+//     uint32   reserved, zero
+//     uint64   payload length: 1 for a SingleElement, the number of
+//              doubles for an ArrayElement, the number of bytes for a
+//              StringElement
+//     ...      payload, zero padded to a multiple of 8 bytes
+//
+// Every record starts on an 8 byte boundary, so array payloads can be
+// read in place as doubles. Integers and doubles are stored in the
+// native byte order; files are not portable between little and big
+// endian machines.
+//////////////////////////////////////////////////////////////////////
+
+namespace element_file
+{
+
+constexpr char magic[4] = {'V', 'P', 'E', 'F'};
+constexpr std::uint32_t version = 1;
+
+constexpr std::size_t header_size = 8;
+constexpr std::size_t record_header_size = 16;
+constexpr std::size_t alignment = 8;
+
+constexpr std::size_t PaddedSize(std::size_t size)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+} // namespace element_file
+
+
+// Write elements to a binary element file, in the order given
+class ElementFileWriter
+{
+
+public:
+
+    explicit ElementFileWriter(const std::string &path)
+        : stream(path, std::ios::binary | std::ios::trunc)
+    {
+        if(!stream)
+        {
+            throw std::runtime_error("Error: cannot open element file for writing: " + path);
+        }
+
+        stream.write(element_file::magic, sizeof(element_file::magic));
+        WriteScalar(element_file::version);
+    }
+
+    void Write(const SingleElement &element)
+    {
+        double value = element.GetValue();
+
+        WriteRecord(ElementType::Single, 1, &value, sizeof(value));
+    }
+
+    void Write(const ArrayElement &element)
+    {
+        Write(element.GetView());
+    }
+
+    void Write(const StringElement &element)
+    {
+        Write(element.GetView());
+    }
+
+    void Write(std::span<const double> values)
+    {
+        WriteRecord(ElementType::Array, values.size(), values.data(), values.size_bytes());
+    }
+
+    void Write(std::string_view text)
+    {
+        WriteRecord(ElementType::String, text.size(), text.data(), text.size());
+    }
+
+    // Write every element of a container, one element type after the
+    // other, which is also the order in which it visits them
+    void Write(const ElementContainer &container)
+    {
+        for(const SingleElement &element : container.GetSingleElements())
+        {
+            Write(element);
+        }
+
+        for(const ArrayElement &element : container.GetArrayElements())
+        {
+            Write(element);
+        }
+
+        for(const StringElement &element : container.GetStringElements())
+        {
+            Write(element);
+        }
+    }
+
+    // Flush the file, throwing if any write failed
+    void Close()
+    {
+        stream.close();
+
+        if(!stream)
+        {
+            throw std::runtime_error("Error: failed to write element file");
+        }
+    }
+
+private:
+
+    template<typename T>
+    void WriteScalar(T value)
+    {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void WriteRecord(ElementType type, std::uint64_t length, const void *payload, std::size_t size)
+    {
+        static constexpr char padding[element_file::alignment] = {};
+
+        WriteScalar(static_cast<std::uint32_t>(type));
+        WriteScalar(std::uint32_t{0});
+        WriteScalar(length);
+
+        stream.write(static_cast<const char*>(payload), size);
+        stream.write(padding, element_file::PaddedSize(size) - size);
+    }
+
+    std::ofstream stream;
+
+};
+
+
+//////////////////////////////////////////////////////////////////////
+// Memory-mapped element file reader
+//
+// Maps a binary element file read-only and visits its records in file
+// order. Array and string payloads are handed to the visitor as views
+// into the mapping through ProcessArrayView and ProcessStringView, so
+// no ArrayElement or StringElement is ever materialized, and single
+// values are passed as a SingleElement on the stack.
+//
+// The pages behind the traversal are released every window_bytes, so
+// the resident memory stays constant however large the file is. The
+// data remains in the page cache, so visiting the file again does not
+// read it from disk unless the system is short of memory.
+//
+// Malformed files are reported with std::runtime_error, when the file
+// is opened for a bad header and during Accept for a bad record.
+//////////////////////////////////////////////////////////////////////
+
+class MappedElementFile
+{
+
+public:
+
+    explicit MappedElementFile(const std::string &path, std::size_t window_bytes = 64 * 1024 * 1024)
+        : data(nullptr)
+        , size(0)
+        , window_bytes(window_bytes)
+    {
+        int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if(descriptor < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Error: cannot open element file " + path);
+        }
+
+        struct stat status;
+
+        if(::fstat(descriptor, &status) != 0)
+        {
+            int error = errno;
+            ::close(descriptor);
+
+            throw std::system_error(error, std::generic_category(), "Error: cannot stat element file " + path);
+        }
+
+        size = static_cast<std::size_t>(status.st_size);
+
+        if(size > 0)
+        {
+            void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+            if(mapping == MAP_FAILED)
+            {
+                int error = errno;
+                ::close(descriptor);
+
+                throw std::system_error(error, std::generic_category(), "Error: cannot map element file " + path);
+            }
+
+            data = static_cast<const std::byte*>(mapping);
+        }
+
+        // The mapping keeps the file alive
+        ::close(descriptor);
+
+        if(size < element_file::header_size ||
+            std::memcmp(data, element_file::magic, sizeof(element_file::magic)) != 0 ||
+            ReadScalar<std::uint32_t>(sizeof(element_file::magic)) != element_file::version)
+        {
+            Unmap();
+
+            throw std::runtime_error("Error: not an element file, or unsupported version: " + path);
+        }
+
+        ::madvise(const_cast<std::byte*>(data), size, MADV_SEQUENTIAL);
+    }
+
+    MappedElementFile(const MappedElementFile&) = delete;
+    MappedElementFile& operator=(const MappedElementFile&) = delete;
+
+    ~MappedElementFile()
+    {
+        Unmap();
+    }
+
+    // Size of the file in bytes
+    std::size_t Size() const
+    {
+        return size;
+    }
+
+    // Visit every record in file order. Element types the visitor does
+    // not support are skipped without touching their payload.
+    VisitResult Accept(AbstractVisitor &visitor) const
+    {
+        VisitResult result;
+
+        const bool supports_single = visitor.Supports(ElementType::Single);
+        const bool supports_array = visitor.Supports(ElementType::Array);
+        const bool supports_string = visitor.Supports(ElementType::String);
+
+        std::size_t offset = element_file::header_size;
+        std::size_t released = 0;
+
+        while(offset < size)
+        {
+            if(size - offset < element_file::record_header_size)
+            {
+                throw std::runtime_error("Error: truncated element record header");
+            }
+
+            const std::uint32_t type = ReadScalar<std::uint32_t>(offset);
+            const std::uint32_t reserved = ReadScalar<std::uint32_t>(offset + 4);
+            const std::uint64_t length = ReadScalar<std::uint64_t>(offset + 8);
+
+            if(reserved != 0)
+            {
+                throw std::runtime_error("Error: malformed element record header");
+            }
+
+            const std::size_t payload_offset = offset + element_file::record_header_size;
+            const std::size_t available = size - payload_offset;
+
+            std::size_t payload_size = 0;
+
+            switch(static_cast<ElementType>(type))
+            {
+                case ElementType::Single:
+                    payload_size = sizeof(double);
+
+                    if(length != 1 || available < payload_size)
+                    {
+                        throw std::runtime_error("Error: malformed SingleElement record");
+                    }
+
+                    if(supports_single)
+                    {
+                        visitor.ProcessSingleElement(SingleElement(ReadScalar<double>(payload_offset)));
+                        result.AddVisited(1);
+                    }
+                    else
+                    {
+                        result.AddSkipped(1);
+                    }
+                    break;
+
+                case ElementType::Array:
+                    if(length > available / sizeof(double))
+                    {
+                        throw std::runtime_error("Error: truncated ArrayElement record");
+                    }
+
+                    payload_size = length * sizeof(double);
+
+                    if(supports_array)
+                    {
+                        visitor.ProcessArrayView(std::span<const double>(
+                            reinterpret_cast<const double*>(data + payload_offset), length));
+                        result.AddVisited(1);
+                    }
+                    else
+                    {
+                        result.AddSkipped(1);
+                    }
+                    break;
+
+                case ElementType::String:
+                    if(length > available)
+                    {
+                        throw std::runtime_error("Error: truncated StringElement record");
+                    }
+
+                    payload_size = length;
+
+                    if(supports_string)
+                    {
+                        visitor.ProcessStringView(std::string_view(
+                            reinterpret_cast<const char*>(data + payload_offset), length));
+                        result.AddVisited(1);
+                    }
+                    else
+                    {
+                        result.AddSkipped(1);
+                    }
+                    break;
+
+                default:
+                    throw std::runtime_error("Error: unknown element type in element file");
+            }
+
+            offset = payload_offset + std::min(element_file::PaddedSize(payload_size), available);
+
+            if(offset - released >= window_bytes)
+            {
+                released = Release(released, offset);
+            }
+        }
+
+        Release(released, size);
+
+        return result;
+    }
+
+private:
+
+    template<typename T>
+    T ReadScalar(std::size_t offset) const
+    {
+        T value;
+        std::memcpy(&value, data + offset, sizeof(value));
+
+        return value;
+    }
+
+    // Drop the pages of [begin, end) from this process, rounded to
+    // whole pages, and return where the next release should start
+    std::size_t Release(std::size_t begin, std::size_t end) const
+    {
+        const std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+        begin = begin / page_size * page_size;
+        end = end / page_size * page_size;
+
+        if(end > begin)
+        {
+            ::madvise(const_cast<std::byte*>(data) + begin, end - begin, MADV_DONTNEED);
+        }
+
+        return end;
+    }
+
+    void Unmap()
+    {
+        if(data != nullptr)
+        {
+            ::munmap(const_cast<std::byte*>(data), size);
+            data = nullptr;
+        }
+    }
+
+    const std::byte *data;
+    std::size_t size;
+    std::size_t window_bytes;
+
+};
+
+#endif // ELEMENT_FILE_H
@@ -0,0 +1,967 @@
+#ifndef ELEMENTS_H
+#define ELEMENTS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <span>
+#include <utility>
+
+#include "small_array.h"
+#include "digit_index.h"
+
+// Number of values an array element holds inline, without allocating
+// (see SmallArray). It can be set at build time, for example with
+// -DARRAY_ELEMENT_INLINE_CAPACITY=8, and must then be the same for
+// every translation unit of the program.
+#ifndef ARRAY_ELEMENT_INLINE_CAPACITY
+#define ARRAY_ELEMENT_INLINE_CAPACITY 4
+#endif
+
+class AbstractVisitor;
+class AbstractElement;
+
+
+//////////////////////////////////////////////////////////////////////
+// Observer of element values
+//
+// An element with an observer reports every change of its value made
+// with SetValue or assignment: the part of the payload which changes
+// is first erased from the observer with its old value and then
+// inserted with its new value. ElementContainer also reports the
+// elements added to it and Clear (see element_container.h), so that
+// live aggregates (live_aggregate.h) can follow a collection without
+// ever traversing it. OnChange is called first with the element which
+// changes, for observers which follow elements rather than values,
+// such as CachedAccept (cached_visit.h).
+//////////////////////////////////////////////////////////////////////
+
+class ElementObserver
+{
+
+public:
+
+    virtual
+    ~ElementObserver()
+    {
+        // I do nothing
+    }
+
+    // element is about to be given a new value
+    virtual void OnChange(const AbstractElement &element)
+    {
+        // I do nothing
+    }
+
+    virtual void OnInsert(double value) = 0;
+    virtual void OnErase(double value) = 0;
+
+    virtual void OnInsert(std::span<const double> values) = 0;
+    virtual void OnErase(std::span<const double> values) = 0;
+
+    virtual void OnInsert(std::string_view text) = 0;
+    virtual void OnErase(std::string_view text) = 0;
+
+    // Every element of the observed collection was removed
+    virtual void OnClear() = 0;
+
+};
+
+
+namespace detail
+{
+
+// Element versions are unique over the whole program, so an element
+// which replaces another, even at the same address, never shares its
+// version. Each thread takes versions from its own block to avoid
+// contention on the shared counter.
+inline std::uint64_t NextElementVersion()
+{
+    constexpr std::uint64_t block_size = 1 << 16;
+
+    static std::atomic<std::uint64_t> next_block{0};
+    thread_local std::uint64_t next = 0;
+    thread_local std::uint64_t end = 0;
+
+    if(next == end)
+    {
+        next = next_block.fetch_add(1, std::memory_order_relaxed) * block_size + 1;
+        end = next + block_size;
+    }
+
+    return next ++;
+}
+
+} // namespace detail
+
+
+class AbstractElement
+{
+
+public:
+
+    AbstractElement()
+        : version(detail::NextElementVersion())
+        , observer(nullptr)
+    {
+    }
+
+    virtual
+    ~AbstractElement();
+
+    virtual
+    void Accept(AbstractVisitor &visitor) = 0;
+
+    // Identifies the value of the element: a new version is taken
+    // whenever an element is constructed or its value is set, and
+    // copies keep the version of the original since their value is
+    // the same. Used by CachedAccept (cached_visit.h) to find the
+    // elements whose results have to be recomputed.
+    std::uint64_t GetVersion() const
+    {
+        return version;
+    }
+
+    // Normally set by the collection holding the element. The observer
+    // belongs to the element's place in a collection: a copy has no
+    // observer, an element moved into a new place takes it with it, and
+    // assignment keeps the observer of the element assigned to.
+    ElementObserver* GetObserver() const
+    {
+        return observer;
+    }
+
+    void SetObserver(ElementObserver *observer)
+    {
+        this->observer = observer;
+    }
+
+protected:
+
+    AbstractElement(const AbstractElement &other)
+        : version(other.version)
+        , observer(nullptr)
+    {
+    }
+
+    AbstractElement(AbstractElement &&other) noexcept
+        : version(other.version)
+        , observer(other.observer)
+    {
+        other.observer = nullptr;
+    }
+
+    AbstractElement& operator=(const AbstractElement &other)
+    {
+        version = other.version;
+
+        return *this;
+    }
+
+    // Called by SetValue
+    void Touch()
+    {
+        version = detail::NextElementVersion();
+    }
+
+    // Report a change of value to the observer, if any, before it is made
+    template<typename Payload>
+    void NotifyChange(Payload old_value, Payload new_value)
+    {
+        if(observer != nullptr)
+        {
+            observer->OnChange(*this);
+            observer->OnErase(old_value);
+            observer->OnInsert(new_value);
+        }
+    }
+
+private:
+
+    std::uint64_t version;
+    ElementObserver *observer;
+
+};
+
+inline
+AbstractElement::~AbstractElement()
+{
+    // I do nothing
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Pre-emptive declaration of AbstractVisitor, used by classes below
+//////////////////////////////////////////////////////////////////////
+
+class SingleElement;
+class StringElement;
+class ArrayElementPool;
+
+template<typename T>
+class BasicArrayElement;
+
+using ArrayElement = BasicArrayElement<double>;
+
+enum class ElementType
+{
+    Single,
+    Array,
+    String
+};
+
+class AbstractVisitor
+{
+
+public:
+
+    virtual
+    ~AbstractVisitor()
+    {
+
+    }
+
+    // Whether this visitor can process elements of the given type.
+    // Traversals check this once per run of same-typed elements and
+    // skip the elements which are not supported, rather than relying
+    // on the visitor to signal an error for each one. Visitors known
+    // at compile time should also declare a static constexpr
+    // SupportsElementType (see visit_result.h) so that the static
+    // engine can skip unsupported types without any check.
+    virtual bool Supports(ElementType type) const
+    {
+        return true;
+    }
+
+    virtual void ProcessSingleElement(const SingleElement& element) = 0;
+    virtual void ProcessArrayElement(const ArrayElement& element) = 0;
+    virtual void ProcessStringElement(const StringElement& element) = 0;
+
+    // Arrays of the other value types (BasicArrayElement<T> below).
+    // The defaults widen the values to double and forward them to
+    // ProcessArrayView, so visitors written for ArrayElement see a
+    // typed array as the same values in double. The built-in visitors
+    // override them to reduce the values in their own type.
+    virtual void ProcessArrayElement(const BasicArrayElement<float>& element);
+    virtual void ProcessArrayElement(const BasicArrayElement<std::int32_t>& element);
+    virtual void ProcessArrayElement(const BasicArrayElement<std::int64_t>& element);
+
+    // Batch entry points, called by the containers once per run of
+    // same-typed elements, so a run costs one virtual call rather than
+    // one per element. The defaults loop over the elements and call
+    // the per-element functions above; visitors can override them with
+    // a tight loop the compiler can inline and vectorize. An override
+    // must give the same result as the default.
+    virtual void ProcessSingleElements(std::span<const SingleElement> elements);
+    virtual void ProcessArrayElements(std::span<const ArrayElement> elements);
+    virtual void ProcessStringElements(std::span<const StringElement> elements);
+
+    // Zero-copy entry point for array payloads which are not owned by
+    // an ArrayElement, such as the arrays of an ArrayElementPool. The
+    // default materializes a temporary ArrayElement and forwards it to
+    // ProcessArrayElement, so visitors which only implement the three
+    // functions above keep working. The built-in visitors override it.
+    virtual void ProcessArrayView(std::span<const double> values);
+
+    // Visit every array held by a pool. The default calls
+    // ProcessArrayView once per array; reductions which do not
+    // depend on the array boundaries can override it to make a
+    // single pass over the pool's contiguous value buffer.
+    virtual void ProcessArrayElementPool(const ArrayElementPool& pool);
+
+    // Zero-copy entry point for string payloads which are not owned by
+    // a StringElement, or for part of one. As for ProcessArrayView, the
+    // default materializes a temporary StringElement.
+    virtual void ProcessStringView(std::string_view text);
+
+    // Incremental string path, used by StringStream (string_stream.h)
+    // for strings which arrive in pieces. A visitor which returns true
+    // from SupportsStringChunks folds each chunk into a pending state
+    // in ProcessStringChunk, and FinishString then applies the pending
+    // state exactly as ProcessStringView would have applied the whole
+    // string. For the other visitors StringStream buffers the chunks
+    // and calls ProcessStringView once the string is complete.
+    virtual bool SupportsStringChunks() const
+    {
+        return false;
+    }
+
+    virtual void ProcessStringChunk(std::string_view chunk)
+    {
+        // I do nothing
+    }
+
+    virtual void FinishString()
+    {
+        // I do nothing
+    }
+
+    // Number of elements this visitor was given but could not process,
+    // such as numeric elements passed directly to XORVisitor. Read by
+    // the traversal instrumentation (instrumentation.h).
+    virtual std::size_t GetUnsupportedCount() const
+    {
+        return 0;
+    }
+
+};
+
+
+class SingleElement : public AbstractElement
+{
+
+public:
+
+    SingleElement(double value)
+        : value(value)
+    {
+    }
+
+    SingleElement(const SingleElement &other) = default;
+    SingleElement(SingleElement &&other) = default;
+
+    SingleElement& operator=(const SingleElement &other)
+    {
+        NotifyChange(value, other.value);
+
+        value = other.value;
+        AbstractElement::operator=(other);
+
+        return *this;
+    }
+
+    virtual
+    ~SingleElement()
+    {
+        // I do nothing
+    }
+
+    double GetValue() const
+    {
+        return value;
+    }
+
+    void SetValue(const double value)
+    {
+        NotifyChange(this->value, value);
+
+        this->value = value;
+        Touch();
+    }
+
+    void Accept(AbstractVisitor &visitor)
+    {
+        visitor.ProcessSingleElement(*this);
+    }
+
+private:
+
+    double value;
+};
+
+
+//////////////////////////////////////////////////////////////////////
+// Allocator support
+//
+// ArrayElement, StringElement, ArrayElementPool and ElementContainer
+// store their payloads through std::pmr, and are allocator-aware:
+// they declare allocator_type and accept an allocator as the last
+// constructor argument. A pmr container of elements passes its
+// allocator on to each element it constructs, so a whole batch can be
+// built in a std::pmr::monotonic_buffer_resource and released at once
+// when the resource goes out of scope:
+//
+//     std::pmr::monotonic_buffer_resource arena;
+//     ElementContainer element_container(&arena);
+//
+// With no allocator, the default memory resource (new and delete) is
+// used as before.
+//////////////////////////////////////////////////////////////////////
+
+// Value types an array element can hold, each of which has its own
+// ProcessArrayElement overload in AbstractVisitor
+template<typename T>
+inline constexpr bool is_array_value_type =
+    std::is_same_v<T, double> || std::is_same_v<T, float> ||
+    std::is_same_v<T, std::int32_t> || std::is_same_v<T, std::int64_t>;
+
+// An array of values of type T, where ArrayElement holds doubles. Feeds
+// of floats or 32-bit integers can be visited in their own type rather
+// than widened to double first, which halves the memory traffic of
+// the reductions.
+//
+// Up to ARRAY_ELEMENT_INLINE_CAPACITY values are stored in the element
+// itself, so small arrays cost no allocation of their own and are
+// visited without following a pointer. Larger arrays are allocated
+// from the element's memory resource.
+template<typename T>
+class BasicArrayElement : public AbstractElement
+{
+
+    static_assert(is_array_value_type<T>,
+        "BasicArrayElement holds double, float, std::int32_t or std::int64_t values");
+
+public:
+
+    using value_type = T;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    static constexpr std::size_t inline_capacity = ARRAY_ELEMENT_INLINE_CAPACITY;
+
+    // The element uses the payload's allocator
+    BasicArrayElement(const std::pmr::vector<T> &value)
+        : value(std::span<const T>(value), value.get_allocator())
+    {
+    }
+
+    BasicArrayElement(std::initializer_list<T> value, const allocator_type &allocator = {})
+        : value(std::span<const T>(value.begin(), value.size()), allocator)
+    {
+    }
+
+    BasicArrayElement(std::span<const T> value, const allocator_type &allocator = {})
+        : value(value, allocator)
+    {
+    }
+
+    BasicArrayElement(const BasicArrayElement &other) = default;
+    BasicArrayElement(BasicArrayElement &&other) = default;
+
+    BasicArrayElement(const BasicArrayElement &other, const allocator_type &allocator)
+        : AbstractElement(other)
+        , value(other.value, allocator)
+    {
+    }
+
+    BasicArrayElement(BasicArrayElement &&other, const allocator_type &allocator)
+        : AbstractElement(std::move(other))
+        , value(std::move(other.value), allocator)
+    {
+    }
+
+    BasicArrayElement& operator=(const BasicArrayElement &other)
+    {
+        if(this != &other)
+        {
+            NotifyValues(GetView(), other.GetView());
+
+            value = other.value;
+            AbstractElement::operator=(other);
+        }
+
+        return *this;
+    }
+
+    BasicArrayElement& operator=(BasicArrayElement &&other)
+    {
+        if(this != &other)
+        {
+            NotifyValues(GetView(), other.GetView());
+
+            value = std::move(other.value);
+            AbstractElement::operator=(other);
+        }
+
+        return *this;
+    }
+
+    virtual
+    ~BasicArrayElement()
+    {
+        // I do nothing
+    }
+
+    allocator_type get_allocator() const
+    {
+        return value.get_allocator();
+    }
+
+    std::span<const T> GetValue() const
+    {
+        return value.GetView();
+    }
+
+    // Zero-copy view of the payload, used by the visitors on the hot path
+    std::span<const T> GetView() const
+    {
+        return value.GetView();
+    }
+
+    // Whether the values are held in the element itself
+    bool IsInline() const
+    {
+        return value.IsInline();
+    }
+
+    // The payload is copied into the element's own memory resource
+    void SetValue(std::span<const T> value)
+    {
+        NotifyValues(GetView(), value);
+
+        this->value.Assign(value);
+        Touch();
+    }
+
+    void SetValue(std::initializer_list<T> value)
+    {
+        SetValue(std::span<const T>(value.begin(), value.size()));
+    }
+
+    // Overwrite the values from first on, which must be in the array.
+    // Only the overwritten values are reported to the observer.
+    void SetValue(std::size_t first, std::span<const T> values)
+    {
+        if(first > value.Size() || values.size() > value.Size() - first)
+        {
+            throw std::out_of_range("Error: ArrayElement::SetValue range is out of the array");
+        }
+
+        NotifyValues(GetView().subspan(first, values.size()), values);
+
+        std::copy(values.begin(), values.end(), value.GetData() + first);
+        Touch();
+    }
+
+    void Accept(AbstractVisitor &visitor)
+    {
+        visitor.ProcessArrayElement(*this);
+    }
+
+private:
+
+    // Observers take double values, so the values of the other types
+    // are widened for them
+    void NotifyValues(std::span<const T> old_values, std::span<const T> new_values)
+    {
+        if constexpr(std::is_same_v<T, double>)
+        {
+            NotifyChange(old_values, new_values);
+        }
+        else if(GetObserver() != nullptr)
+        {
+            const std::vector<double> old_widened(old_values.begin(), old_values.end());
+            const std::vector<double> new_widened(new_values.begin(), new_values.end());
+
+            NotifyChange(std::span<const double>(old_widened), std::span<const double>(new_widened));
+        }
+    }
+
+    SmallArray<T, inline_capacity> value;
+
+};
+
+
+//////////////////////////////////////////////////////////////////////
+// Structure-of-arrays storage for many ArrayElement payloads
+//
+// All payloads are stored back to back in one buffer of doubles, with
+// an offsets array marking where each array starts. Array i occupies
+// values[offsets[i], offsets[i + 1]). A batch of N arrays therefore
+// costs two allocations rather than N.
+//////////////////////////////////////////////////////////////////////
+
+class ArrayElementHandle;
+
+class ArrayElementPool
+{
+
+public:
+
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    explicit ArrayElementPool(const allocator_type &allocator = {})
+        : values(allocator)
+        , offsets(1, 0, allocator)
+    {
+    }
+
+    ArrayElementPool(const ArrayElementPool &other, const allocator_type &allocator)
+        : values(other.values, allocator)
+        , offsets(other.offsets, allocator)
+    {
+    }
+
+    ArrayElementPool(ArrayElementPool &&other, const allocator_type &allocator)
+        : values(std::move(other.values), allocator)
+        , offsets(std::move(other.offsets), allocator)
+    {
+    }
+
+    ArrayElementPool(const ArrayElementPool &other) = default;
+    ArrayElementPool(ArrayElementPool &&other) = default;
+    ArrayElementPool& operator=(const ArrayElementPool &other) = default;
+    ArrayElementPool& operator=(ArrayElementPool &&other) = default;
+
+    allocator_type get_allocator() const
+    {
+        return values.get_allocator();
+    }
+
+    void Reserve(std::size_t array_count, std::size_t value_count)
+    {
+        offsets.reserve(array_count + 1);
+        values.reserve(value_count);
+    }
+
+    // Append an array, returning its index in the pool
+    std::size_t Add(std::span<const double> array)
+    {
+        values.insert(values.end(), array.begin(), array.end());
+        offsets.push_back(values.size());
+
+        return offsets.size() - 2;
+    }
+
+    std::size_t Add(std::initializer_list<double> array)
+    {
+        return Add(std::span<const double>(array.begin(), array.size()));
+    }
+
+    void Clear()
+    {
+        values.clear();
+        offsets.resize(1);
+    }
+
+    // Number of arrays in the pool
+    std::size_t Size() const
+    {
+        return offsets.size() - 1;
+    }
+
+    // Number of values over all arrays in the pool
+    std::size_t GetValueCount() const
+    {
+        return values.size();
+    }
+
+    std::span<const double> GetView(std::size_t index) const
+    {
+        return std::span<const double>(values).subspan(
+            offsets[index], offsets[index + 1] - offsets[index]);
+    }
+
+    // The whole value buffer, all arrays concatenated in order
+    std::span<const double> GetValues() const
+    {
+        return values;
+    }
+
+    std::span<const std::size_t> GetOffsets() const
+    {
+        return offsets;
+    }
+
+    ArrayElementHandle operator[](std::size_t index) const;
+
+    void Accept(AbstractVisitor &visitor) const
+    {
+        visitor.ProcessArrayElementPool(*this);
+    }
+
+private:
+
+    std::pmr::vector<double> values;
+    std::pmr::vector<std::size_t> offsets;
+
+};
+
+
+// Lightweight reference to one array of an ArrayElementPool. It does
+// not own the payload and is invalidated when the pool is modified.
+class ArrayElementHandle
+{
+
+public:
+
+    ArrayElementHandle(const ArrayElementPool &pool, std::size_t index)
+        : pool(&pool)
+        , index(index)
+    {
+    }
+
+    std::span<const double> GetView() const
+    {
+        return pool->GetView(index);
+    }
+
+    std::size_t GetIndex() const
+    {
+        return index;
+    }
+
+    void Accept(AbstractVisitor &visitor) const
+    {
+        visitor.ProcessArrayView(GetView());
+    }
+
+private:
+
+    const ArrayElementPool *pool;
+    std::size_t index;
+
+};
+
+
+inline
+ArrayElementHandle ArrayElementPool::operator[](std::size_t index) const
+{
+    return ArrayElementHandle(*this, index);
+}
+
+
+class StringElement : public AbstractElement
+{
+
+public:
+
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    StringElement(std::pmr::string value)
+        : value(std::move(value))
+    {
+    }
+
+    StringElement(std::string_view value, const allocator_type &allocator = {})
+        : value(value, allocator)
+    {
+    }
+
+    StringElement(const char *value, const allocator_type &allocator = {})
+        : value(value, allocator)
+    {
+    }
+
+    StringElement(const StringElement &other) = default;
+    StringElement(StringElement &&other) = default;
+
+    StringElement(const StringElement &other, const allocator_type &allocator)
+        : AbstractElement(other)
+        , value(other.value, allocator)
+        , digit_index(other.digit_index)
+    {
+    }
+
+    StringElement(StringElement &&other, const allocator_type &allocator)
+        : AbstractElement(std::move(other))
+        , value(std::move(other.value), allocator)
+        , digit_index(std::move(other.digit_index))
+    {
+    }
+
+    StringElement& operator=(const StringElement &other)
+    {
+        if(this != &other)
+        {
+            NotifyChange(GetView(), other.GetView());
+
+            value = other.value;
+            digit_index.Invalidate();
+            AbstractElement::operator=(other);
+        }
+
+        return *this;
+    }
+
+    StringElement& operator=(StringElement &&other)
+    {
+        if(this != &other)
+        {
+            NotifyChange(GetView(), other.GetView());
+
+            value = std::move(other.value);
+            digit_index.Invalidate();
+            other.digit_index.Invalidate();
+            AbstractElement::operator=(other);
+        }
+
+        return *this;
+    }
+
+    virtual
+    ~StringElement()
+    {
+        // I do nothing
+    }
+
+    allocator_type get_allocator() const
+    {
+        return value.get_allocator();
+    }
+
+    const std::pmr::string& GetValue() const
+    {
+        return value;
+    }
+
+    // Zero-copy view of the payload, used by the visitors on the hot path
+    std::string_view GetView() const
+    {
+        return value;
+    }
+
+    // The payload is copied into the element's own memory resource
+    void SetValue(std::string_view value)
+    {
+        NotifyChange(GetView(), value);
+
+        this->value.assign(value);
+        digit_index.Invalidate();
+        Touch();
+    }
+
+    void SetValue(std::pmr::string&& value)
+    {
+        NotifyChange(GetView(), std::string_view(value));
+
+        this->value = std::move(value);
+        digit_index.Invalidate();
+        Touch();
+    }
+
+    // Overwrite the characters from first on, which must be in the
+    // string. Only the overwritten characters are reported to the
+    // observer.
+    void SetValue(std::size_t first, std::string_view text)
+    {
+        if(first > value.size() || text.size() > value.size() - first)
+        {
+            throw std::out_of_range("Error: StringElement::SetValue range is out of the string");
+        }
+
+        NotifyChange(GetView().substr(first, text.size()), text);
+
+        value.replace(first, text.size(), text);
+        digit_index.Invalidate();
+        Touch();
+    }
+
+    // Keep a digit index of the string (see digit_index.h), built on
+    // the first visit and dropped whenever the value changes, so that
+    // the built-in visitors do not scan the string again on every visit.
+    // Worth it for long strings which are visited more often than they
+    // change. with_positions also records the offset of every digit.
+    void EnableDigitIndex(bool enable = true, bool with_positions = false)
+    {
+        digit_index.Enable(enable, with_positions);
+    }
+
+    bool IsDigitIndexEnabled() const
+    {
+        return digit_index.IsEnabled();
+    }
+
+    // The digit index, built now if it is enabled and not built yet, or
+    // nullptr if it is not enabled
+    const StringDigitIndex* GetDigitIndex() const
+    {
+        return digit_index.Get(value);
+    }
+
+    void Accept(AbstractVisitor &visitor)
+    {
+        visitor.ProcessStringElement(*this);
+    }
+
+private:
+
+    std::pmr::string value;
+    detail::DigitIndexCache digit_index;
+
+};
+
+
+//////////////////////////////////////////////////
+// Default implementations of the AbstractVisitor
+// batch and zero-copy hooks, which need the element
+// types
+//////////////////////////////////////////////////
+
+inline
+void AbstractVisitor::ProcessSingleElements(std::span<const SingleElement> elements)
+{
+    for(const SingleElement &element : elements)
+    {
+        ProcessSingleElement(element);
+    }
+}
+
+inline
+void AbstractVisitor::ProcessArrayElements(std::span<const ArrayElement> elements)
+{
+    for(const ArrayElement &element : elements)
+    {
+        ProcessArrayElement(element);
+    }
+}
+
+inline
+void AbstractVisitor::ProcessStringElements(std::span<const StringElement> elements)
+{
+    for(const StringElement &element : elements)
+    {
+        ProcessStringElement(element);
+    }
+}
+
+inline
+void AbstractVisitor::ProcessArrayView(std::span<const double> values)
+{
+    ProcessArrayElement(ArrayElement(values));
+}
+
+namespace detail
+{
+
+template<typename T>
+void ProcessWidenedArray(AbstractVisitor &visitor, std::span<const T> values)
+{
+    const std::vector<double> widened(values.begin(), values.end());
+
+    visitor.ProcessArrayView(widened);
+}
+
+} // namespace detail
+
+inline
+void AbstractVisitor::ProcessArrayElement(const BasicArrayElement<float> &element)
+{
+    detail::ProcessWidenedArray(*this, element.GetView());
+}
+
+inline
+void AbstractVisitor::ProcessArrayElement(const BasicArrayElement<std::int32_t> &element)
+{
+    detail::ProcessWidenedArray(*this, element.GetView());
+}
+
+inline
+void AbstractVisitor::ProcessArrayElement(const BasicArrayElement<std::int64_t> &element)
+{
+    detail::ProcessWidenedArray(*this, element.GetView());
+}
+
+inline
+void AbstractVisitor::ProcessArrayElementPool(const ArrayElementPool &pool)
+{
+    for(std::size_t index = 0; index < pool.Size(); ++ index)
+    {
+        ProcessArrayView(pool.GetView(index));
+    }
+}
+
+inline
+void AbstractVisitor::ProcessStringView(std::string_view text)
+{
+    ProcessStringElement(StringElement(text));
+}
+
+#endif // ELEMENTS_H
@@ -0,0 +1,377 @@
+#ifndef FUSED_VISITOR_H
+#define FUSED_VISITOR_H
+
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "elements.h"
+#include "visitors.h"
+#include "checksum_visitors.h"
+#include "kernels.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Fused multi-visitor traversal
+//
+// FusedVisitor forwards each element to several visitors, so that a
+// collection is only traversed once however many results are needed:
+//
+//     FusedVisitor fused_visitor(sum_visitor, multiply_visitor, xor_visitor);
+//     element_container.Accept(fused_visitor);
+//
+// Visitors are held by reference and keep their own results.
+//
+// When the built-in reductions are fused, their results are computed
+// by a single kernel which loads each payload once:
+//
+// - arrays, when both a SumVisitor and a MultiplyVisitor are present
+//   (kernels::SumAndProduct, in the ReductionMode of the first
+//   SumVisitor; visitors using a different mode are visited separately)
+// - strings, when at least two of SumVisitor, MultiplyVisitor and
+//   XORVisitor are present (kernels::ScanString)
+//
+// The results are identical to visiting with each visitor in turn.
+// Strings with a digit index (StringElement::EnableDigitIndex) are not
+// scanned: the built-in reductions read their index.
+// Any other visitor is forwarded the element unchanged. When strings
+// are fused, or a checksum visitor (checksum_visitors.h) is fused with
+// a built-in string reduction or another checksum visitor, runs of
+// strings are visited one string at a time, so each string is read
+// from memory once and then hashed from the cache.
+//
+// The fused visitor supports an element type when any of its visitors
+// does, and each element is only forwarded to the visitors which
+// support its type.
+//////////////////////////////////////////////////////////////////////
+
+template<typename... Visitors>
+class FusedVisitor : public AbstractVisitor
+{
+
+    static_assert(sizeof...(Visitors) > 0, "FusedVisitor requires at least one visitor");
+    static_assert((std::is_base_of_v<AbstractVisitor, Visitors> && ...),
+        "FusedVisitor can only fuse classes derived from AbstractVisitor");
+
+public:
+
+    FusedVisitor(Visitors&... visitors)
+        : visitors(visitors...)
+    {
+    }
+
+    bool Supports(ElementType type) const
+    {
+        return std::apply(
+            [type](const auto&... visitor) { return (VisitorSupports(visitor, type) || ...); },
+            visitors);
+    }
+
+    void ProcessSingleElement(const SingleElement& element)
+    {
+        ForEach(ElementType::Single, [&element](auto &visitor) { visitor.ProcessSingleElement(element); });
+    }
+
+    void ProcessSingleElements(std::span<const SingleElement> elements)
+    {
+        ForEach(ElementType::Single, [elements](auto &visitor) { visitor.ProcessSingleElements(elements); });
+    }
+
+    // Fused runs are visited element by element, so that each payload
+    // is only loaded once for all the visitors
+    void ProcessArrayElements(std::span<const ArrayElement> elements)
+    {
+        if constexpr(fuse_arrays)
+        {
+            for(const ArrayElement &element : elements)
+            {
+                ProcessArrayElement(element);
+            }
+        }
+        else
+        {
+            ForEach(ElementType::Array, [elements](auto &visitor) { visitor.ProcessArrayElements(elements); });
+        }
+    }
+
+    void ProcessStringElements(std::span<const StringElement> elements)
+    {
+        if constexpr(fuse_strings)
+        {
+            for(const StringElement &element : elements)
+            {
+                ProcessStringElement(element);
+            }
+        }
+        else
+        {
+            ForEach(ElementType::String, [elements](auto &visitor) { visitor.ProcessStringElements(elements); });
+        }
+    }
+
+    void ProcessArrayElement(const ArrayElement& element)
+    {
+        auto forward = [&element](auto &visitor) { visitor.ProcessArrayElement(element); };
+
+        if constexpr(fuse_arrays)
+        {
+            ProcessFusedArray(element.GetView(), forward);
+        }
+        else
+        {
+            ForEach(ElementType::Array, forward);
+        }
+    }
+
+    void ProcessArrayView(std::span<const double> values)
+    {
+        auto forward = [values](auto &visitor) { visitor.ProcessArrayView(values); };
+
+        if constexpr(fuse_arrays)
+        {
+            ProcessFusedArray(values, forward);
+        }
+        else
+        {
+            ForEach(ElementType::Array, forward);
+        }
+    }
+
+    void ProcessArrayElementPool(const ArrayElementPool& pool)
+    {
+        auto forward = [&pool](auto &visitor) { visitor.ProcessArrayElementPool(pool); };
+
+        if constexpr(fuse_arrays)
+        {
+            ProcessFusedArray(pool.GetValues(), forward);
+        }
+        else
+        {
+            ForEach(ElementType::Array, forward);
+        }
+    }
+
+    // Typed arrays are forwarded through AbstractVisitor, so a visitor
+    // overriding only the ArrayElement overload hides none of the others
+    void ProcessArrayElement(const BasicArrayElement<float>& element)
+    {
+        ProcessTypedArray(element);
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<std::int32_t>& element)
+    {
+        ProcessTypedArray(element);
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<std::int64_t>& element)
+    {
+        ProcessTypedArray(element);
+    }
+
+    void ProcessStringElement(const StringElement& element)
+    {
+        auto forward = [&element](auto &visitor) { visitor.ProcessStringElement(element); };
+
+        if constexpr(fuse_strings)
+        {
+            // The built-in reductions of a string with a digit index read
+            // it rather than the string, so there is no scan to share
+            if(element.GetDigitIndex() != nullptr)
+            {
+                ForEach(ElementType::String, forward);
+            }
+            else
+            {
+                ProcessFusedString(element.GetView(), forward);
+            }
+        }
+        else
+        {
+            ForEach(ElementType::String, forward);
+        }
+    }
+
+    void ProcessStringView(std::string_view text)
+    {
+        auto forward = [text](auto &visitor) { visitor.ProcessStringView(text); };
+
+        if constexpr(fuse_strings)
+        {
+            ProcessFusedString(text, forward);
+        }
+        else
+        {
+            ForEach(ElementType::String, forward);
+        }
+    }
+
+    // Chunks are forwarded to each visitor which supports strings, so
+    // this needs all of them to support chunks
+    bool SupportsStringChunks() const
+    {
+        return std::apply(
+            [](const auto&... visitor)
+            {
+                return ((!VisitorSupports(visitor, ElementType::String) || visitor.SupportsStringChunks()) && ...);
+            },
+            visitors);
+    }
+
+    void ProcessStringChunk(std::string_view chunk)
+    {
+        ForEach(ElementType::String, [chunk](auto &visitor) { visitor.ProcessStringChunk(chunk); });
+    }
+
+    void FinishString()
+    {
+        ForEach(ElementType::String, [](auto &visitor) { visitor.FinishString(); });
+    }
+
+private:
+
+    template<typename Visitor>
+    static constexpr bool is_sum = std::is_same_v<Visitor, SumVisitor>;
+
+    template<typename Visitor>
+    static constexpr bool is_multiply = std::is_same_v<Visitor, MultiplyVisitor>;
+
+    template<typename Visitor>
+    static constexpr bool is_xor = std::is_same_v<Visitor, XORVisitor>;
+
+    static constexpr bool fuse_arrays =
+        (is_sum<Visitors> || ...) && (is_multiply<Visitors> || ...);
+
+    // Whether the built-in string reductions share one ScanString
+    static constexpr bool scan_strings =
+        ((is_sum<Visitors> || is_multiply<Visitors> || is_xor<Visitors> ? 1 : 0) + ...) > 1;
+
+    static constexpr bool fuse_strings = scan_strings ||
+        ((is_sum<Visitors> || is_multiply<Visitors> || is_xor<Visitors> ? 1 : 0) + ...) +
+        ((IsChecksumVisitor<Visitors>::value ? 1 : 0) + ...) > 1;
+
+    template<typename Function>
+    void ForEach(Function function)
+    {
+        std::apply([&function](auto&... visitor) { (function(visitor), ...); }, visitors);
+    }
+
+    // Apply function to the visitors which support the element type
+    template<typename Function>
+    void ForEach(ElementType type, Function function)
+    {
+        ForEach(
+            [type, &function](auto &visitor)
+            {
+                if(VisitorSupports(visitor, type))
+                {
+                    function(visitor);
+                }
+            });
+    }
+
+    ReductionMode GetFusedMode()
+    {
+        bool found = false;
+        ReductionMode mode = ReductionMode::Strict;
+
+        ForEach(
+            [&found, &mode](auto &visitor)
+            {
+                using Visitor = std::decay_t<decltype(visitor)>;
+
+                if constexpr(is_sum<Visitor>)
+                {
+                    if(!found)
+                    {
+                        mode = visitor.GetMode();
+                        found = true;
+                    }
+                }
+            });
+
+        return mode;
+    }
+
+    template<typename T>
+    void ProcessTypedArray(const BasicArrayElement<T> &element)
+    {
+        ForEach(ElementType::Array,
+            [&element](AbstractVisitor &visitor) { visitor.ProcessArrayElement(element); });
+    }
+
+    template<typename Forward>
+    void ProcessFusedArray(std::span<const double> values, Forward forward)
+    {
+        const ReductionMode mode = GetFusedMode();
+        const auto result = kernels::SumAndProduct(values, mode);
+
+        ForEach(
+            [&](auto &visitor)
+            {
+                using Visitor = std::decay_t<decltype(visitor)>;
+
+                if constexpr(is_sum<Visitor>)
+                {
+                    if(visitor.GetMode() == mode)
+                    {
+                        visitor.Accumulate(result.sum);
+                        return;
+                    }
+                }
+                else if constexpr(is_multiply<Visitor>)
+                {
+                    if(visitor.GetMode() == mode)
+                    {
+                        visitor.Accumulate(result.product);
+                        return;
+                    }
+                }
+
+                if(VisitorSupports(visitor, ElementType::Array))
+                {
+                    forward(visitor);
+                }
+            });
+    }
+
+    template<typename Forward>
+    void ProcessFusedString(std::string_view text, Forward forward)
+    {
+        if constexpr(!scan_strings)
+        {
+            ForEach(ElementType::String, forward);
+            return;
+        }
+
+        const kernels::StringStatistics statistics = kernels::ScanString(text);
+
+        ForEach(
+            [&](auto &visitor)
+            {
+                using Visitor = std::decay_t<decltype(visitor)>;
+
+                if constexpr(is_sum<Visitor>)
+                {
+                    visitor.Accumulate(statistics.digit_sum);
+                }
+                else if constexpr(is_multiply<Visitor>)
+                {
+                    visitor.Accumulate(statistics.digit_product);
+                }
+                else if constexpr(is_xor<Visitor>)
+                {
+                    visitor.Accumulate(statistics.checksum);
+                }
+                else if(VisitorSupports(visitor, ElementType::String))
+                {
+                    forward(visitor);
+                }
+            });
+    }
+
+    std::tuple<Visitors&...> visitors;
+
+};
+
+#endif // FUSED_VISITOR_H
@@ -0,0 +1,460 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "elements.h"
+
+//////////////////////////////////////////////////////////////////////
+// Traversal instrumentation
+//
+// Built with VISITOR_INSTRUMENTATION defined, the traversals of
+// ElementContainer::Accept and ParallelAccept record, for each visitor
+// type and element type:
+//
+// - the number of elements visited, and the bytes of their payloads
+// - the cycles spent in the visitor's batch hooks
+// - the elements skipped because the visitor does not support their
+//   type
+// - the elements the visitor itself counted as unsupported, such as
+//   numeric elements passed to XORVisitor (see GetUnsupportedCount)
+//
+// Without VISITOR_INSTRUMENTATION the hooks expand to nothing, so the
+// traversals are exactly as fast as before. VisitMetrics is defined
+// either way, so that code exporting the metrics builds in both
+// configurations, and only exports nothing when they are disabled.
+//
+// The metrics are exported in the Prometheus text format with
+// WritePrometheus, or handed to a callback with ForEach:
+//
+//     instrumentation::VisitMetrics::Global().WritePrometheus(std::cout);
+//
+// The counters are only ever incremented, as Prometheus counters are,
+// so throughput over any interval is the difference between two
+// exports divided by its length.
+//////////////////////////////////////////////////////////////////////
+
+namespace instrumentation
+{
+
+#if defined(VISITOR_INSTRUMENTATION)
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+// The time stamp counter on x86 and the virtual counter on ARMv8,
+// otherwise nanoseconds of the steady clock
+inline std::uint64_t ReadCycleCounter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+inline const char* ToString(ElementType type)
+{
+    switch(type)
+    {
+        case ElementType::Single:
+            return "single";
+        case ElementType::Array:
+            return "array";
+        case ElementType::String:
+            return "string";
+    }
+
+    return "unknown";
+}
+
+// Values of the counters of one visitor type and element type
+struct VisitCounters
+{
+    std::string visitor;
+    ElementType element_type;
+    std::uint64_t elements;
+    std::uint64_t bytes;
+    std::uint64_t cycles;
+    std::uint64_t skipped;
+    std::uint64_t unsupported;
+};
+
+
+class VisitMetrics
+{
+
+public:
+
+    // Counters of one visitor type and element type, which any number
+    // of threads update with relaxed atomic additions
+    struct Counters
+    {
+        std::atomic<std::uint64_t> elements{0};
+        std::atomic<std::uint64_t> bytes{0};
+        std::atomic<std::uint64_t> cycles{0};
+        std::atomic<std::uint64_t> skipped{0};
+        std::atomic<std::uint64_t> unsupported{0};
+    };
+
+    // The metrics the traversal hooks record to
+    static VisitMetrics& Global()
+    {
+        static VisitMetrics metrics;
+
+        return metrics;
+    }
+
+    // Each thread remembers the last counters it used for each element
+    // type, so the lock is only taken when the visitor type changes
+    Counters& Get(const std::type_info &visitor_type, ElementType element_type)
+    {
+        struct CacheEntry
+        {
+            const VisitMetrics *metrics = nullptr;
+            const std::type_info *visitor_type = nullptr;
+            Counters *counters = nullptr;
+        };
+
+        thread_local CacheEntry cache[element_type_count];
+
+        CacheEntry &cached = cache[static_cast<std::size_t>(element_type)];
+
+        if(cached.metrics == this && cached.visitor_type == &visitor_type)
+        {
+            return *cached.counters;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::unique_ptr<Entry> &entry = entries[std::make_pair(std::type_index(visitor_type), element_type)];
+
+        if(!entry)
+        {
+            entry = std::make_unique<Entry>();
+            entry->visitor = Demangle(visitor_type.name());
+        }
+
+        cached = CacheEntry{this, &visitor_type, &entry->counters};
+
+        return entry->counters;
+    }
+
+    // Current values of every counter, by visitor name and element type
+    std::vector<VisitCounters> Snapshot() const
+    {
+        std::vector<VisitCounters> snapshot;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for(const auto &[key, entry] : entries)
+            {
+                const Counters &counters = entry->counters;
+
+                snapshot.push_back(VisitCounters{entry->visitor, key.second,
+                    counters.elements.load(std::memory_order_relaxed),
+                    counters.bytes.load(std::memory_order_relaxed),
+                    counters.cycles.load(std::memory_order_relaxed),
+                    counters.skipped.load(std::memory_order_relaxed),
+                    counters.unsupported.load(std::memory_order_relaxed)});
+            }
+        }
+
+        std::sort(snapshot.begin(), snapshot.end(),
+            [](const VisitCounters &a, const VisitCounters &b)
+            {
+                return std::tie(a.visitor, a.element_type) < std::tie(b.visitor, b.element_type);
+            });
+
+        return snapshot;
+    }
+
+    template<typename Function>
+    void ForEach(Function function) const
+    {
+        for(const VisitCounters &counters : Snapshot())
+        {
+            function(counters);
+        }
+    }
+
+    // Prometheus text exposition format, one counter family per field
+    void WritePrometheus(std::ostream &stream) const
+    {
+        const std::vector<VisitCounters> snapshot = Snapshot();
+
+        struct Family
+        {
+            const char *name;
+            const char *help;
+            std::uint64_t VisitCounters::*field;
+        };
+
+        const Family families[] =
+        {
+            {"visitor_elements_total", "Elements visited.", &VisitCounters::elements},
+            {"visitor_bytes_total", "Payload bytes of the elements visited.", &VisitCounters::bytes},
+            {"visitor_cycles_total", "Cycle counter ticks spent visiting.", &VisitCounters::cycles},
+            {"visitor_skipped_total", "Elements skipped as unsupported by the visitor.", &VisitCounters::skipped},
+            {"visitor_unsupported_total", "Elements counted as unsupported by the visitor itself.", &VisitCounters::unsupported}
+        };
+
+        for(const Family &family : families)
+        {
+            stream << "# HELP " << family.name << ' ' << family.help << '\n';
+            stream << "# TYPE " << family.name << " counter\n";
+
+            for(const VisitCounters &counters : snapshot)
+            {
+                stream << family.name << "{visitor=\"" << EscapeLabel(counters.visitor)
+                    << "\",element_type=\"" << ToString(counters.element_type) << "\"} "
+                    << counters.*family.field << '\n';
+            }
+        }
+    }
+
+    // Set every counter back to zero. Counters already handed out stay
+    // valid.
+    void Reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for(auto &[key, entry] : entries)
+        {
+            entry->counters.elements = 0;
+            entry->counters.bytes = 0;
+            entry->counters.cycles = 0;
+            entry->counters.skipped = 0;
+            entry->counters.unsupported = 0;
+        }
+    }
+
+private:
+
+    static constexpr std::size_t element_type_count = 3;
+
+    struct Entry
+    {
+        std::string visitor;
+        Counters counters;
+    };
+
+    static std::string Demangle(const char *name)
+    {
+#if __has_include(<cxxabi.h>)
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+
+        if(status == 0 && demangled != nullptr)
+        {
+            std::string result(demangled);
+            std::free(demangled);
+
+            return result;
+        }
+#endif
+        return name;
+    }
+
+    static std::string EscapeLabel(const std::string &value)
+    {
+        std::string escaped;
+
+        for(char ch : value)
+        {
+            if(ch == '\\' || ch == '"')
+            {
+                escaped += '\\';
+                escaped += ch;
+            }
+            else if(ch == '\n')
+            {
+                escaped += "\\n";
+            }
+            else
+            {
+                escaped += ch;
+            }
+        }
+
+        return escaped;
+    }
+
+    mutable std::mutex mutex;
+    std::map<std::pair<std::type_index, ElementType>, std::unique_ptr<Entry>> entries;
+
+};
+
+
+namespace detail
+{
+
+template<typename Element>
+constexpr ElementType GetElementType()
+{
+    if constexpr(std::is_same_v<Element, SingleElement>)
+    {
+        return ElementType::Single;
+    }
+    else if constexpr(std::is_same_v<Element, ArrayElement>)
+    {
+        return ElementType::Array;
+    }
+    else
+    {
+        static_assert(std::is_same_v<Element, StringElement>, "Instrumented traversals only visit container elements");
+        return ElementType::String;
+    }
+}
+
+template<typename Elements>
+std::uint64_t PayloadBytes(const Elements &elements)
+{
+    using Element = typename Elements::value_type;
+
+    std::uint64_t bytes = 0;
+
+    if constexpr(std::is_same_v<Element, SingleElement>)
+    {
+        bytes = elements.size() * sizeof(double);
+    }
+    else if constexpr(std::is_same_v<Element, ArrayElement>)
+    {
+        for(const ArrayElement &element : elements)
+        {
+            bytes += element.GetView().size_bytes();
+        }
+    }
+    else
+    {
+        for(const StringElement &element : elements)
+        {
+            bytes += element.GetView().size();
+        }
+    }
+
+    return bytes;
+}
+
+} // namespace detail
+
+
+// Records one call of a visitor's batch hook over elements: the
+// elements and their bytes when constructed, and the cycles and the
+// unsupported elements when destroyed. Used through the hook macros
+// below.
+template<typename Visitor>
+class ScopedVisit
+{
+
+public:
+
+    template<typename Elements>
+    ScopedVisit(const Visitor &visitor, const Elements &elements)
+        : visitor(visitor)
+        , counters(VisitMetrics::Global().Get(typeid(visitor), detail::GetElementType<typename Elements::value_type>()))
+        , unsupported_before(GetUnsupported(visitor))
+    {
+        counters.elements.fetch_add(elements.size(), std::memory_order_relaxed);
+        counters.bytes.fetch_add(detail::PayloadBytes(elements), std::memory_order_relaxed);
+
+        start = ReadCycleCounter();
+    }
+
+    ScopedVisit(const ScopedVisit&) = delete;
+    ScopedVisit& operator=(const ScopedVisit&) = delete;
+
+    ~ScopedVisit()
+    {
+        counters.cycles.fetch_add(ReadCycleCounter() - start, std::memory_order_relaxed);
+        counters.unsupported.fetch_add(GetUnsupported(visitor) - unsupported_before, std::memory_order_relaxed);
+    }
+
+private:
+
+    static std::uint64_t GetUnsupported(const Visitor &visitor)
+    {
+        if constexpr(requires { visitor.GetUnsupportedCount(); })
+        {
+            return visitor.GetUnsupportedCount();
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    const Visitor &visitor;
+    VisitMetrics::Counters &counters;
+    std::uint64_t unsupported_before;
+    std::uint64_t start;
+
+};
+
+// Record elements skipped by a traversal because the visitor does not
+// support their type
+template<typename Visitor, typename Elements>
+void RecordSkipped(const Visitor &visitor, const Elements &elements)
+{
+    if(!elements.empty())
+    {
+        VisitMetrics::Counters &counters =
+            VisitMetrics::Global().Get(typeid(visitor), detail::GetElementType<typename Elements::value_type>());
+
+        counters.skipped.fetch_add(elements.size(), std::memory_order_relaxed);
+    }
+}
+
+} // namespace instrumentation
+
+
+// Hooks placed in the traversals. VISIT_INSTRUMENTATION_SCOPE records
+// the rest of the enclosing block as a visit of elements by visitor.
+#if defined(VISITOR_INSTRUMENTATION)
+
+#define VISIT_INSTRUMENTATION_NAME(prefix, line) prefix##line
+#define VISIT_INSTRUMENTATION_UNIQUE(prefix, line) VISIT_INSTRUMENTATION_NAME(prefix, line)
+
+#define VISIT_INSTRUMENTATION_SCOPE(visitor, elements) \
+    ::instrumentation::ScopedVisit VISIT_INSTRUMENTATION_UNIQUE(visit_scope_, __LINE__)((visitor), (elements))
+
+#define VISIT_INSTRUMENTATION_SKIPPED(visitor, elements) \
+    ::instrumentation::RecordSkipped((visitor), (elements))
+
+#else
+
+#define VISIT_INSTRUMENTATION_SCOPE(visitor, elements) ((void)0)
+#define VISIT_INSTRUMENTATION_SKIPPED(visitor, elements) ((void)0)
+
+#endif // VISITOR_INSTRUMENTATION
+
+#endif // INSTRUMENTATION_H
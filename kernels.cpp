@@ -0,0 +1,2045 @@
+// Vectorized implementations of the Reassociate array reduction
+// kernels and of the string kernels
+//
+// Every array implementation follows the 16-lane order documented on
+// ReductionMode::Reassociate, and every string implementation is
+// exact, so they all produce bit-identical results. The instruction
+// set specific versions are compiled with function level target
+// attributes, which means the translation unit does not need to be
+// built with -mavx2 or -mavx512f, and the best version supported by
+// the CPU is selected at run time.
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+#define KERNELS_NEON
+#endif
+
+
+namespace kernels
+{
+
+namespace
+{
+
+constexpr std::size_t lane_count = 16;
+
+// Combine the lanes as a tree, the same way for every implementation
+template<typename Operation>
+double CombineLanes(double (&lanes)[lane_count], Operation operation)
+{
+    for(std::size_t width = lane_count / 2; width > 0; width /= 2)
+    {
+        for(std::size_t lane = 0; lane < width; ++ lane)
+        {
+            lanes[lane] = operation(lanes[lane], lanes[lane + width]);
+        }
+    }
+
+    return lanes[0];
+}
+
+// Values are taken as double, so float arrays are reduced exactly as
+// the same values widened to double
+template<typename Value, typename Operation>
+double ReduceTail(double result, const Value *values, std::size_t begin, std::size_t end, Operation operation)
+{
+    for(std::size_t index = begin; index < end; ++ index)
+    {
+        result = operation(result, values[index]);
+    }
+
+    return result;
+}
+
+
+//////////////////////////////
+// Portable implementation
+//////////////////////////////
+
+template<typename Value, typename Operation>
+double ReduceGeneric(const Value *values, std::size_t count, double identity, Operation operation)
+{
+    double lanes[lane_count];
+
+    for(double &lane : lanes)
+    {
+        lane = identity;
+    }
+
+    const std::size_t block_end = count - count % lane_count;
+
+    for(std::size_t index = 0; index < block_end; index += lane_count)
+    {
+        for(std::size_t lane = 0; lane < lane_count; ++ lane)
+        {
+            lanes[lane] = operation(lanes[lane], values[index + lane]);
+        }
+    }
+
+    return ReduceTail(CombineLanes(lanes, operation), values, block_end, count, operation);
+}
+
+double SumGeneric(const double *values, std::size_t count)
+{
+    return ReduceGeneric(values, count, 0.0, std::plus<double>());
+}
+
+double ProductGeneric(const double *values, std::size_t count)
+{
+    return ReduceGeneric(values, count, 1.0, std::multiplies<double>());
+}
+
+double SumGeneric(const float *values, std::size_t count)
+{
+    return ReduceGeneric(values, count, 0.0, std::plus<double>());
+}
+
+double ProductGeneric(const float *values, std::size_t count)
+{
+    return ReduceGeneric(values, count, 1.0, std::multiplies<double>());
+}
+
+using detail::SumAndProductResult;
+
+// Finish a fused sum and product from its lanes, in the same order as
+// the separate kernels
+SumAndProductResult CombineSumAndProduct(double (&sums)[lane_count], double (&products)[lane_count],
+    const double *values, std::size_t block_end, std::size_t count)
+{
+    return SumAndProductResult{
+        ReduceTail(CombineLanes(sums, std::plus<double>()), values, block_end, count, std::plus<double>()),
+        ReduceTail(CombineLanes(products, std::multiplies<double>()), values, block_end, count, std::multiplies<double>())
+    };
+}
+
+SumAndProductResult SumAndProductGeneric(const double *values, std::size_t count)
+{
+    double sums[lane_count];
+    double products[lane_count];
+
+    for(std::size_t lane = 0; lane < lane_count; ++ lane)
+    {
+        sums[lane] = 0.0;
+        products[lane] = 1.0;
+    }
+
+    const std::size_t block_end = count - count % lane_count;
+
+    for(std::size_t index = 0; index < block_end; index += lane_count)
+    {
+        for(std::size_t lane = 0; lane < lane_count; ++ lane)
+        {
+            sums[lane] += values[index + lane];
+            products[lane] *= values[index + lane];
+        }
+    }
+
+    return CombineSumAndProduct(sums, products, values, block_end, count);
+}
+
+
+// The scaled product keeps the lanes as separate mantissas and
+// exponents. A lane mantissa stays below 2 after normalizing and grows
+// by less than a factor 2 per block, so normalizing it every 512 blocks
+// keeps it far from overflow.
+constexpr std::size_t scaled_normalize_blocks = 512;
+
+using kernels::ScaledDouble;
+
+struct ScaledLanes
+{
+    double mantissas[lane_count];
+    std::int64_t exponents[lane_count];
+};
+
+void InitializeLanes(ScaledLanes &lanes)
+{
+    for(std::size_t lane = 0; lane < lane_count; ++ lane)
+    {
+        lanes.mantissas[lane] = 1.0;
+        lanes.exponents[lane] = 0;
+    }
+}
+
+// Multiply one block into the lanes factor by factor. The vectorized
+// kernels fall back to this for blocks holding zeros, subnormals,
+// infinities or NaNs, so every implementation gives the same lanes.
+void MultiplyBlock(ScaledLanes &lanes, const double *values)
+{
+    for(std::size_t lane = 0; lane < lane_count; ++ lane)
+    {
+        const ScaledDouble factor = kernels::Decompose(values[lane]);
+
+        lanes.mantissas[lane] *= factor.mantissa;
+        lanes.exponents[lane] += factor.exponent;
+    }
+}
+
+void NormalizeLanes(ScaledLanes &lanes)
+{
+    for(std::size_t lane = 0; lane < lane_count; ++ lane)
+    {
+        ScaledDouble scaled{lanes.mantissas[lane], lanes.exponents[lane]};
+        kernels::Normalize(scaled);
+
+        lanes.mantissas[lane] = scaled.mantissa;
+        lanes.exponents[lane] = scaled.exponent;
+    }
+}
+
+// Combine the lanes in the order of CombineLanes, and multiply in the
+// remaining values in order
+ScaledDouble CombineScaledLanes(ScaledLanes &lanes, const double *values, std::size_t block_end, std::size_t count)
+{
+    NormalizeLanes(lanes);
+
+    for(std::size_t width = lane_count / 2; width > 0; width /= 2)
+    {
+        for(std::size_t lane = 0; lane < width; ++ lane)
+        {
+            lanes.mantissas[lane] *= lanes.mantissas[lane + width];
+            lanes.exponents[lane] += lanes.exponents[lane + width];
+        }
+    }
+
+    ScaledDouble product{lanes.mantissas[0], lanes.exponents[0]};
+    kernels::Normalize(product);
+
+    for(std::size_t index = block_end; index < count; ++ index)
+    {
+        const ScaledDouble factor = kernels::Decompose(values[index]);
+
+        product.mantissa *= factor.mantissa;
+        product.exponent += factor.exponent;
+
+        kernels::Normalize(product);
+    }
+
+    return product;
+}
+
+ScaledDouble ScaledProductGeneric(const double *values, std::size_t count)
+{
+    ScaledLanes lanes;
+    InitializeLanes(lanes);
+
+    const std::size_t block_end = count - count % lane_count;
+    std::size_t blocks = 0;
+
+    for(std::size_t index = 0; index < block_end; index += lane_count)
+    {
+        MultiplyBlock(lanes, values + index);
+
+        if(++ blocks == scaled_normalize_blocks)
+        {
+            NormalizeLanes(lanes);
+            blocks = 0;
+        }
+    }
+
+    return CombineScaledLanes(lanes, values, block_end, count);
+}
+
+
+#if defined(KERNELS_X86)
+
+//////////////////////////////
+// AVX2: 4 x 4 lanes
+//////////////////////////////
+
+#define KERNELS_AVX2_REDUCE(NAME, IDENTITY, INTRINSIC, OPERATION)                    \
+__attribute__((target("avx2")))                                                      \
+double NAME(const double *values, std::size_t count)                                 \
+{                                                                                    \
+    __m256d accumulator0 = _mm256_set1_pd(IDENTITY);                                 \
+    __m256d accumulator1 = accumulator0;                                             \
+    __m256d accumulator2 = accumulator0;                                             \
+    __m256d accumulator3 = accumulator0;                                             \
+                                                                                     \
+    const std::size_t block_end = count - count % lane_count;                        \
+                                                                                     \
+    for(std::size_t index = 0; index < block_end; index += lane_count)               \
+    {                                                                                \
+        accumulator0 = INTRINSIC(accumulator0, _mm256_loadu_pd(values + index));      \
+        accumulator1 = INTRINSIC(accumulator1, _mm256_loadu_pd(values + index + 4));  \
+        accumulator2 = INTRINSIC(accumulator2, _mm256_loadu_pd(values + index + 8));  \
+        accumulator3 = INTRINSIC(accumulator3, _mm256_loadu_pd(values + index + 12)); \
+    }                                                                                \
+                                                                                     \
+    double lanes[lane_count];                                                        \
+    _mm256_storeu_pd(lanes, accumulator0);                                           \
+    _mm256_storeu_pd(lanes + 4, accumulator1);                                       \
+    _mm256_storeu_pd(lanes + 8, accumulator2);                                       \
+    _mm256_storeu_pd(lanes + 12, accumulator3);                                      \
+                                                                                     \
+    return ReduceTail(CombineLanes(lanes, OPERATION), values, block_end, count, OPERATION); \
+}
+
+KERNELS_AVX2_REDUCE(SumAvx2, 0.0, _mm256_add_pd, std::plus<double>())
+KERNELS_AVX2_REDUCE(ProductAvx2, 1.0, _mm256_mul_pd, std::multiplies<double>())
+
+#undef KERNELS_AVX2_REDUCE
+
+// Float arrays keep the same 4 x 4 double lanes, each loaded as 4
+// floats and widened
+#define KERNELS_AVX2_REDUCE_FLOAT(NAME, IDENTITY, INTRINSIC, OPERATION)              \
+__attribute__((target("avx2")))                                                      \
+double NAME(const float *values, std::size_t count)                                  \
+{                                                                                    \
+    __m256d accumulators[4];                                                         \
+                                                                                     \
+    for(__m256d &accumulator : accumulators)                                         \
+    {                                                                                \
+        accumulator = _mm256_set1_pd(IDENTITY);                                      \
+    }                                                                                \
+                                                                                     \
+    const std::size_t block_end = count - count % lane_count;                        \
+                                                                                     \
+    for(std::size_t index = 0; index < block_end; index += lane_count)               \
+    {                                                                                \
+        for(std::size_t part = 0; part < 4; ++ part)                                 \
+        {                                                                            \
+            __m256d block = _mm256_cvtps_pd(_mm_loadu_ps(values + index + 4 * part)); \
+            accumulators[part] = INTRINSIC(accumulators[part], block);               \
+        }                                                                            \
+    }                                                                                \
+                                                                                     \
+    double lanes[lane_count];                                                        \
+                                                                                     \
+    for(std::size_t part = 0; part < 4; ++ part)                                     \
+    {                                                                                \
+        _mm256_storeu_pd(lanes + 4 * part, accumulators[part]);                      \
+    }                                                                                \
+                                                                                     \
+    _mm256_zeroupper();                                                              \
+                                                                                     \
+    return ReduceTail(CombineLanes(lanes, OPERATION), values, block_end, count, OPERATION); \
+}
+
+KERNELS_AVX2_REDUCE_FLOAT(SumAvx2, 0.0, _mm256_add_pd, std::plus<double>())
+KERNELS_AVX2_REDUCE_FLOAT(ProductAvx2, 1.0, _mm256_mul_pd, std::multiplies<double>())
+
+#undef KERNELS_AVX2_REDUCE_FLOAT
+
+
+//////////////////////////////
+// AVX-512: 2 x 8 lanes
+//////////////////////////////
+
+#define KERNELS_AVX512_REDUCE(NAME, IDENTITY, INTRINSIC, OPERATION)                  \
+__attribute__((target("avx512f")))                                                   \
+double NAME(const double *values, std::size_t count)                                 \
+{                                                                                    \
+    __m512d accumulator0 = _mm512_set1_pd(IDENTITY);                                 \
+    __m512d accumulator1 = accumulator0;                                             \
+                                                                                     \
+    const std::size_t block_end = count - count % lane_count;                        \
+                                                                                     \
+    for(std::size_t index = 0; index < block_end; index += lane_count)               \
+    {                                                                                \
+        accumulator0 = INTRINSIC(accumulator0, _mm512_loadu_pd(values + index));      \
+        accumulator1 = INTRINSIC(accumulator1, _mm512_loadu_pd(values + index + 8));  \
+    }                                                                                \
+                                                                                     \
+    double lanes[lane_count];                                                        \
+    _mm512_storeu_pd(lanes, accumulator0);                                           \
+    _mm512_storeu_pd(lanes + 8, accumulator1);                                       \
+                                                                                     \
+    return ReduceTail(CombineLanes(lanes, OPERATION), values, block_end, count, OPERATION); \
+}
+
+KERNELS_AVX512_REDUCE(SumAvx512, 0.0, _mm512_add_pd, std::plus<double>())
+KERNELS_AVX512_REDUCE(ProductAvx512, 1.0, _mm512_mul_pd, std::multiplies<double>())
+
+#undef KERNELS_AVX512_REDUCE
+
+// Float arrays load a whole block of 16 floats at once and widen each
+// half into one of the 2 x 8 double lanes
+#define KERNELS_AVX512_REDUCE_FLOAT(NAME, IDENTITY, INTRINSIC, OPERATION)            \
+__attribute__((target("avx512f")))                                                   \
+double NAME(const float *values, std::size_t count)                                  \
+{                                                                                    \
+    __m512d accumulator0 = _mm512_set1_pd(IDENTITY);                                 \
+    __m512d accumulator1 = accumulator0;                                             \
+                                                                                     \
+    const std::size_t block_end = count - count % lane_count;                        \
+                                                                                     \
+    for(std::size_t index = 0; index < block_end; index += lane_count)               \
+    {                                                                                \
+        __m512 block = _mm512_loadu_ps(values + index);                              \
+        __m256 high = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(block), 1)); \
+                                                                                     \
+        accumulator0 = INTRINSIC(accumulator0, _mm512_cvtps_pd(_mm512_castps512_ps256(block))); \
+        accumulator1 = INTRINSIC(accumulator1, _mm512_cvtps_pd(high));               \
+    }                                                                                \
+                                                                                     \
+    double lanes[lane_count];                                                        \
+    _mm512_storeu_pd(lanes, accumulator0);                                           \
+    _mm512_storeu_pd(lanes + 8, accumulator1);                                       \
+                                                                                     \
+    _mm256_zeroupper();                                                              \
+                                                                                     \
+    return ReduceTail(CombineLanes(lanes, OPERATION), values, block_end, count, OPERATION); \
+}
+
+KERNELS_AVX512_REDUCE_FLOAT(SumAvx512, 0.0, _mm512_add_pd, std::plus<double>())
+KERNELS_AVX512_REDUCE_FLOAT(ProductAvx512, 1.0, _mm512_mul_pd, std::multiplies<double>())
+
+#undef KERNELS_AVX512_REDUCE_FLOAT
+
+
+__attribute__((target("avx2")))
+SumAndProductResult SumAndProductAvx2(const double *values, std::size_t count)
+{
+    __m256d sums[4];
+    __m256d products[4];
+
+    for(std::size_t part = 0; part < 4; ++ part)
+    {
+        sums[part] = _mm256_setzero_pd();
+        products[part] = _mm256_set1_pd(1.0);
+    }
+
+    const std::size_t block_end = count - count % lane_count;
+
+    for(std::size_t index = 0; index < block_end; index += lane_count)
+    {
+        for(std::size_t part = 0; part < 4; ++ part)
+        {
+            __m256d block = _mm256_loadu_pd(values + index + 4 * part);
+
+            sums[part] = _mm256_add_pd(sums[part], block);
+            products[part] = _mm256_mul_pd(products[part], block);
+        }
+    }
+
+    double sum_lanes[lane_count];
+    double product_lanes[lane_count];
+
+    for(std::size_t part = 0; part < 4; ++ part)
+    {
+        _mm256_storeu_pd(sum_lanes + 4 * part, sums[part]);
+        _mm256_storeu_pd(product_lanes + 4 * part, products[part]);
+    }
+
+    // The lanes are combined by non-VEX code, which would otherwise pay
+    // the AVX to SSE transition penalty
+    _mm256_zeroupper();
+
+    return CombineSumAndProduct(sum_lanes, product_lanes, values, block_end, count);
+}
+
+__attribute__((target("avx512f")))
+SumAndProductResult SumAndProductAvx512(const double *values, std::size_t count)
+{
+    __m512d sum0 = _mm512_setzero_pd();
+    __m512d sum1 = sum0;
+    __m512d product0 = _mm512_set1_pd(1.0);
+    __m512d product1 = product0;
+
+    const std::size_t block_end = count - count % lane_count;
+
+    for(std::size_t index = 0; index < block_end; index += lane_count)
+    {
+        __m512d block0 = _mm512_loadu_pd(values + index);
+        __m512d block1 = _mm512_loadu_pd(values + index + 8);
+
+        sum0 = _mm512_add_pd(sum0, block0);
+        sum1 = _mm512_add_pd(sum1, block1);
+        product0 = _mm512_mul_pd(product0, block0);
+        product1 = _mm512_mul_pd(product1, block1);
+    }
+
+    double sum_lanes[lane_count];
+    double product_lanes[lane_count];
+
+    _mm512_storeu_pd(sum_lanes, sum0);
+    _mm512_storeu_pd(sum_lanes + 8, sum1);
+    _mm512_storeu_pd(product_lanes, product0);
+    _mm512_storeu_pd(product_lanes + 8, product1);
+
+    _mm256_zeroupper();
+
+    return CombineSumAndProduct(sum_lanes, product_lanes, values, block_end, count);
+}
+
+// The factors are split with integer operations on their bits: the
+// exponent field is added to the lane exponents, and the mantissa and
+// sign are given the exponent of 1.0. The bias of the exponent field
+// is taken out when the lanes are stored.
+// The lanes are kept in registers, and stored to lanes whenever the
+// shared scalar code needs them. The exponents in the registers still
+// include the bias of biased_blocks blocks.
+__attribute__((target("avx2")))
+void LoadLanesAvx2(const ScaledLanes &lanes, __m256d (&mantissas)[4], __m256i (&exponents)[4])
+{
+    for(std::size_t part = 0; part < 4; ++ part)
+    {
+        mantissas[part] = _mm256_loadu_pd(lanes.mantissas + 4 * part);
+        exponents[part] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes.exponents + 4 * part));
+    }
+}
+
+__attribute__((target("avx2")))
+void StoreLanesAvx2(ScaledLanes &lanes, const __m256d (&mantissas)[4], const __m256i (&exponents)[4],
+    std::size_t &biased_blocks)
+{
+    const __m256i bias = _mm256_set1_epi64x(static_cast<long long>(1023 * biased_blocks));
+
+    for(std::size_t part = 0; part < 4; ++ part)
+    {
+        _mm256_storeu_pd(lanes.mantissas + 4 * part, mantissas[part]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes.exponents + 4 * part),
+            _mm256_sub_epi64(exponents[part], bias));
+    }
+
+    biased_blocks = 0;
+}
+
+__attribute__((target("avx2")))
+ScaledDouble ScaledProductAvx2(const double *values, std::size_t count)
+{
+    const __m256i exponent_mask = _mm256_set1_epi64x(0x7ff);
+    const __m256i mantissa_mask = _mm256_set1_epi64x(0x800fffffffffffff);
+    const __m256i one_bits = _mm256_set1_epi64x(0x3ff0000000000000);
+
+    ScaledLanes lanes;
+    InitializeLanes(lanes);
+
+    __m256d mantissas[4];
+    __m256i exponents[4];
+    std::size_t biased_blocks = 0;
+
+    LoadLanesAvx2(lanes, mantissas, exponents);
+
+    const std::size_t block_end = count - count % lane_count;
+    std::size_t blocks = 0;
+
+    for(std::size_t index = 0; index < block_end; index += lane_count)
+    {
+        __m256i fields[4];
+        __m256i special = _mm256_setzero_si256();
+
+        for(std::size_t part = 0; part < 4; ++ part)
+        {
+            const __m256i bits = _mm256_castpd_si256(_mm256_loadu_pd(values + index + 4 * part));
+
+            fields[part] = _mm256_and_si256(_mm256_srli_epi64(bits, 52), exponent_mask);
+
+            special = _mm256_or_si256(special, _mm256_cmpeq_epi64(fields[part], _mm256_setzero_si256()));
+            special = _mm256_or_si256(special, _mm256_cmpeq_epi64(fields[part], exponent_mask));
+        }
+
+        if(!_mm256_testz_si256(special, special))
+        {
+            StoreLanesAvx2(lanes, mantissas, exponents, biased_blocks);
+            _mm256_zeroupper();
+            MultiplyBlock(lanes, values + index);
+            LoadLanesAvx2(lanes, mantissas, exponents);
+        }
+        else
+        {
+            for(std::size_t part = 0; part < 4; ++ part)
+            {
+                const __m256i bits = _mm256_castpd_si256(_mm256_loadu_pd(values + index + 4 * part));
+                const __m256d mantissa = _mm256_castsi256_pd(
+                    _mm256_or_si256(_mm256_and_si256(bits, mantissa_mask), one_bits));
+
+                mantissas[part] = _mm256_mul_pd(mantissas[part], mantissa);
+                exponents[part] = _mm256_add_epi64(exponents[part], fields[part]);
+            }
+
+            ++ biased_blocks;
+        }
+
+        if(++ blocks == scaled_normalize_blocks)
+        {
+            StoreLanesAvx2(lanes, mantissas, exponents, biased_blocks);
+            _mm256_zeroupper();
+            NormalizeLanes(lanes);
+            LoadLanesAvx2(lanes, mantissas, exponents);
+
+            blocks = 0;
+        }
+    }
+
+    StoreLanesAvx2(lanes, mantissas, exponents, biased_blocks);
+
+    _mm256_zeroupper();
+
+    return CombineScaledLanes(lanes, values, block_end, count);
+}
+
+__attribute__((target("avx512f")))
+void LoadLanesAvx512(const ScaledLanes &lanes, __m512d (&mantissas)[2], __m512i (&exponents)[2])
+{
+    for(std::size_t part = 0; part < 2; ++ part)
+    {
+        mantissas[part] = _mm512_loadu_pd(lanes.mantissas + 8 * part);
+        exponents[part] = _mm512_loadu_si512(lanes.exponents + 8 * part);
+    }
+}
+
+__attribute__((target("avx512f")))
+void StoreLanesAvx512(ScaledLanes &lanes, const __m512d (&mantissas)[2], const __m512i (&exponents)[2],
+    std::size_t &biased_blocks)
+{
+    const __m512i bias = _mm512_set1_epi64(static_cast<long long>(1023 * biased_blocks));
+
+    for(std::size_t part = 0; part < 2; ++ part)
+    {
+        _mm512_storeu_pd(lanes.mantissas + 8 * part, mantissas[part]);
+        _mm512_storeu_si512(lanes.exponents + 8 * part, _mm512_sub_epi64(exponents[part], bias));
+    }
+
+    biased_blocks = 0;
+}
+
+__attribute__((target("avx512f")))
+ScaledDouble ScaledProductAvx512(const double *values, std::size_t count)
+{
+    const __m512i exponent_mask = _mm512_set1_epi64(0x7ff);
+    const __m512i mantissa_mask = _mm512_set1_epi64(0x800fffffffffffff);
+    const __m512i one_bits = _mm512_set1_epi64(0x3ff0000000000000);
+
+    ScaledLanes lanes;
+    InitializeLanes(lanes);
+
+    __m512d mantissas[2];
+    __m512i exponents[2];
+    std::size_t biased_blocks = 0;
+
+    LoadLanesAvx512(lanes, mantissas, exponents);
+
+    const std::size_t block_end = count - count % lane_count;
+    std::size_t blocks = 0;
+
+    for(std::size_t index = 0; index < block_end; index += lane_count)
+    {
+        __m512i bits[2];
+        __m512i fields[2];
+        __mmask8 special = 0;
+
+        for(std::size_t part = 0; part < 2; ++ part)
+        {
+            bits[part] = _mm512_castpd_si512(_mm512_loadu_pd(values + index + 8 * part));
+            fields[part] = _mm512_and_si512(_mm512_srli_epi64(bits[part], 52), exponent_mask);
+
+            special |= _mm512_cmpeq_epi64_mask(fields[part], _mm512_setzero_si512());
+            special |= _mm512_cmpeq_epi64_mask(fields[part], exponent_mask);
+        }
+
+        if(special != 0)
+        {
+            StoreLanesAvx512(lanes, mantissas, exponents, biased_blocks);
+            _mm256_zeroupper();
+            MultiplyBlock(lanes, values + index);
+            LoadLanesAvx512(lanes, mantissas, exponents);
+        }
+        else
+        {
+            for(std::size_t part = 0; part < 2; ++ part)
+            {
+                const __m512d mantissa = _mm512_castsi512_pd(
+                    _mm512_or_si512(_mm512_and_si512(bits[part], mantissa_mask), one_bits));
+
+                mantissas[part] = _mm512_mul_pd(mantissas[part], mantissa);
+                exponents[part] = _mm512_add_epi64(exponents[part], fields[part]);
+            }
+
+            ++ biased_blocks;
+        }
+
+        if(++ blocks == scaled_normalize_blocks)
+        {
+            StoreLanesAvx512(lanes, mantissas, exponents, biased_blocks);
+            _mm256_zeroupper();
+            NormalizeLanes(lanes);
+            LoadLanesAvx512(lanes, mantissas, exponents);
+
+            blocks = 0;
+        }
+    }
+
+    StoreLanesAvx512(lanes, mantissas, exponents, biased_blocks);
+
+    _mm256_zeroupper();
+
+    return CombineScaledLanes(lanes, values, block_end, count);
+}
+
+#endif // KERNELS_X86
+
+
+#if defined(KERNELS_NEON)
+
+//////////////////////////////
+// NEON: 8 x 2 lanes
+//////////////////////////////
+
+float64x2_t LoadNeon(const double *values)
+{
+    return vld1q_f64(values);
+}
+
+float64x2_t LoadNeon(const float *values)
+{
+    return vcvt_f64_f32(vld1_f32(values));
+}
+
+template<typename Value, typename Intrinsic, typename Operation>
+double ReduceNeon(const Value *values, std::size_t count, double identity,
+    Intrinsic intrinsic, Operation operation)
+{
+    float64x2_t accumulators[lane_count / 2];
+
+    for(float64x2_t &accumulator : accumulators)
+    {
+        accumulator = vdupq_n_f64(identity);
+    }
+
+    const std::size_t block_end = count - count % lane_count;
+
+    for(std::size_t index = 0; index < block_end; index += lane_count)
+    {
+        for(std::size_t pair = 0; pair < lane_count / 2; ++ pair)
+        {
+            accumulators[pair] = intrinsic(accumulators[pair], LoadNeon(values + index + 2 * pair));
+        }
+    }
+
+    double lanes[lane_count];
+
+    for(std::size_t pair = 0; pair < lane_count / 2; ++ pair)
+    {
+        vst1q_f64(lanes + 2 * pair, accumulators[pair]);
+    }
+
+    return ReduceTail(CombineLanes(lanes, operation), values, block_end, count, operation);
+}
+
+double SumNeon(const double *values, std::size_t count)
+{
+    return ReduceNeon(values, count, 0.0,
+        [](float64x2_t a, float64x2_t b) { return vaddq_f64(a, b); }, std::plus<double>());
+}
+
+double ProductNeon(const double *values, std::size_t count)
+{
+    return ReduceNeon(values, count, 1.0,
+        [](float64x2_t a, float64x2_t b) { return vmulq_f64(a, b); }, std::multiplies<double>());
+}
+
+double SumNeon(const float *values, std::size_t count)
+{
+    return ReduceNeon(values, count, 0.0,
+        [](float64x2_t a, float64x2_t b) { return vaddq_f64(a, b); }, std::plus<double>());
+}
+
+double ProductNeon(const float *values, std::size_t count)
+{
+    return ReduceNeon(values, count, 1.0,
+        [](float64x2_t a, float64x2_t b) { return vmulq_f64(a, b); }, std::multiplies<double>());
+}
+
+SumAndProductResult SumAndProductNeon(const double *values, std::size_t count)
+{
+    float64x2_t sums[lane_count / 2];
+    float64x2_t products[lane_count / 2];
+
+    for(std::size_t pair = 0; pair < lane_count / 2; ++ pair)
+    {
+        sums[pair] = vdupq_n_f64(0.0);
+        products[pair] = vdupq_n_f64(1.0);
+    }
+
+    const std::size_t block_end = count - count % lane_count;
+
+    for(std::size_t index = 0; index < block_end; index += lane_count)
+    {
+        for(std::size_t pair = 0; pair < lane_count / 2; ++ pair)
+        {
+            float64x2_t block = vld1q_f64(values + index + 2 * pair);
+
+            sums[pair] = vaddq_f64(sums[pair], block);
+            products[pair] = vmulq_f64(products[pair], block);
+        }
+    }
+
+    double sum_lanes[lane_count];
+    double product_lanes[lane_count];
+
+    for(std::size_t pair = 0; pair < lane_count / 2; ++ pair)
+    {
+        vst1q_f64(sum_lanes + 2 * pair, sums[pair]);
+        vst1q_f64(product_lanes + 2 * pair, products[pair]);
+    }
+
+    return CombineSumAndProduct(sum_lanes, product_lanes, values, block_end, count);
+}
+
+#endif // KERNELS_NEON
+
+
+//////////////////////////////////////////////////////////////////////
+// Integer array kernels
+//
+// The sums are exact, so they can be added in any order. 32-bit
+// integers are widened and added in 64-bit lanes. 64-bit integers are
+// split into their low 32 bits, as unsigned, and their high 32 bits,
+// so that each half can be added in 64-bit lanes without overflowing.
+// The lanes are combined in 128 bits every int64_chunk_size values.
+//////////////////////////////////////////////////////////////////////
+
+constexpr std::size_t int64_chunk_size = std::size_t{1} << 31;
+
+std::int64_t Int32SumTail(std::int64_t sum, const std::int32_t *values, std::size_t begin, std::size_t end)
+{
+    for(std::size_t index = begin; index < end; ++ index)
+    {
+        sum += values[index];
+    }
+
+    return sum;
+}
+
+std::int64_t Int32SumGeneric(const std::int32_t *values, std::size_t count)
+{
+    return Int32SumTail(0, values, 0, count);
+}
+
+Int128 Int64SumGeneric(const std::int64_t *values, std::size_t count)
+{
+    Int128 sum;
+
+    for(std::size_t index = 0; index < count; ++ index)
+    {
+        sum += values[index];
+    }
+
+    return sum;
+}
+
+// The vector kernels combine their lanes in __int128, so they are only
+// built where the compiler has it, which excludes 32-bit targets
+#if defined(__SIZEOF_INT128__)
+
+#define KERNELS_INT128
+
+Int128 Int64SumTail(__int128 sum, const std::int64_t *values, std::size_t begin, std::size_t end)
+{
+    for(std::size_t index = begin; index < end; ++ index)
+    {
+        sum += values[index];
+    }
+
+    return Int128{static_cast<std::uint64_t>(sum), static_cast<std::int64_t>(sum >> 64)};
+}
+
+#endif // __SIZEOF_INT128__
+
+
+#if defined(KERNELS_X86)
+
+__attribute__((target("avx2")))
+std::int64_t Int32SumAvx2(const std::int32_t *values, std::size_t count)
+{
+    __m256i sum0 = _mm256_setzero_si256();
+    __m256i sum1 = sum0;
+
+    const std::size_t block_end = count - count % 8;
+
+    for(std::size_t index = 0; index < block_end; index += 8)
+    {
+        const __m128i *block = reinterpret_cast<const __m128i*>(values + index);
+
+        sum0 = _mm256_add_epi64(sum0, _mm256_cvtepi32_epi64(_mm_loadu_si128(block)));
+        sum1 = _mm256_add_epi64(sum1, _mm256_cvtepi32_epi64(_mm_loadu_si128(block + 1)));
+    }
+
+    std::int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(sum0, sum1));
+
+    _mm256_zeroupper();
+
+    return Int32SumTail(lanes[0] + lanes[1] + lanes[2] + lanes[3], values, block_end, count);
+}
+
+#if defined(KERNELS_INT128)
+
+// AVX2 has no 64-bit arithmetic shift, so the high halves are added
+// as unsigned and 2^64 is taken back out for each negative value
+__attribute__((target("avx2")))
+Int128 Int64SumAvx2(const std::int64_t *values, std::size_t count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i low_mask = _mm256_set1_epi64x(0xffffffff);
+
+    __int128 sum = 0;
+
+    const std::size_t block_end = count - count % 4;
+
+    for(std::size_t first = 0; first < block_end; first += int64_chunk_size)
+    {
+        const std::size_t last = std::min(first + int64_chunk_size, block_end);
+
+        __m256i low = zero;
+        __m256i high = zero;
+        __m256i negative = zero;
+
+        for(std::size_t index = first; index < last; index += 4)
+        {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + index));
+
+            low = _mm256_add_epi64(low, _mm256_and_si256(block, low_mask));
+            high = _mm256_add_epi64(high, _mm256_srli_epi64(block, 32));
+            negative = _mm256_sub_epi64(negative, _mm256_cmpgt_epi64(zero, block));
+        }
+
+        std::uint64_t lows[4];
+        std::uint64_t highs[4];
+        std::uint64_t negatives[4];
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lows), low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(highs), high);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(negatives), negative);
+
+        for(std::size_t lane = 0; lane < 4; ++ lane)
+        {
+            sum += static_cast<__int128>(lows[lane]) + (static_cast<__int128>(highs[lane]) << 32);
+            sum -= static_cast<__int128>(negatives[lane]) << 64;
+        }
+    }
+
+    _mm256_zeroupper();
+
+    return Int64SumTail(sum, values, block_end, count);
+}
+
+#define KERNELS_AVX2_INT64_SUM Int64SumAvx2
+#else
+#define KERNELS_AVX2_INT64_SUM Int64SumGeneric
+#endif // KERNELS_INT128
+
+__attribute__((target("avx512f")))
+std::int64_t Int32SumAvx512(const std::int32_t *values, std::size_t count)
+{
+    __m512i sum0 = _mm512_setzero_si512();
+    __m512i sum1 = sum0;
+
+    const std::size_t block_end = count - count % 16;
+
+    for(std::size_t index = 0; index < block_end; index += 16)
+    {
+        const __m256i *block = reinterpret_cast<const __m256i*>(values + index);
+
+        sum0 = _mm512_add_epi64(sum0, _mm512_cvtepi32_epi64(_mm256_loadu_si256(block)));
+        sum1 = _mm512_add_epi64(sum1, _mm512_cvtepi32_epi64(_mm256_loadu_si256(block + 1)));
+    }
+
+    const std::int64_t sum = _mm512_reduce_add_epi64(_mm512_add_epi64(sum0, sum1));
+
+    _mm256_zeroupper();
+
+    return Int32SumTail(sum, values, block_end, count);
+}
+
+#if defined(KERNELS_INT128)
+
+__attribute__((target("avx512f")))
+Int128 Int64SumAvx512(const std::int64_t *values, std::size_t count)
+{
+    const __m512i low_mask = _mm512_set1_epi64(0xffffffff);
+
+    __int128 sum = 0;
+
+    const std::size_t block_end = count - count % 8;
+
+    for(std::size_t first = 0; first < block_end; first += int64_chunk_size)
+    {
+        const std::size_t last = std::min(first + int64_chunk_size, block_end);
+
+        __m512i low = _mm512_setzero_si512();
+        __m512i high = low;
+
+        for(std::size_t index = first; index < last; index += 8)
+        {
+            __m512i block = _mm512_loadu_si512(values + index);
+
+            low = _mm512_add_epi64(low, _mm512_and_si512(block, low_mask));
+            high = _mm512_add_epi64(high, _mm512_srai_epi64(block, 32));
+        }
+
+        std::uint64_t lows[8];
+        std::int64_t highs[8];
+
+        _mm512_storeu_si512(lows, low);
+        _mm512_storeu_si512(highs, high);
+
+        for(std::size_t lane = 0; lane < 8; ++ lane)
+        {
+            sum += static_cast<__int128>(lows[lane]) + static_cast<__int128>(highs[lane]) * (__int128{1} << 32);
+        }
+    }
+
+    _mm256_zeroupper();
+
+    return Int64SumTail(sum, values, block_end, count);
+}
+
+#define KERNELS_AVX512_INT64_SUM Int64SumAvx512
+#else
+#define KERNELS_AVX512_INT64_SUM Int64SumGeneric
+#endif // KERNELS_INT128
+
+#endif // KERNELS_X86
+
+
+#if defined(KERNELS_NEON)
+
+std::int64_t Int32SumNeon(const std::int32_t *values, std::size_t count)
+{
+    int64x2_t sum = vdupq_n_s64(0);
+
+    const std::size_t block_end = count - count % 4;
+
+    for(std::size_t index = 0; index < block_end; index += 4)
+    {
+        sum = vpadalq_s32(sum, vld1q_s32(values + index));
+    }
+
+    return Int32SumTail(vaddvq_s64(sum), values, block_end, count);
+}
+
+#if defined(KERNELS_INT128)
+
+Int128 Int64SumNeon(const std::int64_t *values, std::size_t count)
+{
+    const uint64x2_t low_mask = vdupq_n_u64(0xffffffff);
+
+    __int128 sum = 0;
+
+    const std::size_t block_end = count - count % 2;
+
+    for(std::size_t first = 0; first < block_end; first += int64_chunk_size)
+    {
+        const std::size_t last = std::min(first + int64_chunk_size, block_end);
+
+        uint64x2_t low = vdupq_n_u64(0);
+        int64x2_t high = vdupq_n_s64(0);
+
+        for(std::size_t index = first; index < last; index += 2)
+        {
+            int64x2_t block = vld1q_s64(values + index);
+
+            low = vaddq_u64(low, vandq_u64(vreinterpretq_u64_s64(block), low_mask));
+            high = vaddq_s64(high, vshrq_n_s64(block, 32));
+        }
+
+        sum += static_cast<__int128>(vgetq_lane_u64(low, 0)) + static_cast<__int128>(vgetq_lane_u64(low, 1));
+        sum += (static_cast<__int128>(vgetq_lane_s64(high, 0)) + vgetq_lane_s64(high, 1)) * (__int128{1} << 32);
+    }
+
+    return Int64SumTail(sum, values, block_end, count);
+}
+
+#define KERNELS_NEON_INT64_SUM Int64SumNeon
+#else
+#define KERNELS_NEON_INT64_SUM Int64SumGeneric
+#endif // KERNELS_INT128
+
+#endif // KERNELS_NEON
+
+
+//////////////////////////////////////////////////////////////////////
+// String kernels
+//
+// A byte is a digit when (byte - '0'), computed modulo 256, is below
+// 10. The digit sum is accumulated as an integer with SAD instructions
+// (or horizontal adds on NEON), and the XOR checksum is folded one
+// register at a time and reduced to a byte at the end.
+//
+// The digit product has to be multiplied in order to stay identical
+// to the scalar definition, so the vector code only builds a mask of
+// the digits other than '1', which leave the product unchanged, and
+// multiplies the flagged digits one at a time. Once the product is
+// zero it can no longer change, so the scan stops early.
+//////////////////////////////////////////////////////////////////////
+
+std::uint64_t DigitSumTail(const unsigned char *text, std::size_t begin, std::size_t end)
+{
+    std::uint64_t sum = 0;
+
+    for(std::size_t index = begin; index < end; ++ index)
+    {
+        if(IsDigit(text[index]))
+        {
+            sum += text[index] - '0';
+        }
+    }
+
+    return sum;
+}
+
+double DigitProductTail(double product, const unsigned char *text, std::size_t begin, std::size_t end)
+{
+    for(std::size_t index = begin; index < end; ++ index)
+    {
+        if(IsDigit(text[index]))
+        {
+            product *= static_cast<double>(text[index] - '0');
+        }
+    }
+
+    return product;
+}
+
+unsigned char XorChecksumTail(unsigned char checksum, const unsigned char *text, std::size_t begin, std::size_t end)
+{
+    for(std::size_t index = begin; index < end; ++ index)
+    {
+        checksum ^= text[index];
+    }
+
+    return checksum;
+}
+
+unsigned char XorFoldBytes(const unsigned char *bytes, std::size_t count)
+{
+    return XorChecksumTail(0, bytes, 0, count);
+}
+
+// Running state of a fused string scan
+struct StringScan
+{
+    std::uint64_t digit_sum = 0;
+    double digit_product = 1.0;
+    unsigned char checksum = 0;
+};
+
+StringScan ScanStringTail(StringScan scan, const unsigned char *text, std::size_t begin, std::size_t end)
+{
+    for(std::size_t index = begin; index < end; ++ index)
+    {
+        if(IsDigit(text[index]))
+        {
+            scan.digit_sum += text[index] - '0';
+            scan.digit_product *= static_cast<double>(text[index] - '0');
+        }
+
+        scan.checksum ^= text[index];
+    }
+
+    return scan;
+}
+
+
+//////////////////////////////
+// Portable implementation
+//////////////////////////////
+
+std::uint64_t DigitSumGeneric(const unsigned char *text, std::size_t size)
+{
+    return DigitSumTail(text, 0, size);
+}
+
+double DigitProductGeneric(double product, const unsigned char *text, std::size_t size)
+{
+    return DigitProductTail(product, text, 0, size);
+}
+
+// Fold eight bytes at a time in a 64-bit word
+unsigned char XorChecksumGeneric(const unsigned char *text, std::size_t size)
+{
+    std::uint64_t word_checksum = 0;
+
+    const std::size_t block_end = size - size % sizeof(std::uint64_t);
+
+    for(std::size_t index = 0; index < block_end; index += sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        std::memcpy(&word, text + index, sizeof(word));
+        word_checksum ^= word;
+    }
+
+    unsigned char bytes[sizeof(word_checksum)];
+    std::memcpy(bytes, &word_checksum, sizeof(bytes));
+
+    return XorChecksumTail(XorFoldBytes(bytes, sizeof(bytes)), text, block_end, size);
+}
+
+StringScan ScanStringGeneric(const unsigned char *text, std::size_t size)
+{
+    return ScanStringTail(StringScan(), text, 0, size);
+}
+
+
+#if defined(KERNELS_X86)
+
+// Multiply in the digits of a block flagged in mask, lowest bit first
+double DigitProductMasked(double product, const unsigned char *block, std::uint64_t mask)
+{
+    while(mask != 0)
+    {
+        product *= static_cast<double>(block[__builtin_ctzll(mask)] - '0');
+        mask &= mask - 1;
+    }
+
+    return product;
+}
+
+//////////////////////////////
+// SSE2: 16 bytes
+//////////////////////////////
+
+__attribute__((target("sse2")))
+std::uint64_t DigitSumSse2(const unsigned char *text, std::size_t size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ascii_zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+
+    __m128i total = zero;
+
+    const std::size_t block_end = size - size % 16;
+
+    for(std::size_t index = 0; index < block_end; index += 16)
+    {
+        __m128i digits = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + index)), ascii_zero);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, nine), digits);
+
+        total = _mm_add_epi64(total, _mm_sad_epu8(_mm_and_si128(digits, is_digit), zero));
+    }
+
+    std::uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), total);
+
+    return lanes[0] + lanes[1] + DigitSumTail(text, block_end, size);
+}
+
+__attribute__((target("sse2")))
+double DigitProductSse2(double product, const unsigned char *text, std::size_t size)
+{
+    const __m128i ascii_zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i one = _mm_set1_epi8(1);
+
+    const std::size_t block_end = size - size % 16;
+
+    for(std::size_t index = 0; index < block_end && product != 0.0; index += 16)
+    {
+        __m128i digits = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + index)), ascii_zero);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, nine), digits);
+        __m128i is_factor = _mm_andnot_si128(_mm_cmpeq_epi8(digits, one), is_digit);
+
+        std::uint64_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(is_factor));
+
+        product = DigitProductMasked(product, text + index, mask);
+    }
+
+    if(product == 0.0)
+    {
+        return product;
+    }
+
+    return DigitProductTail(product, text, block_end, size);
+}
+
+__attribute__((target("sse2")))
+unsigned char XorChecksumSse2(const unsigned char *text, std::size_t size)
+{
+    __m128i checksum = _mm_setzero_si128();
+
+    const std::size_t block_end = size - size % 16;
+
+    for(std::size_t index = 0; index < block_end; index += 16)
+    {
+        checksum = _mm_xor_si128(checksum, _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + index)));
+    }
+
+    unsigned char bytes[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), checksum);
+
+    return XorChecksumTail(XorFoldBytes(bytes, sizeof(bytes)), text, block_end, size);
+}
+
+__attribute__((target("sse2")))
+StringScan ScanStringSse2(const unsigned char *text, std::size_t size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ascii_zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i one = _mm_set1_epi8(1);
+
+    __m128i total = zero;
+    __m128i checksum = zero;
+
+    StringScan scan;
+
+    const std::size_t block_end = size - size % 16;
+
+    for(std::size_t index = 0; index < block_end; index += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + index));
+        __m128i digits = _mm_sub_epi8(bytes, ascii_zero);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, nine), digits);
+
+        total = _mm_add_epi64(total, _mm_sad_epu8(_mm_and_si128(digits, is_digit), zero));
+        checksum = _mm_xor_si128(checksum, bytes);
+
+        if(scan.digit_product != 0.0)
+        {
+            __m128i is_factor = _mm_andnot_si128(_mm_cmpeq_epi8(digits, one), is_digit);
+            std::uint64_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(is_factor));
+
+            scan.digit_product = DigitProductMasked(scan.digit_product, text + index, mask);
+        }
+    }
+
+    std::uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), total);
+
+    unsigned char checksum_bytes[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(checksum_bytes), checksum);
+
+    scan.digit_sum = lanes[0] + lanes[1];
+    scan.checksum = XorFoldBytes(checksum_bytes, sizeof(checksum_bytes));
+
+    return ScanStringTail(scan, text, block_end, size);
+}
+
+
+//////////////////////////////
+// AVX2: 32 bytes
+//////////////////////////////
+
+__attribute__((target("avx2")))
+std::uint64_t DigitSumAvx2(const unsigned char *text, std::size_t size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ascii_zero = _mm256_set1_epi8('0');
+    const __m256i nine = _mm256_set1_epi8(9);
+
+    __m256i total = zero;
+
+    const std::size_t block_end = size - size % 32;
+
+    for(std::size_t index = 0; index < block_end; index += 32)
+    {
+        __m256i digits = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + index)), ascii_zero);
+        __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digits, nine), digits);
+
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_and_si256(digits, is_digit), zero));
+    }
+
+    std::uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + DigitSumTail(text, block_end, size);
+}
+
+__attribute__((target("avx2")))
+double DigitProductAvx2(double product, const unsigned char *text, std::size_t size)
+{
+    const __m256i ascii_zero = _mm256_set1_epi8('0');
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i one = _mm256_set1_epi8(1);
+
+    const std::size_t block_end = size - size % 32;
+
+    for(std::size_t index = 0; index < block_end && product != 0.0; index += 32)
+    {
+        __m256i digits = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + index)), ascii_zero);
+        __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digits, nine), digits);
+        __m256i is_factor = _mm256_andnot_si256(_mm256_cmpeq_epi8(digits, one), is_digit);
+
+        std::uint64_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(is_factor));
+
+        product = DigitProductMasked(product, text + index, mask);
+    }
+
+    if(product == 0.0)
+    {
+        return product;
+    }
+
+    return DigitProductTail(product, text, block_end, size);
+}
+
+__attribute__((target("avx2")))
+unsigned char XorChecksumAvx2(const unsigned char *text, std::size_t size)
+{
+    __m256i checksum = _mm256_setzero_si256();
+
+    const std::size_t block_end = size - size % 32;
+
+    for(std::size_t index = 0; index < block_end; index += 32)
+    {
+        checksum = _mm256_xor_si256(checksum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + index)));
+    }
+
+    unsigned char bytes[32];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes), checksum);
+
+    return XorChecksumTail(XorFoldBytes(bytes, sizeof(bytes)), text, block_end, size);
+}
+
+__attribute__((target("avx2")))
+StringScan ScanStringAvx2(const unsigned char *text, std::size_t size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ascii_zero = _mm256_set1_epi8('0');
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i one = _mm256_set1_epi8(1);
+
+    __m256i total = zero;
+    __m256i checksum = zero;
+
+    StringScan scan;
+
+    const std::size_t block_end = size - size % 32;
+
+    for(std::size_t index = 0; index < block_end; index += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + index));
+        __m256i digits = _mm256_sub_epi8(bytes, ascii_zero);
+        __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digits, nine), digits);
+
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_and_si256(digits, is_digit), zero));
+        checksum = _mm256_xor_si256(checksum, bytes);
+
+        if(scan.digit_product != 0.0)
+        {
+            __m256i is_factor = _mm256_andnot_si256(_mm256_cmpeq_epi8(digits, one), is_digit);
+            std::uint64_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(is_factor));
+
+            scan.digit_product = DigitProductMasked(scan.digit_product, text + index, mask);
+        }
+    }
+
+    std::uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+
+    unsigned char checksum_bytes[32];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(checksum_bytes), checksum);
+
+    scan.digit_sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    scan.checksum = XorFoldBytes(checksum_bytes, sizeof(checksum_bytes));
+
+    return ScanStringTail(scan, text, block_end, size);
+}
+
+
+//////////////////////////////
+// AVX-512BW: 64 bytes
+//////////////////////////////
+
+__attribute__((target("avx512f,avx512bw")))
+std::uint64_t DigitSumAvx512(const unsigned char *text, std::size_t size)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i ascii_zero = _mm512_set1_epi8('0');
+    const __m512i ten = _mm512_set1_epi8(10);
+
+    __m512i total = zero;
+
+    const std::size_t block_end = size - size % 64;
+
+    for(std::size_t index = 0; index < block_end; index += 64)
+    {
+        __m512i digits = _mm512_sub_epi8(_mm512_loadu_si512(text + index), ascii_zero);
+        __mmask64 is_digit = _mm512_cmplt_epu8_mask(digits, ten);
+
+        total = _mm512_add_epi64(total, _mm512_sad_epu8(_mm512_maskz_mov_epi8(is_digit, digits), zero));
+    }
+
+    return _mm512_reduce_add_epi64(total) + DigitSumTail(text, block_end, size);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+double DigitProductAvx512(double product, const unsigned char *text, std::size_t size)
+{
+    const __m512i ascii_zero = _mm512_set1_epi8('0');
+    const __m512i ten = _mm512_set1_epi8(10);
+    const __m512i one = _mm512_set1_epi8(1);
+
+    const std::size_t block_end = size - size % 64;
+
+    for(std::size_t index = 0; index < block_end && product != 0.0; index += 64)
+    {
+        __m512i digits = _mm512_sub_epi8(_mm512_loadu_si512(text + index), ascii_zero);
+        __mmask64 is_factor = _mm512_cmplt_epu8_mask(digits, ten) & ~_mm512_cmpeq_epi8_mask(digits, one);
+
+        product = DigitProductMasked(product, text + index, is_factor);
+    }
+
+    if(product == 0.0)
+    {
+        return product;
+    }
+
+    return DigitProductTail(product, text, block_end, size);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+unsigned char XorChecksumAvx512(const unsigned char *text, std::size_t size)
+{
+    __m512i checksum = _mm512_setzero_si512();
+
+    const std::size_t block_end = size - size % 64;
+
+    for(std::size_t index = 0; index < block_end; index += 64)
+    {
+        checksum = _mm512_xor_si512(checksum, _mm512_loadu_si512(text + index));
+    }
+
+    unsigned char bytes[64];
+    _mm512_storeu_si512(bytes, checksum);
+
+    return XorChecksumTail(XorFoldBytes(bytes, sizeof(bytes)), text, block_end, size);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+StringScan ScanStringAvx512(const unsigned char *text, std::size_t size)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i ascii_zero = _mm512_set1_epi8('0');
+    const __m512i ten = _mm512_set1_epi8(10);
+    const __m512i one = _mm512_set1_epi8(1);
+
+    __m512i total = zero;
+    __m512i checksum = zero;
+
+    StringScan scan;
+
+    const std::size_t block_end = size - size % 64;
+
+    for(std::size_t index = 0; index < block_end; index += 64)
+    {
+        __m512i bytes = _mm512_loadu_si512(text + index);
+        __m512i digits = _mm512_sub_epi8(bytes, ascii_zero);
+        __mmask64 is_digit = _mm512_cmplt_epu8_mask(digits, ten);
+
+        total = _mm512_add_epi64(total, _mm512_sad_epu8(_mm512_maskz_mov_epi8(is_digit, digits), zero));
+        checksum = _mm512_xor_si512(checksum, bytes);
+
+        if(scan.digit_product != 0.0)
+        {
+            __mmask64 is_factor = is_digit & ~_mm512_cmpeq_epi8_mask(digits, one);
+
+            scan.digit_product = DigitProductMasked(scan.digit_product, text + index, is_factor);
+        }
+    }
+
+    unsigned char checksum_bytes[64];
+    _mm512_storeu_si512(checksum_bytes, checksum);
+
+    scan.digit_sum = _mm512_reduce_add_epi64(total);
+    scan.checksum = XorFoldBytes(checksum_bytes, sizeof(checksum_bytes));
+
+    return ScanStringTail(scan, text, block_end, size);
+}
+
+#endif // KERNELS_X86
+
+
+#if defined(KERNELS_NEON)
+
+//////////////////////////////
+// NEON: 16 bytes
+//////////////////////////////
+
+std::uint64_t DigitSumNeon(const unsigned char *text, std::size_t size)
+{
+    const uint8x16_t ascii_zero = vdupq_n_u8('0');
+    const uint8x16_t ten = vdupq_n_u8(10);
+
+    std::uint64_t sum = 0;
+
+    const std::size_t block_end = size - size % 16;
+
+    for(std::size_t index = 0; index < block_end; index += 16)
+    {
+        uint8x16_t digits = vsubq_u8(vld1q_u8(text + index), ascii_zero);
+
+        sum += vaddlvq_u8(vandq_u8(digits, vcltq_u8(digits, ten)));
+    }
+
+    return sum + DigitSumTail(text, block_end, size);
+}
+
+// NEON has no byte movemask, so blocks which contain a digit other than
+// '1' are multiplied with the scalar loop
+double DigitProductNeon(double product, const unsigned char *text, std::size_t size)
+{
+    const uint8x16_t ascii_zero = vdupq_n_u8('0');
+    const uint8x16_t ten = vdupq_n_u8(10);
+    const uint8x16_t one = vdupq_n_u8(1);
+
+    const std::size_t block_end = size - size % 16;
+
+    for(std::size_t index = 0; index < block_end && product != 0.0; index += 16)
+    {
+        uint8x16_t digits = vsubq_u8(vld1q_u8(text + index), ascii_zero);
+        uint8x16_t is_factor = vbicq_u8(vcltq_u8(digits, ten), vceqq_u8(digits, one));
+
+        if(vmaxvq_u8(is_factor) != 0)
+        {
+            product = DigitProductTail(product, text, index, index + 16);
+        }
+    }
+
+    if(product == 0.0)
+    {
+        return product;
+    }
+
+    return DigitProductTail(product, text, block_end, size);
+}
+
+unsigned char XorChecksumNeon(const unsigned char *text, std::size_t size)
+{
+    uint8x16_t checksum = vdupq_n_u8(0);
+
+    const std::size_t block_end = size - size % 16;
+
+    for(std::size_t index = 0; index < block_end; index += 16)
+    {
+        checksum = veorq_u8(checksum, vld1q_u8(text + index));
+    }
+
+    unsigned char bytes[16];
+    vst1q_u8(bytes, checksum);
+
+    return XorChecksumTail(XorFoldBytes(bytes, sizeof(bytes)), text, block_end, size);
+}
+
+StringScan ScanStringNeon(const unsigned char *text, std::size_t size)
+{
+    const uint8x16_t ascii_zero = vdupq_n_u8('0');
+    const uint8x16_t ten = vdupq_n_u8(10);
+    const uint8x16_t one = vdupq_n_u8(1);
+
+    uint8x16_t checksum = vdupq_n_u8(0);
+
+    StringScan scan;
+
+    const std::size_t block_end = size - size % 16;
+
+    for(std::size_t index = 0; index < block_end; index += 16)
+    {
+        uint8x16_t bytes = vld1q_u8(text + index);
+        uint8x16_t digits = vsubq_u8(bytes, ascii_zero);
+        uint8x16_t is_digit = vcltq_u8(digits, ten);
+
+        scan.digit_sum += vaddlvq_u8(vandq_u8(digits, is_digit));
+        checksum = veorq_u8(checksum, bytes);
+
+        if(scan.digit_product != 0.0 && vmaxvq_u8(vbicq_u8(is_digit, vceqq_u8(digits, one))) != 0)
+        {
+            scan.digit_product = DigitProductTail(scan.digit_product, text, index, index + 16);
+        }
+    }
+
+    unsigned char checksum_bytes[16];
+    vst1q_u8(checksum_bytes, checksum);
+
+    scan.checksum = XorFoldBytes(checksum_bytes, sizeof(checksum_bytes));
+
+    return ScanStringTail(scan, text, block_end, size);
+}
+
+#endif // KERNELS_NEON
+
+
+//////////////////////////////////////////////////////////////////////
+// Checksum kernels
+//
+// XorFold64 XORs the string as 64-bit words in native byte order, the
+// last word zero padded, which takes one load and one XOR per 8 bytes
+// and is folded a whole register at a time by the vector versions.
+//
+// Crc32c uses the reflected Castagnoli polynomial of iSCSI and ext4.
+// The hardware versions feed 8 bytes per instruction to the SSE4.2 or
+// ARMv8 CRC32C instruction, and the portable version uses a table.
+//////////////////////////////////////////////////////////////////////
+
+std::uint64_t XorFoldTail(std::uint64_t fold, const unsigned char *text, std::size_t begin, std::size_t end)
+{
+    for(std::size_t index = begin; index < end; index += sizeof(std::uint64_t))
+    {
+        std::uint64_t word = 0;
+        std::memcpy(&word, text + index, std::min(sizeof(word), end - index));
+
+        fold ^= word;
+    }
+
+    return fold;
+}
+
+std::uint64_t XorFold64Generic(const unsigned char *text, std::size_t size)
+{
+    return XorFoldTail(0, text, 0, size);
+}
+
+constexpr std::uint32_t crc32c_polynomial = 0x82f63b78;
+
+struct Crc32cTable
+{
+    std::uint32_t entries[256];
+
+    constexpr Crc32cTable()
+        : entries{}
+    {
+        for(std::uint32_t byte = 0; byte < 256; ++ byte)
+        {
+            std::uint32_t crc = byte;
+
+            for(int bit = 0; bit < 8; ++ bit)
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ crc32c_polynomial : crc >> 1;
+            }
+
+            entries[byte] = crc;
+        }
+    }
+};
+
+constexpr Crc32cTable crc32c_table;
+
+// The crc passed to and returned by the kernels is the raw register,
+// without the final inversion
+std::uint32_t Crc32cGeneric(std::uint32_t crc, const unsigned char *text, std::size_t size)
+{
+    for(std::size_t index = 0; index < size; ++ index)
+    {
+        crc = crc32c_table.entries[(crc ^ text[index]) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+
+#if defined(KERNELS_X86)
+
+// 8 bytes per instruction on x86-64, 4 on i386, which has no
+// _mm_crc32_u64
+__attribute__((target("sse4.2")))
+std::uint32_t Crc32cSse42(std::uint32_t crc, const unsigned char *text, std::size_t size)
+{
+#if defined(__x86_64__)
+    using Word = std::uint64_t;
+#else
+    using Word = std::uint32_t;
+#endif
+
+    Word crc_word = crc;
+
+    const std::size_t block_end = size - size % sizeof(Word);
+
+    for(std::size_t index = 0; index < block_end; index += sizeof(Word))
+    {
+        Word word;
+        std::memcpy(&word, text + index, sizeof(word));
+
+#if defined(__x86_64__)
+        crc_word = _mm_crc32_u64(crc_word, word);
+#else
+        crc_word = _mm_crc32_u32(crc_word, word);
+#endif
+    }
+
+    crc = static_cast<std::uint32_t>(crc_word);
+
+    for(std::size_t index = block_end; index < size; ++ index)
+    {
+        crc = _mm_crc32_u8(crc, text[index]);
+    }
+
+    return crc;
+}
+
+__attribute__((target("avx2")))
+std::uint64_t XorFold64Avx2(const unsigned char *text, std::size_t size)
+{
+    __m256i fold = _mm256_setzero_si256();
+
+    const std::size_t block_end = size - size % 32;
+
+    for(std::size_t index = 0; index < block_end; index += 32)
+    {
+        fold = _mm256_xor_si256(fold, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + index)));
+    }
+
+    std::uint64_t words[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(words), fold);
+
+    _mm256_zeroupper();
+
+    return XorFoldTail(words[0] ^ words[1] ^ words[2] ^ words[3], text, block_end, size);
+}
+
+__attribute__((target("avx512f")))
+std::uint64_t XorFold64Avx512(const unsigned char *text, std::size_t size)
+{
+    __m512i fold = _mm512_setzero_si512();
+
+    const std::size_t block_end = size - size % 64;
+
+    for(std::size_t index = 0; index < block_end; index += 64)
+    {
+        fold = _mm512_xor_si512(fold, _mm512_loadu_si512(text + index));
+    }
+
+    std::uint64_t words[8];
+    _mm512_storeu_si512(words, fold);
+
+    _mm256_zeroupper();
+
+    std::uint64_t word_fold = 0;
+
+    for(std::uint64_t word : words)
+    {
+        word_fold ^= word;
+    }
+
+    return XorFoldTail(word_fold, text, block_end, size);
+}
+
+#endif // KERNELS_X86
+
+
+#if defined(KERNELS_NEON)
+
+std::uint64_t XorFold64Neon(const unsigned char *text, std::size_t size)
+{
+    uint64x2_t fold = vdupq_n_u64(0);
+
+    const std::size_t block_end = size - size % 16;
+
+    for(std::size_t index = 0; index < block_end; index += 16)
+    {
+        fold = veorq_u64(fold, vreinterpretq_u64_u8(vld1q_u8(text + index)));
+    }
+
+    return XorFoldTail(vgetq_lane_u64(fold, 0) ^ vgetq_lane_u64(fold, 1), text, block_end, size);
+}
+
+#if defined(__ARM_FEATURE_CRC32)
+
+std::uint32_t Crc32cArm(std::uint32_t crc, const unsigned char *text, std::size_t size)
+{
+    const std::size_t block_end = size - size % sizeof(std::uint64_t);
+
+    for(std::size_t index = 0; index < block_end; index += sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        std::memcpy(&word, text + index, sizeof(word));
+
+        crc = __crc32cd(crc, word);
+    }
+
+    for(std::size_t index = block_end; index < size; ++ index)
+    {
+        crc = __crc32cb(crc, text[index]);
+    }
+
+    return crc;
+}
+
+#define KERNELS_NEON_CRC32C Crc32cArm
+#else
+#define KERNELS_NEON_CRC32C Crc32cGeneric
+#endif // __ARM_FEATURE_CRC32
+
+#endif // KERNELS_NEON
+
+
+//////////////////////////////
+// Run time selection
+//////////////////////////////
+
+using ReduceFunction = double (*)(const double *values, std::size_t count);
+using DigitSumFunction = std::uint64_t (*)(const unsigned char *text, std::size_t size);
+using DigitProductFunction = double (*)(double product, const unsigned char *text, std::size_t size);
+using XorChecksumFunction = unsigned char (*)(const unsigned char *text, std::size_t size);
+using SumAndProductFunction = SumAndProductResult (*)(const double *values, std::size_t count);
+using ScanStringFunction = StringScan (*)(const unsigned char *text, std::size_t size);
+using ScaledProductFunction = ScaledDouble (*)(const double *values, std::size_t count);
+using FloatReduceFunction = double (*)(const float *values, std::size_t count);
+using Int32SumFunction = std::int64_t (*)(const std::int32_t *values, std::size_t count);
+using Int64SumFunction = Int128 (*)(const std::int64_t *values, std::size_t count);
+using XorFold64Function = std::uint64_t (*)(const unsigned char *text, std::size_t size);
+using Crc32cFunction = std::uint32_t (*)(std::uint32_t crc, const unsigned char *text, std::size_t size);
+
+struct KernelTable
+{
+    ReduceFunction sum;
+    ReduceFunction product;
+    SumAndProductFunction sum_and_product;
+    ScaledProductFunction scaled_product;
+    FloatReduceFunction float_sum;
+    FloatReduceFunction float_product;
+    Int32SumFunction int32_sum;
+    Int64SumFunction int64_sum;
+    DigitSumFunction digit_sum;
+    DigitProductFunction digit_product;
+    XorChecksumFunction xor_checksum;
+    ScanStringFunction scan_string;
+    XorFold64Function xor_fold64;
+    Crc32cFunction crc32c;
+    const char *name;
+};
+
+const KernelTable& SelectKernels()
+{
+    static const KernelTable selected = []() -> KernelTable
+    {
+#if defined(KERNELS_X86)
+        __builtin_cpu_init();
+
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        {
+            return KernelTable{SumAvx512, ProductAvx512, SumAndProductAvx512, ScaledProductAvx512,
+                SumAvx512, ProductAvx512, Int32SumAvx512, KERNELS_AVX512_INT64_SUM,
+                DigitSumAvx512, DigitProductAvx512, XorChecksumAvx512, ScanStringAvx512,
+                XorFold64Avx512, Crc32cSse42, "avx512"};
+        }
+
+        if(__builtin_cpu_supports("avx2"))
+        {
+            return KernelTable{SumAvx2, ProductAvx2, SumAndProductAvx2, ScaledProductAvx2,
+                SumAvx2, ProductAvx2, Int32SumAvx2, KERNELS_AVX2_INT64_SUM,
+                DigitSumAvx2, DigitProductAvx2, XorChecksumAvx2, ScanStringAvx2,
+                XorFold64Avx2, Crc32cSse42, "avx2"};
+        }
+
+        if(__builtin_cpu_supports("sse2"))
+        {
+            return KernelTable{SumGeneric, ProductGeneric, SumAndProductGeneric, ScaledProductGeneric,
+                SumGeneric, ProductGeneric, Int32SumGeneric, Int64SumGeneric,
+                DigitSumSse2, DigitProductSse2, XorChecksumSse2, ScanStringSse2,
+                XorFold64Generic, __builtin_cpu_supports("sse4.2") ? Crc32cSse42 : Crc32cGeneric, "sse2"};
+        }
+#elif defined(KERNELS_NEON)
+        return KernelTable{SumNeon, ProductNeon, SumAndProductNeon, ScaledProductGeneric,
+            SumNeon, ProductNeon, Int32SumNeon, KERNELS_NEON_INT64_SUM,
+            DigitSumNeon, DigitProductNeon, XorChecksumNeon, ScanStringNeon,
+            XorFold64Neon, KERNELS_NEON_CRC32C, "neon"};
+#endif
+        return KernelTable{SumGeneric, ProductGeneric, SumAndProductGeneric, ScaledProductGeneric,
+            SumGeneric, ProductGeneric, Int32SumGeneric, Int64SumGeneric,
+            DigitSumGeneric, DigitProductGeneric, XorChecksumGeneric, ScanStringGeneric,
+            XorFold64Generic, Crc32cGeneric, "generic"};
+    }();
+
+    return selected;
+}
+
+const unsigned char* Bytes(std::string_view text)
+{
+    return reinterpret_cast<const unsigned char*>(text.data());
+}
+
+} // namespace
+
+
+namespace detail
+{
+
+double SumReassociated(const double *values, std::size_t count)
+{
+    return SelectKernels().sum(values, count);
+}
+
+double ProductReassociated(const double *values, std::size_t count)
+{
+    return SelectKernels().product(values, count);
+}
+
+SumAndProductResult SumAndProductReassociated(const double *values, std::size_t count)
+{
+    return SelectKernels().sum_and_product(values, count);
+}
+
+ScaledDouble ScaledProductReassociated(const double *values, std::size_t count)
+{
+    return SelectKernels().scaled_product(values, count);
+}
+
+double SumReassociated(const float *values, std::size_t count)
+{
+    return SelectKernels().float_sum(values, count);
+}
+
+double ProductReassociated(const float *values, std::size_t count)
+{
+    return SelectKernels().float_product(values, count);
+}
+
+} // namespace detail
+
+
+std::int64_t Sum(std::span<const std::int32_t> values)
+{
+    return SelectKernels().int32_sum(values.data(), values.size());
+}
+
+Int128 Sum(std::span<const std::int64_t> values)
+{
+    return SelectKernels().int64_sum(values.data(), values.size());
+}
+
+
+double DigitSum(std::string_view text)
+{
+    return static_cast<double>(SelectKernels().digit_sum(Bytes(text), text.size()));
+}
+
+double DigitProduct(std::string_view text, double product)
+{
+    return SelectKernels().digit_product(product, Bytes(text), text.size());
+}
+
+unsigned char XorChecksum(std::string_view text)
+{
+    return SelectKernels().xor_checksum(Bytes(text), text.size());
+}
+
+std::uint64_t XorFold64(std::string_view text)
+{
+    return SelectKernels().xor_fold64(Bytes(text), text.size());
+}
+
+std::uint32_t Crc32c(std::string_view text, std::uint32_t crc)
+{
+    return ~SelectKernels().crc32c(~crc, Bytes(text), text.size());
+}
+
+StringStatistics ScanString(std::string_view text)
+{
+    StringScan scan = SelectKernels().scan_string(Bytes(text), text.size());
+
+    return StringStatistics{static_cast<double>(scan.digit_sum), scan.digit_product, scan.checksum};
+}
+
+
+const char* GetInstructionSetName()
+{
+    return SelectKernels().name;
+}
+
+} // namespace kernels
@@ -0,0 +1,338 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <numeric>
+
+//////////////////////////////////////////////////////////////////////
+// Reduction kernels shared by the virtual (AbstractVisitor) and the
+// static (std::variant) dispatch engines, so that both always produce
+// the same results
+//////////////////////////////////////////////////////////////////////
+
+// Floating point addition and multiplication are not associative, so
+// the order of a reduction is part of its result
+enum class ReductionMode
+{
+    // Reduce in element order. Bit-identical to std::accumulate, but
+    // every operation depends on the previous one, so it can neither
+    // be vectorized nor pipelined.
+    Strict,
+
+    // Reduce in 16 interleaved lanes: lane j accumulates the elements
+    // whose index is congruent to j modulo 16, over all complete blocks
+    // of 16. The lanes are then combined as a tree (lane j with lane
+    // j + 8, then j + 4, j + 2 and j + 1), and the remaining
+    // elements are reduced into the result in order.
+    //
+    // The order is fixed, so the result does not depend on which
+    // instruction set the kernel is dispatched to at run time, but it
+    // generally differs from Strict in the last bits.
+    Reassociate
+};
+
+
+namespace kernels
+{
+
+namespace detail
+{
+
+// Defined in kernels.cpp, which selects an AVX-512, AVX2, NEON or
+// portable implementation on first use
+double SumReassociated(const double *values, std::size_t count);
+double ProductReassociated(const double *values, std::size_t count);
+
+// Float arrays are reduced in double, loading the floats and widening
+// them in registers
+double SumReassociated(const float *values, std::size_t count);
+double ProductReassociated(const float *values, std::size_t count);
+
+struct SumAndProductResult
+{
+    double sum;
+    double product;
+};
+
+SumAndProductResult SumAndProductReassociated(const double *values, std::size_t count);
+
+} // namespace detail
+
+
+// A double held as mantissa * 2^exponent, with the mantissa in
+// [1, 2) up to its sign. Zeros, infinities and NaNs are held as the
+// mantissa with a zero exponent.
+struct ScaledDouble
+{
+    double mantissa;
+    std::int64_t exponent;
+};
+
+namespace detail
+{
+
+ScaledDouble ScaledProductReassociated(const double *values, std::size_t count);
+
+} // namespace detail
+
+// Name of the instruction set selected at run time for the
+// Reassociate array kernels and the string kernels
+const char* GetInstructionSetName();
+
+inline bool IsDigit(unsigned char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+inline double Sum(std::span<const double> values, ReductionMode mode = ReductionMode::Strict)
+{
+    if(mode == ReductionMode::Reassociate)
+    {
+        return detail::SumReassociated(values.data(), values.size());
+    }
+
+    return std::accumulate(values.begin(), values.end(), 0.0);
+}
+
+inline double Product(std::span<const double> values, ReductionMode mode = ReductionMode::Strict)
+{
+    if(mode == ReductionMode::Reassociate)
+    {
+        return detail::ProductReassociated(values.data(), values.size());
+    }
+
+    auto lambda = [](double product, double value)
+    {
+        return product * value;
+    };
+
+    return std::accumulate(values.begin(), values.end(), 1.0, lambda);
+}
+
+// The float kernels accumulate in double, in the same order as the
+// double kernels, so their results are bit-identical to those of Sum
+// and Product over the values widened to double, while reading half
+// as many bytes
+inline double Sum(std::span<const float> values, ReductionMode mode = ReductionMode::Strict)
+{
+    if(mode == ReductionMode::Reassociate)
+    {
+        return detail::SumReassociated(values.data(), values.size());
+    }
+
+    return std::accumulate(values.begin(), values.end(), 0.0);
+}
+
+inline double Product(std::span<const float> values, ReductionMode mode = ReductionMode::Strict)
+{
+    if(mode == ReductionMode::Reassociate)
+    {
+        return detail::ProductReassociated(values.data(), values.size());
+    }
+
+    auto lambda = [](double product, float value)
+    {
+        return product * value;
+    };
+
+    return std::accumulate(values.begin(), values.end(), 1.0, lambda);
+}
+
+// A 128-bit two's complement integer as two 64-bit words. __int128 is
+// a compiler extension which 32-bit targets do not have, so it is not
+// used in the interface.
+struct Int128
+{
+    std::uint64_t low = 0;
+    std::int64_t high = 0;
+
+    Int128& operator+=(std::int64_t value)
+    {
+        const std::uint64_t previous = low;
+
+        low += static_cast<std::uint64_t>(value);
+        high += (value < 0 ? -1 : 0) + (low < previous ? 1 : 0);
+
+        return *this;
+    }
+
+    bool operator==(const Int128&) const = default;
+
+    // Rounded to the nearest double, as a conversion from __int128 is
+    explicit operator double() const
+    {
+        const bool negative = high < 0;
+
+        std::uint64_t magnitude_low = low;
+        std::uint64_t magnitude_high = static_cast<std::uint64_t>(high);
+
+        if(negative)
+        {
+            magnitude_low = ~magnitude_low + 1;
+            magnitude_high = ~magnitude_high + (magnitude_low == 0 ? 1 : 0);
+        }
+
+        double magnitude;
+
+        if(magnitude_high == 0)
+        {
+            magnitude = static_cast<double>(magnitude_low);
+        }
+        else
+        {
+            // The 64 leading bits, with any bit shifted out below them
+            // kept as a sticky bit, round as the whole value would
+            const int shift = 64 - std::countl_zero(magnitude_high);
+            const std::uint64_t top = (magnitude_high << (64 - shift)) | (shift < 64 ? magnitude_low >> shift : 0);
+            const std::uint64_t sticky = (magnitude_low << (64 - shift)) != 0 ? 1 : 0;
+
+            magnitude = std::ldexp(static_cast<double>(top | sticky), shift);
+        }
+
+        return negative ? -magnitude : magnitude;
+    }
+};
+
+// Exact sums of integer arrays, defined in kernels.cpp. Integer
+// addition is associative, so there is no ReductionMode and the
+// kernels are always vectorized. The sum of 32-bit integers is
+// accumulated in 64 bits, which cannot overflow below 2^32 values, and
+// the sum of 64-bit integers in 128 bits, which cannot overflow at all.
+std::int64_t Sum(std::span<const std::int32_t> values);
+Int128 Sum(std::span<const std::int64_t> values);
+
+// Split value into its mantissa and exponent, exactly. Subnormal
+// values are normalized as well.
+inline ScaledDouble Decompose(double value)
+{
+    std::uint64_t bits = std::bit_cast<std::uint64_t>(value);
+    std::int64_t exponent = static_cast<std::int64_t>((bits >> 52) & 0x7ff);
+
+    if(exponent == 0x7ff || value == 0.0)
+    {
+        return ScaledDouble{value, 0};
+    }
+
+    std::int64_t offset = 1023;
+
+    if(exponent == 0)
+    {
+        bits = std::bit_cast<std::uint64_t>(value * 0x1p64);
+        exponent = static_cast<std::int64_t>((bits >> 52) & 0x7ff);
+        offset += 64;
+    }
+
+    const double mantissa = std::bit_cast<double>((bits & 0x800fffffffffffff) | 0x3ff0000000000000);
+
+    return ScaledDouble{mantissa, exponent - offset};
+}
+
+// Bring the mantissa of scaled back to [1, 2), moving the powers of
+// two to the exponent
+inline void Normalize(ScaledDouble &scaled)
+{
+    const ScaledDouble parts = Decompose(scaled.mantissa);
+
+    scaled.mantissa = parts.mantissa;
+    scaled.exponent += parts.exponent;
+}
+
+// Product of an array as a ScaledDouble, which can neither overflow
+// nor underflow. Only the mantissas are multiplied, and the exponents
+// of the factors are added as integers. Scaling by a power of two is
+// exact, so wherever Product stays within the normal range of a
+// double the result has exactly its value, in the same mode.
+//
+// Strict multiplies in order and normalizes after every factor. The
+// Reassociate kernel follows the lanes of Product, normalizing the
+// lanes every few hundred blocks, and is vectorized except for blocks
+// holding zeros, subnormals, infinities or NaNs.
+inline ScaledDouble ScaledProduct(std::span<const double> values, ReductionMode mode = ReductionMode::Strict)
+{
+    if(mode == ReductionMode::Reassociate)
+    {
+        return detail::ScaledProductReassociated(values.data(), values.size());
+    }
+
+    ScaledDouble product{1.0, 0};
+
+    for(double value : values)
+    {
+        const ScaledDouble factor = Decompose(value);
+
+        product.mantissa *= factor.mantissa;
+        product.exponent += factor.exponent;
+
+        Normalize(product);
+    }
+
+    return product;
+}
+
+// Sum and product of the same array in one pass over memory, each
+// bit-identical to the separate Sum and Product in the same mode
+inline detail::SumAndProductResult SumAndProduct(std::span<const double> values,
+    ReductionMode mode = ReductionMode::Strict)
+{
+    if(mode == ReductionMode::Reassociate)
+    {
+        return detail::SumAndProductReassociated(values.data(), values.size());
+    }
+
+    detail::SumAndProductResult result{0.0, 1.0};
+
+    for(double value : values)
+    {
+        result.sum += value;
+        result.product *= value;
+    }
+
+    return result;
+}
+
+// String kernels, defined in kernels.cpp. They classify 16, 32 or
+// 64 bytes at a time depending on the instruction set, and their
+// results are identical to the byte at a time definitions:
+//
+// DigitSum:     sum of the values of the decimal digits. The sum is
+//               accumulated as an integer, which is exact wherever the
+//               ordered double sum is (below 2^53).
+// DigitProduct: product of the values of the decimal digits, still
+//               multiplied one at a time in order, but the scan skips
+//               over blocks with no digits other than '1'. The digits
+//               are multiplied into product, so a string can be scanned
+//               a piece at a time by passing on the running product.
+// XorChecksum:  XOR of all bytes
+double DigitSum(std::string_view text);
+double DigitProduct(std::string_view text, double product = 1.0);
+unsigned char XorChecksum(std::string_view text);
+
+// Wider checksums, defined in kernels.cpp:
+//
+// XorFold64:    XOR of the string taken as 64-bit words in native byte
+//               order, the last word padded with zeros
+// Crc32c:       CRC-32C (Castagnoli) of the string, using the CRC32
+//               instructions of SSE4.2 or ARMv8 where available. With
+//               the crc of a previous piece of a string passed in, the
+//               result is the crc of both pieces together.
+std::uint64_t XorFold64(std::string_view text);
+std::uint32_t Crc32c(std::string_view text, std::uint32_t crc = 0);
+
+// DigitSum, DigitProduct and XorChecksum of the same string in one pass
+struct StringStatistics
+{
+    double digit_sum;
+    double digit_product;
+    unsigned char checksum;
+};
+
+StringStatistics ScanString(std::string_view text);
+
+} // namespace kernels
+
+#endif // KERNELS_H
@@ -0,0 +1,385 @@
+#ifndef LIVE_AGGREGATE_H
+#define LIVE_AGGREGATE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+
+#include "elements.h"
+#include "element_container.h"
+#include "kernels.h"
+
+//////////////////////////////////////////////////////////////////////
+// Live aggregates
+//
+// A live aggregate subscribes to an ElementContainer and keeps the
+// result of one of the built-in reductions up to date as the
+// container changes, so reading it never traverses the collection:
+//
+//     LiveSum live_sum(element_container);
+//
+//     element_container.GetSingleElements()[0].SetValue(4.0);
+//     live_sum.GetValue();     // already includes the change
+//
+// Each change is applied as a delta: the old value of the changed part
+// of a payload is taken out of the aggregate and the new value put in,
+// at a cost proportional to the size of the change. The values follow
+// the definitions of SumVisitor, MultiplyVisitor and XORVisitor.
+//
+// The XOR checksum is maintained exactly. The sum is floating point,
+// and taking a value out again is only exact while the results are
+// exact (for example integers below 2^53); otherwise rounding errors
+// can build up over many changes, and the aggregate can be recomputed
+// with Rebuild. The product counts its zero, infinite and NaN factors
+// apart from the finite others, whose product is kept as a mantissa
+// and a binary exponent which cannot overflow or underflow. Any factor
+// can so be taken out again, exactly up to the rounding of the
+// mantissa, even when the product itself is out of the range of a
+// double.
+//
+// The aggregate unsubscribes itself when destroyed, and must not
+// outlive the container.
+//////////////////////////////////////////////////////////////////////
+
+class LiveAggregate : public ElementObserver
+{
+
+public:
+
+    LiveAggregate(const LiveAggregate&) = delete;
+    LiveAggregate& operator=(const LiveAggregate&) = delete;
+
+    virtual
+    ~LiveAggregate()
+    {
+        container.Unsubscribe(*this);
+    }
+
+    // Recompute the aggregate from the elements of the container
+    void Rebuild()
+    {
+        container.Unsubscribe(*this);
+        OnClear();
+        container.Subscribe(*this);
+    }
+
+protected:
+
+    explicit LiveAggregate(ElementContainer &container)
+        : container(container)
+    {
+    }
+
+    // Called at the end of the constructor of the concrete aggregate,
+    // once it is ready to be given the elements of the container
+    void Subscribe()
+    {
+        container.Subscribe(*this);
+    }
+
+private:
+
+    ElementContainer &container;
+
+};
+
+
+class LiveSum : public LiveAggregate
+{
+
+public:
+
+    explicit LiveSum(ElementContainer &container)
+        : LiveAggregate(container)
+        , value{0.0}
+    {
+        Subscribe();
+    }
+
+    double GetValue() const
+    {
+        return value;
+    }
+
+    void OnInsert(double v)
+    {
+        value += v;
+    }
+
+    void OnErase(double v)
+    {
+        value -= v;
+    }
+
+    void OnInsert(std::span<const double> values)
+    {
+        value += kernels::Sum(values);
+    }
+
+    void OnErase(std::span<const double> values)
+    {
+        value -= kernels::Sum(values);
+    }
+
+    void OnInsert(std::string_view text)
+    {
+        value += kernels::DigitSum(text);
+    }
+
+    void OnErase(std::string_view text)
+    {
+        value -= kernels::DigitSum(text);
+    }
+
+    void OnClear()
+    {
+        value = 0.0;
+    }
+
+private:
+
+    double value;
+
+};
+
+
+class LiveProduct : public LiveAggregate
+{
+
+public:
+
+    explicit LiveProduct(ElementContainer &container)
+        : LiveAggregate(container)
+        , mantissa(1.0)
+        , exponent{0}
+        , zero_count{0}
+        , positive_infinity_count{0}
+        , negative_infinity_count{0}
+        , nan_count{0}
+    {
+        Subscribe();
+    }
+
+    double GetValue() const
+    {
+        const std::size_t infinity_count = positive_infinity_count + negative_infinity_count;
+
+        if(nan_count > 0 || (infinity_count > 0 && zero_count > 0))
+        {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+
+        if(infinity_count > 0)
+        {
+            const double sign = negative_infinity_count % 2 == 0 ? mantissa : - mantissa;
+
+            return std::copysign(std::numeric_limits<double>::infinity(), sign);
+        }
+
+        if(zero_count > 0)
+        {
+            return 0.0;
+        }
+
+        // Past these exponents the result is infinite or zero anyway
+        const std::int64_t limit = 4096;
+
+        return std::ldexp(mantissa, static_cast<int>(std::clamp(exponent, -limit, limit)));
+    }
+
+    // Number of zero factors in the collection
+    std::size_t GetZeroCount() const
+    {
+        return zero_count;
+    }
+
+    void OnInsert(double v)
+    {
+        Insert(v);
+    }
+
+    void OnErase(double v)
+    {
+        Erase(v);
+    }
+
+    void OnInsert(std::span<const double> values)
+    {
+        for(double v : values)
+        {
+            Insert(v);
+        }
+    }
+
+    void OnErase(std::span<const double> values)
+    {
+        for(double v : values)
+        {
+            Erase(v);
+        }
+    }
+
+    void OnInsert(std::string_view text)
+    {
+        for(char c : text)
+        {
+            if(kernels::IsDigit(c))
+            {
+                Insert(c - '0');
+            }
+        }
+    }
+
+    void OnErase(std::string_view text)
+    {
+        for(char c : text)
+        {
+            if(kernels::IsDigit(c))
+            {
+                Erase(c - '0');
+            }
+        }
+    }
+
+    void OnClear()
+    {
+        mantissa = 1.0;
+        exponent = 0;
+        zero_count = 0;
+        positive_infinity_count = 0;
+        negative_infinity_count = 0;
+        nan_count = 0;
+    }
+
+private:
+
+    void Insert(double factor)
+    {
+        if(std::isfinite(factor) && factor != 0.0)
+        {
+            int factor_exponent;
+            mantissa *= std::frexp(factor, &factor_exponent);
+            exponent += factor_exponent;
+
+            Normalize();
+        }
+        else
+        {
+            ++ CountOf(factor);
+        }
+    }
+
+    void Erase(double factor)
+    {
+        if(std::isfinite(factor) && factor != 0.0)
+        {
+            int factor_exponent;
+            mantissa /= std::frexp(factor, &factor_exponent);
+            exponent -= factor_exponent;
+
+            Normalize();
+        }
+        else
+        {
+            -- CountOf(factor);
+        }
+    }
+
+    // The count of a zero, infinite or NaN factor
+    std::size_t& CountOf(double factor)
+    {
+        if(factor == 0.0)
+        {
+            return zero_count;
+        }
+        else if(std::isnan(factor))
+        {
+            return nan_count;
+        }
+        else
+        {
+            return factor > 0.0 ? positive_infinity_count : negative_infinity_count;
+        }
+    }
+
+    // Bring the mantissa back into [0.5, 1), up to its sign
+    void Normalize()
+    {
+        int mantissa_exponent;
+        mantissa = std::frexp(mantissa, &mantissa_exponent);
+        exponent += mantissa_exponent;
+    }
+
+    // The product of the finite non-zero factors is mantissa * 2^exponent
+    double mantissa;
+    std::int64_t exponent;
+
+    std::size_t zero_count;
+    std::size_t positive_infinity_count;
+    std::size_t negative_infinity_count;
+    std::size_t nan_count;
+
+};
+
+
+class LiveXOR : public LiveAggregate
+{
+
+public:
+
+    explicit LiveXOR(ElementContainer &container)
+        : LiveAggregate(container)
+        , value{0}
+    {
+        Subscribe();
+    }
+
+    unsigned char GetValue() const
+    {
+        return value;
+    }
+
+    // The checksum is only defined for strings
+    void OnInsert(double v)
+    {
+    }
+
+    void OnErase(double v)
+    {
+    }
+
+    void OnInsert(std::span<const double> values)
+    {
+    }
+
+    void OnErase(std::span<const double> values)
+    {
+    }
+
+    // XOR is its own inverse
+    void OnInsert(std::string_view text)
+    {
+        value ^= kernels::XorChecksum(text);
+    }
+
+    void OnErase(std::string_view text)
+    {
+        value ^= kernels::XorChecksum(text);
+    }
+
+    void OnClear()
+    {
+        value = 0;
+    }
+
+private:
+
+    unsigned char value;
+
+};
+
+#endif // LIVE_AGGREGATE_H
@@ -1,591 +1,787 @@
 // TODO:
 //
-// Add a template example type (eg: ArrayElement<T>)
 // Check if the types (concrete or abstract) are in the right place
 // See Design Patterns book and SO questions
 
 #include <iostream>
-#include <string>
 #include <vector>
-#include <list>
 #include <algorithm>
-#include <numeric>
-#include <stdexcept>
+#include <cmath>
+#include <filesystem>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "elements.h"
+#include "visitors.h"
+#include "variant_visitors.h"
+#include "element_container.h"
+#include "fused_visitor.h"
+#include "checksum_visitors.h"
+#include "thread_pool.h"
+#include "parallel_visit.h"
+#include "work_stealing.h"
+#include "element_file.h"
+#include "string_stream.h"
+#include "cached_visit.h"
+#include "live_aggregate.h"
+#include "instrumentation.h"
+#include "async_pipeline.h"
+#include "streaming_workers.h"
+#include "type_list_visitor.h"
+#include "shard_visit.h"
 
-class AbstractVisitor;
 
-class AbstractElement
+int main(int argc, char *argv[])
 {
 
-public:
-
-    virtual
-    ~AbstractElement();
+    // Initialize some stuff
 
-    virtual
-    void Accept(AbstractVisitor &visitor) = 0;
+    std::vector<double> initial_values{1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0};
 
-};
+    std::vector<SingleElement> single_element_list;
 
-AbstractElement::~AbstractElement()
-{
-    // I do nothing
-}
+    std::transform(initial_values.cbegin(), initial_values.cend(),
+        std::back_inserter(single_element_list), [](auto v){return SingleElement(v);});
 
+    // This could be done in a similar way using transform,
+    // as above
+    std::vector<ArrayElement> array_element_list
+    {
+        ArrayElement({1.0}),
+        ArrayElement({2.0, 3.0}),
+        ArrayElement({4.0, 5.0, 6.0}),
+        ArrayElement({7.0, 8.0, 9.0})
+    };
+    
+    StringElement string_element("Hello World 123456789\2");
 
-//////////////////////////////////////////////////////////////////////
-// Pre-emptive declaration of AbstractVisitor, used by classes below
-//////////////////////////////////////////////////////////////////////
+    SumVisitor sum_visitor;
+    MultiplyVisitor multiply_visitor;
+    XORVisitor xor_visitor;
 
-class SingleElement;
-class ArrayElement;
-class StringElement;
+    ///////////////////////////////
+    // Process SingleElement list
+    ///////////////////////////////
 
-class AbstractVisitor
-{
+    // Adapter class (functor)
+    class ForEachAdapter
+    {
+    public:
 
-public:
+        // The polymorhpism is retained in the member
+        // variable reference-to-visitor
+        ForEachAdapter(AbstractVisitor& visitor_type)
+            : visitor_type(visitor_type)
+        {
+        }
 
-    virtual
-    ~AbstractVisitor()
-    {
+        // The purpose of this class is simply to convert
+        // the function call operator into a call to
+        // element.Accept()
+        void operator() (AbstractElement &element)
+        {
+            element.Accept(visitor_type);
+        }
 
-    }
+    private:
 
-    virtual void ProcessSingleElement(const SingleElement& element) = 0;
-    virtual void ProcessArrayElement(const ArrayElement& element) = 0;
-    virtual void ProcessStringElement(const StringElement& element) = 0;
+        AbstractVisitor &visitor_type;
 
-};
+    };
 
+    // The XOR Visitor only supports the StringElement type. Applying it
+    // to a SingleElement or ArrayElement leaves the checksum unchanged
+    // and counts the element as unsupported, see GetUnsupportedCount.
+
+    // This can also be done using a standard
+    // range-based for-auto loop
+    //
+    //for(auto element : single_element_list)
+    //{
+    //    element.Accept(sum_visitor);
+    //}
+
+    // Here we use the adapter class with for_each, however
+    // this can also be done using a lambda function.
+    // See below for an example of how to do that
+    ForEachAdapter adapter(sum_visitor);
+    std::for_each(single_element_list.begin(), single_element_list.end(), adapter);
+
+    // This version uses for_each in combination with a lambda
+    // The lambda accomplishes the same thing as the functor,
+    // however the functor is probably easier to understand
+    // for those not familiar with lambdas.
+    std::for_each(single_element_list.begin(), single_element_list.end(),
+        [&multiply_visitor](AbstractElement &element)
+        {
+            element.Accept(multiply_visitor);
+        }
+    );
 
-class SingleElement : public AbstractElement
-{
+    std::for_each(single_element_list.begin(), single_element_list.end(),
+        [&xor_visitor](AbstractElement &element)
+        {
+            element.Accept(xor_visitor);
+        }
+    );
+    
+    // Print result
+    std::cout << "Sum of SingleElement list: " << sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of SingleElement list: " << multiply_visitor.GetValue() << std::endl;
+    std::cout << "Checksum of SingleElement list: " << static_cast<int>(xor_visitor.GetValue())  << std::endl;
+    std::cout << "Unsupported by XOR Visitor: " << xor_visitor.GetUnsupportedCount() << std::endl;
+    sum_visitor.Reset();
+    multiply_visitor.Reset();
+    xor_visitor.Reset();
 
-public:
+    /////////////////////////////////////////
+    // Fractional values, exact and truncated
+    /////////////////////////////////////////
 
-    SingleElement(double value)
-        : value(value)
+    // SumVisitor adds the exact values, TruncatingSumVisitor adds each
+    // value truncated to an int
     {
-    }
+        std::vector<SingleElement> fractional_list{SingleElement(1.5), SingleElement(2.25), SingleElement(3.75)};
 
-    virtual
-    ~SingleElement()
-    {
-        // I do nothing
-    }
+        TruncatingSumVisitor truncating_sum_visitor;
 
-    double GetValue() const
-    {
-        return value;
+        for(SingleElement &element : fractional_list)
+        {
+            element.Accept(sum_visitor);
+            element.Accept(truncating_sum_visitor);
+        }
+
+        std::cout << "Sum of fractional SingleElement list: " << sum_visitor.GetValue() << std::endl;
+        std::cout << "Sum of fractional SingleElement list (truncated): " << truncating_sum_visitor.GetValue() << std::endl;
+        sum_visitor.Reset();
     }
 
-    void SetValue(const double value)
+    ///////////////////////
+    // Summation policies
+    ///////////////////////
+
+    // The 1.0 is lost when added to 1e16 in a running double, but kept
+    // by the compensated and the exact accumulators
     {
-        this->value = value;
+        ArrayElement cancelling_element({1e16, 1.0, -1e16});
+
+        BasicSumVisitor<PairwiseSummation> pairwise_sum_visitor;
+        BasicSumVisitor<CompensatedSummation> compensated_sum_visitor;
+        BasicSumVisitor<ReproducibleSummation> reproducible_sum_visitor;
+
+        cancelling_element.Accept(sum_visitor);
+        cancelling_element.Accept(pairwise_sum_visitor);
+        cancelling_element.Accept(compensated_sum_visitor);
+        cancelling_element.Accept(reproducible_sum_visitor);
+
+        std::cout << "Sum of cancelling ArrayElement (naive): " << sum_visitor.GetValue() << std::endl;
+        std::cout << "Sum of cancelling ArrayElement (pairwise): " << pairwise_sum_visitor.GetValue() << std::endl;
+        std::cout << "Sum of cancelling ArrayElement (compensated): " << compensated_sum_visitor.GetValue() << std::endl;
+        std::cout << "Sum of cancelling ArrayElement (reproducible): " << reproducible_sum_visitor.GetValue() << std::endl;
+        sum_visitor.Reset();
     }
 
-    void Accept(AbstractVisitor &visitor)
+    /////////////////////
+    // Scaled products
+    /////////////////////
+
+    // The product of 2000 factors of 1000 overflows a double, but not
+    // the separate mantissa and exponent of ScaledProduct
     {
-        visitor.ProcessSingleElement(*this);
+        ArrayElement large_element(std::vector<double>(2000, 1000.0));
+
+        BasicMultiplyVisitor<ScaledProduct> scaled_multiply_visitor;
+
+        large_element.Accept(multiply_visitor);
+        large_element.Accept(scaled_multiply_visitor);
+
+        std::cout << "Product of large ArrayElement: " << multiply_visitor.GetValue() << std::endl;
+        std::cout << "Log10 of product of large ArrayElement (scaled): "
+            << scaled_multiply_visitor.GetProduct().GetLog2() * std::log10(2.0) << std::endl;
+        multiply_visitor.Reset();
     }
 
-private:
+    //////////////////
+    // Typed arrays
+    //////////////////
 
-    double value;
-};
+    // Each array is visited in its own value type through the same
+    // AbstractElement interface. The int32_t sum is exact beyond the
+    // range of an int32_t.
+    {
+        BasicArrayElement<float> float_element({1.5f, 2.5f, 4.0f});
+        BasicArrayElement<std::int32_t> int32_element({2147483647, 2147483647, 6});
+        BasicArrayElement<std::int64_t> int64_element({1, 2, 3, 4});
 
+        XORVisitor int_xor_visitor;
 
-class ArrayElement : public AbstractElement
-{
+        for(AbstractElement *element : std::initializer_list<AbstractElement*>{&float_element, &int32_element})
+        {
+            element->Accept(sum_visitor);
+            element->Accept(multiply_visitor);
+        }
 
-public:
+        int32_element.Accept(int_xor_visitor);
+        int64_element.Accept(int_xor_visitor);
 
-    ArrayElement(std::vector<double> value)
-        : value(value)
-    {
+        std::cout << "Sum of typed ArrayElements: " << static_cast<long long>(sum_visitor.GetValue()) << std::endl;
+        std::cout << "Product of typed ArrayElements: " << multiply_visitor.GetValue() << std::endl;
+        std::cout << "XOR checksum of integer ArrayElements: " << static_cast<int>(int_xor_visitor.GetValue()) << std::endl;
+        sum_visitor.Reset();
+        multiply_visitor.Reset();
     }
 
-    virtual
-    ~ArrayElement()
-    {
-        // I do nothing
-    }
+    // Arrays of up to ArrayElement::inline_capacity values are held in
+    // the element itself, without an allocation of their own
+    std::cout << "Inline ArrayElements: "
+        << std::count_if(array_element_list.begin(), array_element_list.end(),
+            [](const ArrayElement &element) { return element.IsInline(); })
+        << " of " << array_element_list.size() << std::endl;
 
-    std::vector<double> GetValue() const
-    {
-        return value;
-    }
+    //////////////////////////////
+    // Process ArrayElement list
+    //////////////////////////////
 
-    void SetValue(const std::vector<double> value)
-    {
-        this->value = value;
-    }
+    std::for_each(array_element_list.begin(), array_element_list.end(), /*adapter*/
+        [&sum_visitor](AbstractElement &element)
+        {
+            element.Accept(sum_visitor);
+        }
+    );
 
-    void Accept(AbstractVisitor &visitor)
-    {
-        visitor.ProcessArrayElement(*this);
-    }
+    std::for_each(array_element_list.begin(), array_element_list.end(), /*adapter*/
+        [&multiply_visitor](AbstractElement &element)
+        {
+            element.Accept(multiply_visitor);
+        }
+    );
 
-private:
+    std::for_each(array_element_list.begin(), array_element_list.end(), /*adapter*/
+        [&xor_visitor](AbstractElement &element)
+        {
+            element.Accept(xor_visitor);
+        }
+    );
+
+    // Print result
+    std::cout << "Sum of ArrayElement list: " << sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of ArrayElement list: " << multiply_visitor.GetValue() << std::endl;
+    std::cout << "Checksum of ArrayElement list: " << static_cast<int>(xor_visitor.GetValue())  << std::endl;
+    std::cout << "Unsupported by XOR Visitor: " << xor_visitor.GetUnsupportedCount() << std::endl;
+    sum_visitor.Reset();
+    multiply_visitor.Reset();
+    xor_visitor.Reset();
 
-    std::vector<double> value;
+    //////////////////////////
+    // Process StringElement
+    //////////////////////////
 
-};
+    string_element.Accept(sum_visitor);
 
+    string_element.Accept(multiply_visitor);
 
-class StringElement : public AbstractElement
-{
+    string_element.Accept(xor_visitor);
 
-public:
+    // Print result
+    std::cout << "Sum of StringElement: " << sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of StringElement: " << multiply_visitor.GetValue() << std::endl;
+    std::cout << "Checksum of StringElement: " << static_cast<int>(xor_visitor.GetValue()) << std::endl;
+    sum_visitor.Reset();
+    multiply_visitor.Reset();
+    xor_visitor.Reset();
 
-    StringElement(std::string value)
-        : value(value)
+    // The same string fed in pieces, as it might arrive from the
+    // network. Each chunk is processed as it arrives.
     {
-    }
+        StringStream sum_stream(sum_visitor);
+        StringStream multiply_stream(multiply_visitor);
+        StringStream xor_stream(xor_visitor);
 
-    virtual
-    ~StringElement()
-    {
-        // I do nothing
-    }
+        std::string_view text = string_element.GetView();
 
-    std::string GetValue() const
-    {
-        return value;
-    }
+        for(std::size_t begin = 0; begin < text.size(); begin += 5)
+        {
+            std::string_view chunk = text.substr(begin, 5);
 
-    void SetValue(const std::string value)
-    {
-        this->value = value;
-    }
+            sum_stream.Write(chunk);
+            multiply_stream.Write(chunk);
+            xor_stream.Write(chunk);
+        }
 
-    void Accept(AbstractVisitor &visitor)
-    {
-        visitor.ProcessStringElement(*this);
+        sum_stream.Finish();
+        multiply_stream.Finish();
+        xor_stream.Finish();
     }
 
-private:
+    std::cout << "Sum of StringElement (chunked): " << sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of StringElement (chunked): " << multiply_visitor.GetValue() << std::endl;
+    std::cout << "Checksum of StringElement (chunked): " << static_cast<int>(xor_visitor.GetValue()) << std::endl;
+    sum_visitor.Reset();
+    multiply_visitor.Reset();
+    xor_visitor.Reset();
 
-    std::string value;
+    ////////////////////////////////////////////////////////
+    // Process a mixed Element list with the static engine
+    ////////////////////////////////////////////////////////
 
-};
+    // The same elements as above, held by value in std::variant.
+    // There are no virtual calls here; std::visit dispatches on the
+    // variant index and selects the matching operator() overload.
+    std::vector<Element> element_list;
 
+    element_list.insert(element_list.end(), single_element_list.cbegin(), single_element_list.cend());
+    element_list.insert(element_list.end(), array_element_list.cbegin(), array_element_list.cend());
+    element_list.push_back(string_element);
 
-//////////////////////////////////////////////////////////
-// Visitor classes which define the logic for operations
-//////////////////////////////////////////////////////////
+    StaticSumVisitor static_sum_visitor;
+    StaticMultiplyVisitor static_multiply_visitor;
 
+    VisitAll(element_list, static_sum_visitor);
+    VisitAll(element_list, static_multiply_visitor);
 
-class SumVisitor : public AbstractVisitor
-{
+    std::cout << "Sum of Element list: " << static_sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of Element list: " << static_multiply_visitor.GetValue() << std::endl;
+
+    ///////////////////////////////////////////
+    // Process a mixed batch in ElementContainer
+    ///////////////////////////////////////////
 
-public:
+    // The container keeps one contiguous buffer per element type and
+    // visits them type-by-type, so it works with either engine
+    ElementContainer element_container;
 
-    SumVisitor()
-        : value{0.0}
+    for(const SingleElement &element : single_element_list)
     {
+        element_container.Add(element);
     }
 
-    ~SumVisitor()
+    for(const ArrayElement &element : array_element_list)
     {
-        // I do nothing
+        element_container.Add(element);
     }
 
-    void ProcessSingleElement(const SingleElement& element)
-    {
-        int v = element.GetValue();
+    element_container.Add(string_element);
 
-        value += v;
-    }
+    element_container.Accept(sum_visitor);
+    element_container.Accept(multiply_visitor);
 
-    void ProcessArrayElement(const ArrayElement& element)
-    {
-        std::vector<double> v = element.GetValue();
+    std::cout << "Sum of ElementContainer: " << sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of ElementContainer: " << multiply_visitor.GetValue() << std::endl;
+    sum_visitor.Reset();
+    multiply_visitor.Reset();
 
-        double sum = std::accumulate(v.cbegin(), v.cend(), 0.0);
+    static_sum_visitor.Reset();
+    element_container.Visit(static_sum_visitor);
 
-        value += sum;
-    }
+    std::cout << "Sum of ElementContainer (static): " << static_sum_visitor.GetValue() << std::endl;
 
-    void ProcessStringElement(const StringElement& element)
+    // Element types the visitor does not support are skipped, and the
+    // result reports how many elements were visited
+    VisitResult xor_result = element_container.Accept(xor_visitor);
+
+    std::cout << "Checksum of ElementContainer: " << static_cast<int>(xor_visitor.GetValue())
+        << " (" << ToString(xor_result.status) << ", visited " << xor_result.visited
+        << ", skipped " << xor_result.skipped << ")" << std::endl;
+    xor_visitor.Reset();
+
+    // The same batch built in an arena: the buffers and payloads are
+    // all allocated from the monotonic resource, and released together
+    // when it goes out of scope
     {
-        std::string v = element.GetValue();
+        std::pmr::monotonic_buffer_resource arena;
+        ElementContainer arena_container(&arena);
 
-        auto lambda = [](double sum, unsigned char ch)
+        for(double value : initial_values)
         {
-            if(std::isdigit(ch))
-            {
-                sum += static_cast<double>(ch - '0');
-                return sum;
-            }
-            return sum;
-        };
+            arena_container.Emplace<SingleElement>(value);
+        }
 
-        double sum = std::accumulate(v.begin(), v.end(), 0.0, lambda);
+        for(const ArrayElement &element : array_element_list)
+        {
+            arena_container.Emplace<ArrayElement>(element.GetView());
+        }
 
-        value += sum;
-    }
+        arena_container.Emplace<StringElement>(string_element.GetView());
 
-    double GetValue() const
-    {
-        return value;
+        arena_container.Accept(sum_visitor);
+
+        std::cout << "Sum of ElementContainer (arena): " << sum_visitor.GetValue() << std::endl;
+        sum_visitor.Reset();
     }
 
-    void Reset()
+    //////////////////////////////
+    // Process an ArrayElementPool
+    //////////////////////////////
+
+    // The payloads of all arrays live in a single buffer, and the
+    // sum and product visitors reduce the whole pool in one pass
+    ArrayElementPool array_element_pool;
+
+    for(const ArrayElement &element : array_element_list)
     {
-        value = 0.0;
+        array_element_pool.Add(element.GetView());
     }
 
-private:
+    array_element_pool.Accept(sum_visitor);
+    array_element_pool.Accept(multiply_visitor);
 
-    double value;
+    std::cout << "Sum of ArrayElementPool: " << sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of ArrayElementPool: " << multiply_visitor.GetValue() << std::endl;
+    sum_visitor.Reset();
+    multiply_visitor.Reset();
 
-};
+    ///////////////////////////////////////////
+    // Fused traversal with several visitors
+    ///////////////////////////////////////////
 
+    // One pass over the collection computes both results, and the
+    // payload of each array is loaded only once for both reductions
+    FusedVisitor fused_visitor(sum_visitor, multiply_visitor);
 
-class MultiplyVisitor : public AbstractVisitor
-{
+    element_container.Accept(fused_visitor);
 
-public:
+    std::cout << "Sum of ElementContainer (fused): " << sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of ElementContainer (fused): " << multiply_visitor.GetValue() << std::endl;
+    sum_visitor.Reset();
+    multiply_visitor.Reset();
 
-    MultiplyVisitor()
-        : value(1.0)
-    {
-    }
+    FusedVisitor string_fused_visitor(sum_visitor, multiply_visitor, xor_visitor);
 
-    ~MultiplyVisitor()
-    {
-        // I do nothing
-    }
+    string_element.Accept(string_fused_visitor);
+
+    std::cout << "Sum of StringElement (fused): " << sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of StringElement (fused): " << multiply_visitor.GetValue() << std::endl;
+    std::cout << "Checksum of StringElement (fused): " << static_cast<int>(xor_visitor.GetValue()) << std::endl;
+    sum_visitor.Reset();
+    multiply_visitor.Reset();
+    xor_visitor.Reset();
 
-    void ProcessSingleElement(const SingleElement& element)
+    // Wider checksums and a 64-bit hash, in the same pass as the digit
+    // sum
     {
-        int v = element.GetValue();
+        XorFold64Visitor xor_fold_visitor;
+        Crc32cVisitor crc_visitor;
+        Xxh64Visitor xxh_visitor;
 
-        value *= v;
-    }
+        FusedVisitor checksum_fused_visitor(sum_visitor, xor_fold_visitor, crc_visitor, xxh_visitor);
 
-    void ProcessArrayElement(const ArrayElement& element)
-    {
-        std::vector<double> v = element.GetValue();
+        string_element.Accept(checksum_fused_visitor);
 
-        auto lambda = [](double product, double value)
-        {
-            return product * value;
-        };
+        std::cout << std::hex;
+        std::cout << "XOR fold of StringElement (fused): " << xor_fold_visitor.GetValue() << std::endl;
+        std::cout << "CRC32C of StringElement (fused): " << crc_visitor.GetValue() << std::endl;
+        std::cout << "XXH64 of StringElement (fused): " << xxh_visitor.GetValue() << std::endl;
+        std::cout << std::dec;
+        sum_visitor.Reset();
+
+        // The digest of each string, to find duplicates, which cancel out
+        // in GetValue
+        xxh_visitor.Reset();
+        xxh_visitor.RecordDigests();
 
-        double product = std::accumulate(v.cbegin(), v.cend(), 1.0, lambda);
+        element_container.Accept(xxh_visitor);
 
-        value *= product;
+        std::cout << "XXH64 digests of ElementContainer: " << xxh_visitor.GetDigests().size() << std::endl;
     }
 
-    void ProcessStringElement(const StringElement& element)
-    {
-        std::string v = element.GetValue();
+    ///////////////////////////////////////////
+    // Memoized results over a changing container
+    ///////////////////////////////////////////
 
-        auto lambda_multiply = [](double product, unsigned char ch)
-        {
-            if(std::isdigit(ch))
-            {
-                product *= static_cast<double>(ch - '0');
-                return product;
-            }
-            return product;
-        };
+    // Only the elements changed since the previous Update are visited
+    // again
+    CachedAccept<SumVisitor> cached_sum;
 
-        double product = std::accumulate(v.begin(), v.end(), 1.0, lambda_multiply);
+    cached_sum.Update(element_container);
 
-        value *= product;
-    }
+    std::cout << "Sum of ElementContainer (cached): " << cached_sum.GetResult().GetValue()
+        << " (" << cached_sum.GetRecomputedCount() << " visited)" << std::endl;
 
-    double GetValue() const
-    {
-        return value;
-    }
+    element_container.GetArrayElements()[0].SetValue(std::vector<double>{10.0});
+    cached_sum.Update(element_container);
 
-    void Reset()
+    std::cout << "Sum of ElementContainer (cached, updated): " << cached_sum.GetResult().GetValue()
+        << " (" << cached_sum.GetRecomputedCount() << " visited)" << std::endl;
+
+    element_container.GetArrayElements()[0].SetValue(std::vector<double>{1.0});
+    cached_sum.Update(element_container);
+
+    // A live aggregate follows the changes of the container as they are
+    // made, and is read without any traversal
     {
-        value = 1.0;
+        LiveSum live_sum(element_container);
+        LiveProduct live_product(element_container);
+
+        element_container.GetSingleElements()[0].SetValue(0.0);
+
+        std::cout << "Sum of ElementContainer (live): " << live_sum.GetValue() << std::endl;
+        std::cout << "Product of ElementContainer (live): " << live_product.GetValue() << std::endl;
+
+        element_container.GetSingleElements()[0].SetValue(1.0);
+
+        std::cout << "Product of ElementContainer (live, restored): " << live_product.GetValue() << std::endl;
     }
 
-private:
+    //////////////////////////////////////
+    // Parallel traversal on a thread pool
+    //////////////////////////////////////
 
-    double value;
-};
+    // Each worker visits part of the container with its own clone of
+    // the visitor, and the partial results are merged at the end
+    ThreadPool thread_pool;
 
+    ParallelAccept(element_container, sum_visitor, thread_pool);
+    ParallelAccept(element_container, multiply_visitor, thread_pool);
 
-class XORVisitor : public AbstractVisitor
-{
+    std::cout << "Sum of ElementContainer (parallel): " << sum_visitor.GetValue() << std::endl;
+    std::cout << "Product of ElementContainer (parallel): " << multiply_visitor.GetValue() << std::endl;
+    sum_visitor.Reset();
+    multiply_visitor.Reset();
 
-public:
+    // The work-stealing scheduler balances by payload bytes, splitting
+    // large arrays and strings into ranges, and merges the partial
+    // results in a fixed order
+    WorkStealingScheduler work_stealing_scheduler;
 
-    XORVisitor()
-        : value{0}
-    {
-    }
+    WorkStealingAccept(element_container, sum_visitor, work_stealing_scheduler);
 
-    ~XORVisitor()
-    {
-        // I do nothing
-    }
+    std::cout << "Sum of ElementContainer (work-stealing): " << sum_visitor.GetValue() << std::endl;
+    sum_visitor.Reset();
 
-    void ProcessSingleElement(const SingleElement& element)
-    {
-        throw std::runtime_error("Error: Cannot apply XOR operation to SingleElement type");
-    }
+    ////////////////////////////////////////////
+    // Coroutine pipeline over arriving batches
+    ////////////////////////////////////////////
 
-    void ProcessArrayElement(const ArrayElement& element)
+    // The source stands in for a socket: each call decodes the next
+    // batch on the pool while the earlier batches are being visited
     {
-        throw std::runtime_error("Error: Cannot apply XOR operation to ArrayElement type");
-    }
+        CoroutineScheduler scheduler;
 
-    void ProcessStringElement(const StringElement& element)
-    {
-        std::string v = element.GetValue();
+        std::size_t batches_left = 3;
 
-        auto lambda_xor = [](unsigned char checksum, unsigned char ch)
+        auto source = [&element_container, &batches_left]() -> std::optional<ElementContainer>
         {
-            return checksum ^ ch;
+            if(batches_left == 0)
+            {
+                return std::nullopt;
+            }
+
+            -- batches_left;
+
+            return ElementContainer(element_container);
         };
 
-        unsigned char checksum = std::accumulate(v.begin(), v.end(), 0, lambda_xor);
+        Channel<ElementBatch> sum_batches(scheduler, 2);
+        Channel<ElementBatch> product_batches(scheduler, 2);
+        Channel<ElementBatch> xor_batches(scheduler, 2);
 
-        value ^= checksum;
-    }
+        Channel<BatchResult<SumVisitor>> sum_results(scheduler, 2);
+        Channel<BatchResult<MultiplyVisitor>> product_results(scheduler, 2);
+        Channel<BatchResult<XORVisitor>> xor_results(scheduler, 2);
 
-    unsigned char GetValue() const
-    {
-        return value;
+        scheduler.Spawn(ReadBatches(scheduler, thread_pool, source, {&sum_batches, &product_batches, &xor_batches}));
+
+        scheduler.Spawn(VisitBatches(scheduler, thread_pool, sum_batches, sum_visitor, sum_results));
+        scheduler.Spawn(VisitBatches(scheduler, thread_pool, product_batches, multiply_visitor, product_results));
+        scheduler.Spawn(VisitBatches(scheduler, thread_pool, xor_batches, xor_visitor, xor_results));
+
+        scheduler.Spawn(MergeBatchResults(sum_results, sum_visitor));
+        scheduler.Spawn(MergeBatchResults(product_results, multiply_visitor));
+        scheduler.Spawn(MergeBatchResults(xor_results, xor_visitor));
+
+        scheduler.Run();
+
+        std::cout << "Sum of 3 pipelined batches: " << sum_visitor.GetValue() << std::endl;
+        std::cout << "Product of 3 pipelined batches: " << multiply_visitor.GetValue() << std::endl;
+        std::cout << "XOR of 3 pipelined batches: " << static_cast<int>(xor_visitor.GetValue()) << std::endl;
+        sum_visitor.Reset();
+        multiply_visitor.Reset();
+        xor_visitor.Reset();
     }
 
-    void Reset()
+    ////////////////////////////////////////////
+    // Type list visitors
+    ////////////////////////////////////////////
+
+    // The dispatch tables and the supported flags are generated from
+    // the list of element types, here including float arrays
     {
-        value = 0;
-    }
+        using SequenceElements = TypeList<SingleElement, ArrayElement, StringElement, BasicArrayElement<float>>;
 
-private:
+        ElementSequence<SequenceElements> element_sequence;
 
-    unsigned char value;
-};
+        element_sequence.Add(SingleElement(2.0));
+        element_sequence.Add(StringElement("123"));
+        element_sequence.Add(BasicArrayElement<float>({0.5f, 1.5f}));
+        element_sequence.Add(ArrayElement({1.0, 2.0, 3.0}));
 
+        ClassicVisitorAdapter<SumVisitor, SequenceElements> sum_adapter(sum_visitor);
+        ClassicVisitorAdapter<XORVisitor, SequenceElements> xor_adapter(xor_visitor);
 
-int main(int argc, char *argv[])
-{
+        static_assert(!decltype(xor_adapter)::supports<SingleElement>, "XORVisitor only visits strings");
 
-    // Initialize some stuff
+        element_sequence.Accept(sum_adapter);
+        const VisitResult xor_result = element_sequence.Accept(xor_adapter);
 
-    std::vector<double> initial_values{1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0};
+        std::cout << "Sum of ElementSequence: " << sum_visitor.GetValue() << std::endl;
+        std::cout << "XOR of ElementSequence: " << static_cast<int>(xor_visitor.GetValue())
+            << " (" << xor_result.skipped << " unsupported elements skipped)" << std::endl;
+        sum_visitor.Reset();
 
-    std::list<SingleElement> single_element_list;
+        // A single element can also be processed through the adapter itself
+        sum_adapter.Process(SingleElement(2.0));
+        std::cout << "Sum of a single element through the adapter: " << sum_visitor.GetValue() << std::endl;
+        sum_visitor.Reset();
+        xor_visitor.Reset();
+    }
 
-    std::transform(initial_values.cbegin(), initial_values.cend(),
-        std::back_inserter(single_element_list), [](auto v){return SingleElement(v);});
+    ////////////////////////////////////////////
+    // Digit index of strings visited repeatedly
+    ////////////////////////////////////////////
 
-    // This could be done in a similar way using transform,
-    // as above
-    std::list<ArrayElement> array_element_list
+    // The string is scanned once, on the first visit; the other visits
+    // read the index
     {
-        ArrayElement({1.0}),
-        ArrayElement({2.0, 3.0}),
-        ArrayElement({4.0, 5.0, 6.0}),
-        ArrayElement({7.0, 8.0, 9.0})
-    };
-    
-    StringElement string_element("Hello World 123456789\2");
+        StringElement indexed_string(std::string(1000, '1') + "23");
+        indexed_string.EnableDigitIndex();
 
-    SumVisitor sum_visitor;
-    MultiplyVisitor multiply_visitor;
-    XORVisitor xor_visitor;
+        for(int visit = 0; visit < 3; ++ visit)
+        {
+            indexed_string.Accept(sum_visitor);
+            indexed_string.Accept(multiply_visitor);
+            indexed_string.Accept(xor_visitor);
+        }
 
-    ///////////////////////////////
-    // Process SingleElement list
-    ///////////////////////////////
+        std::cout << "Sum of indexed string visited 3 times: " << sum_visitor.GetValue() << std::endl;
+        std::cout << "Product of indexed string visited 3 times: " << multiply_visitor.GetValue() << std::endl;
+        std::cout << "XOR of indexed string visited 3 times: " << static_cast<int>(xor_visitor.GetValue()) << std::endl;
+        std::cout << "Digits in indexed string: " << indexed_string.GetDigitIndex()->digit_count << std::endl;
+        sum_visitor.Reset();
+        multiply_visitor.Reset();
+        xor_visitor.Reset();
+    }
 
-    // Adapter class (functor)
-    class ForEachAdapter
+    ////////////////////////////////////////////
+    // Sharded visitation with shipped states
+    ////////////////////////////////////////////
+
+    // Each shard is visited on its own, as it would be on its own node,
+    // and only the visitors' states travel to the aggregator. The
+    // reports arrive out of order and are merged in shard order.
     {
-    public:
+        const std::size_t shard_count = 3;
 
-        // The polymorhpism is retained in the member
-        // variable reference-to-visitor
-        ForEachAdapter(AbstractVisitor& visitor_type)
-            : visitor_type(visitor_type)
-        {
-        }
+        std::vector<std::vector<std::byte>> sum_reports;
+        std::vector<std::vector<std::byte>> xor_reports;
 
-        // The purpose of this class is simply to convert
-        // the function call operator into a call to
-        // element.Accept()
-        void operator() (AbstractElement &element)
+        for(std::size_t shard = 0; shard < shard_count; ++ shard)
         {
-            element.Accept(visitor_type);
-        }
+            ElementContainer shard_container;
 
-    private:
+            shard_container.Add(SingleElement(static_cast<double>(shard + 1)));
+            shard_container.Add(ArrayElement({0.5, 0.25}));
+            shard_container.Add(StringElement(std::to_string(10 * shard + 7)));
 
-        AbstractVisitor &visitor_type;
+            ShardDriver<SumVisitor> sum_driver(sum_visitor, shard, shard_count);
+            ShardDriver<XORVisitor> xor_driver(xor_visitor, shard, shard_count);
 
-    };
+            sum_driver.Run(shard_container);
+            xor_driver.Run(shard_container);
 
-    // Each block of code which uses the Visitor classes is enclosed
-    // in a try-catch block. An exception is only thrown when the XOR
-    // Visitor is applied to the SingleElement or ArrayElement types.
+            sum_driver.Ship([&sum_reports](std::span<const std::byte> report) { sum_reports.emplace_back(report.begin(), report.end()); });
+            xor_driver.Ship([&xor_reports](std::span<const std::byte> report) { xor_reports.emplace_back(report.begin(), report.end()); });
+        }
 
-    try
-    {
-        // This can also be done using a standard
-        // range-based for-auto loop
-        //
-        //for(auto element : single_element_list)
-        //{
-        //    element.Accept(sum_visitor);
-        //}
-
-        // Here we use the adapter class with for_each, however
-        // this can also be done using a lambda function.
-        // See below for an example of how to do that
-        ForEachAdapter adapter(sum_visitor);
-        std::for_each(single_element_list.begin(), single_element_list.end(), adapter);
-    }
-    catch(const std::runtime_error &e)
-    {
-        std::cout << e.what() << std::endl;
-    }
+        ShardAggregator<SumVisitor> sum_aggregator(sum_visitor, shard_count);
+        ShardAggregator<XORVisitor> xor_aggregator(xor_visitor, shard_count);
 
-    try
-    {
-        // This version uses for_each in combination with a lambda
-        // The lambda accomplishes the same thing as the functor,
-        // however the functor is probably easier to understand
-        // for those not familiar with lambdas.
-        std::for_each(single_element_list.begin(), single_element_list.end(),
-            [&multiply_visitor](AbstractElement &element)
-            {
-                element.Accept(multiply_visitor);
-            }
-        );
-    }
-    catch(const std::runtime_error &e)
-    {
-        std::cout << e.what() << std::endl;
-    }
+        for(std::size_t i = shard_count; i > 0; -- i)
+        {
+            sum_aggregator.Receive(sum_reports[i - 1]);
+            xor_aggregator.Receive(xor_reports[i - 1]);
+        }
 
-    try
-    {
-        std::for_each(single_element_list.begin(), single_element_list.end(),
-            [&xor_visitor](AbstractElement &element)
-            {
-                element.Accept(xor_visitor);
-            }
-        );
-    }
-    catch(const std::runtime_error &e)
-    {
-        std::cout << e.what() << std::endl;
+        std::cout << "Sum of " << shard_count << " shards: " << sum_aggregator.GetResult().GetValue()
+            << " (" << sum_reports[0].size() << " bytes per report)" << std::endl;
+        std::cout << "XOR of " << shard_count << " shards: " << static_cast<int>(xor_aggregator.GetResult().GetValue())
+            << " (" << xor_aggregator.GetVisitResult().skipped << " unsupported elements skipped)" << std::endl;
     }
-    
-    // Print result
-    std::cout << "Sum of SingleElement list: " << sum_visitor.GetValue() << std::endl;
-    std::cout << "Product of SingleElement list: " << multiply_visitor.GetValue() << std::endl;
-    std::cout << "Checksum of SingleElement list: " << static_cast<int>(xor_visitor.GetValue())  << std::endl;
-    sum_visitor.Reset();
-    multiply_visitor.Reset();
-    xor_visitor.Reset();
 
-    //////////////////////////////
-    // Process ArrayElement list
-    //////////////////////////////
+    ////////////////////////////////////////////
+    // Continuous ingestion by long-lived workers
+    ////////////////////////////////////////////
 
-    try
+    // Producers push from their own threads into a lock-free queue,
+    // and the workers visit the elements as they arrive
     {
-        std::for_each(array_element_list.begin(), array_element_list.end(), /*adapter*/
-            [&sum_visitor](AbstractElement &element)
-            {
-                element.Accept(sum_visitor);
-            }
-        );
-    }
-    catch(const std::runtime_error &e)
-    {
-        std::cout << e.what() << std::endl;
-    }
+        StreamingVisitorPool<SumVisitor> streaming_sum(sum_visitor, 2);
+        StreamingVisitorPool<XORVisitor> streaming_xor(xor_visitor, 1);
 
-    try
-    {
-        std::for_each(array_element_list.begin(), array_element_list.end(), /*adapter*/
-            [&multiply_visitor](AbstractElement &element)
-            {
-                element.Accept(multiply_visitor);
-            }
-        );
-    }
-    catch(const std::runtime_error &e)
-    {
-        std::cout << e.what() << std::endl;
-    }
+        std::vector<std::thread> producers;
 
-    try
-    {
-        std::for_each(array_element_list.begin(), array_element_list.end(), /*adapter*/
-            [&xor_visitor](AbstractElement &element)
-            {
-                element.Accept(xor_visitor);
-            }
-        );
-    }
-    catch(const std::runtime_error &e)
-    {
-        std::cout << e.what() << std::endl;
-    }
+        for(int producer = 0; producer < 2; ++ producer)
+        {
+            producers.emplace_back(
+                [&streaming_sum, &streaming_xor, producer]()
+                {
+                    for(int i = 1000 * producer + 1; i <= 1000 * (producer + 1); ++ i)
+                    {
+                        streaming_sum.Push(SingleElement(static_cast<double>(i)));
+                        streaming_xor.Push(StringElement(std::to_string(i)));
+                    }
+                });
+        }
 
-    // Print result
-    std::cout << "Sum of ArrayElement list: " << sum_visitor.GetValue() << std::endl;
-    std::cout << "Product of ArrayElement list: " << multiply_visitor.GetValue() << std::endl;
-    std::cout << "Checksum of ArrayElement list: " << static_cast<int>(xor_visitor.GetValue())  << std::endl;
-    sum_visitor.Reset();
-    multiply_visitor.Reset();
-    xor_visitor.Reset();
+        for(std::thread &producer : producers)
+        {
+            producer.join();
+        }
 
-    //////////////////////////
-    // Process StringElement
-    //////////////////////////
+        streaming_sum.Drain();
+        streaming_xor.Drain();
 
-    try
-    {
-        string_element.Accept(sum_visitor);
-    }
-    catch(const std::runtime_error &e)
-    {
-        std::cout << e.what() << std::endl;
+        std::cout << "Sum of streamed elements: " << streaming_sum.Snapshot().GetValue() << std::endl;
+        std::cout << "XOR of streamed strings: " << static_cast<int>(streaming_xor.Snapshot().GetValue()) << std::endl;
     }
 
-    try
-    {
-        string_element.Accept(multiply_visitor);
-    }
-    catch(const std::runtime_error &e)
-    {
-        std::cout << e.what() << std::endl;
-    }
+    ////////////////////////////////////////////
+    // Stream a memory-mapped binary element file
+    ////////////////////////////////////////////
+
+    // The visitors are given views into the mapping, no elements are
+    // built when the file is read back
+    const std::filesystem::path element_file_path =
+        std::filesystem::temp_directory_path() / "visitor_pattern_elements.bin";
+
+    ElementFileWriter element_file_writer(element_file_path.string());
+    element_file_writer.Write(element_container);
+    element_file_writer.Close();
 
-    try
-    {
-        string_element.Accept(xor_visitor);
-    }
-    catch(const std::runtime_error &e)
     {
-        std::cout << e.what() << std::endl;
+        MappedElementFile mapped_element_file(element_file_path.string());
+
+        mapped_element_file.Accept(sum_visitor);
+        mapped_element_file.Accept(multiply_visitor);
+
+        std::cout << "Sum of element file: " << sum_visitor.GetValue() << std::endl;
+        std::cout << "Product of element file: " << multiply_visitor.GetValue() << std::endl;
+        sum_visitor.Reset();
+        multiply_visitor.Reset();
     }
 
-    // Print result
-    std::cout << "Sum of StringElement: " << sum_visitor.GetValue() << std::endl;
-    std::cout << "Product of StringElement: " << multiply_visitor.GetValue() << std::endl;
-    std::cout << "Checksum of StringElement: " << static_cast<int>(xor_visitor.GetValue()) << std::endl;
-    sum_visitor.Reset();
-    multiply_visitor.Reset();
-    xor_visitor.Reset();
+    std::filesystem::remove(element_file_path);
+
+    ////////////////////////////////////////////
+    // Traversal instrumentation
+    ////////////////////////////////////////////
 
+    // Only recorded when built with VISITOR_INSTRUMENTATION
+    if constexpr(instrumentation::enabled)
+    {
+        instrumentation::VisitMetrics::Global().WritePrometheus(std::cout);
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,232 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+//////////////////////////////////////////////////////////////////////
+// Bounded lock-free multi-producer multi-consumer queue
+//
+// A ring of cells, each holding a value and a sequence number, after
+// Dmitry Vyukov's bounded MPMC queue. A producer claims the next cell
+// by advancing the enqueue position with a compare-and-swap, writes
+// the value and then publishes it by setting the cell's sequence; a
+// consumer does the same on the dequeue position. Producers and
+// consumers only contend on their own position, and a full or empty
+// queue is detected from the sequence of a single cell, so pushing and
+// popping never block and never allocate.
+//
+// The capacity is rounded up to a power of two. Values are moved in
+// and out, and the values left in the queue are destroyed with it.
+//////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+
+// Padding keeping the producer and consumer positions on different
+// cache lines (a fixed 64 bytes, since the standard
+// hardware_destructive_interference_size is not stable across
+// compiler flags)
+inline constexpr std::size_t cache_line_size = 64;
+
+} // namespace detail
+
+
+template<typename T>
+class MpmcQueue
+{
+
+    static_assert(std::is_nothrow_move_constructible_v<T>, "MpmcQueue moves values in and out without a way to fail");
+
+public:
+
+    using value_type = T;
+
+    explicit MpmcQueue(std::size_t capacity)
+    {
+        if(capacity < 2)
+        {
+            capacity = 2;
+        }
+
+        if(capacity > (std::size_t(1) << (8 * sizeof(std::size_t) - 2)))
+        {
+            throw std::length_error("Error: MpmcQueue capacity is too large");
+        }
+
+        mask = std::bit_ceil(capacity) - 1;
+        cells = std::make_unique<Cell[]>(mask + 1);
+
+        for(std::size_t i = 0; i <= mask; ++ i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        enqueue_position.store(0, std::memory_order_relaxed);
+        dequeue_position.store(0, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    ~MpmcQueue()
+    {
+        if constexpr(!std::is_trivially_destructible_v<T>)
+        {
+            const std::size_t end = enqueue_position.load(std::memory_order_relaxed);
+
+            for(std::size_t position = dequeue_position.load(std::memory_order_relaxed); position != end; ++ position)
+            {
+                std::launder(reinterpret_cast<T*>(cells[position & mask].storage))->~T();
+            }
+        }
+    }
+
+    std::size_t Capacity() const
+    {
+        return mask + 1;
+    }
+
+    // Move value into the queue, unless it is full. value is left
+    // untouched when false is returned.
+    bool TryPush(T &value)
+    {
+        Cell *cell;
+        std::size_t position = enqueue_position.load(std::memory_order_relaxed);
+
+        for(;;)
+        {
+            cell = &cells[position & mask];
+
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence - position);
+
+            if(difference == 0)
+            {
+                if(enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if(difference < 0)
+            {
+                // The cell still holds the value pushed one lap ago
+                return false;
+            }
+            else
+            {
+                position = enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        ::new(static_cast<void*>(cell->storage)) T(std::move(value));
+        cell->sequence.store(position + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool TryPush(T &&value)
+    {
+        return TryPush(value);
+    }
+
+    // Move the oldest value out of the queue into value, unless it is
+    // empty
+    bool TryPop(T &value)
+    {
+        return TryConsume([&value](T &stored) { value = std::move(stored); });
+    }
+
+    // Call function with the oldest value, in place in its cell, and
+    // then remove it, unless the queue is empty. This saves moving the
+    // value out, and works for values which are not default
+    // constructible. function must not throw.
+    template<typename Function>
+    bool TryConsume(Function &&function)
+    {
+        Cell *cell;
+        std::size_t position = dequeue_position.load(std::memory_order_relaxed);
+
+        for(;;)
+        {
+            cell = &cells[position & mask];
+
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+
+            if(difference == 0)
+            {
+                if(dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if(difference < 0)
+            {
+                // The cell has not been pushed to on this lap
+                return false;
+            }
+            else
+            {
+                position = dequeue_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        T *stored = std::launder(reinterpret_cast<T*>(cell->storage));
+
+        function(*stored);
+        stored->~T();
+
+        // Free the cell for the push one lap ahead
+        cell->sequence.store(position + mask + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Approximate number of values queued, exact only while no other
+    // thread is pushing or popping
+    std::size_t SizeApprox() const
+    {
+        const std::size_t pushed = enqueue_position.load(std::memory_order_relaxed);
+        const std::size_t popped = dequeue_position.load(std::memory_order_relaxed);
+
+        return pushed > popped ? pushed - popped : 0;
+    }
+
+    // Number of cells claimed so far by producers and by consumers.
+    // Both only grow, so once the dequeue position reaches an enqueue
+    // position read earlier, every value pushed before that read has
+    // been taken by a consumer.
+    std::size_t EnqueuePosition() const
+    {
+        return enqueue_position.load(std::memory_order_acquire);
+    }
+
+    std::size_t DequeuePosition() const
+    {
+        return dequeue_position.load(std::memory_order_acquire);
+    }
+
+private:
+
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+
+    alignas(detail::cache_line_size) std::atomic<std::size_t> enqueue_position;
+    alignas(detail::cache_line_size) std::atomic<std::size_t> dequeue_position;
+
+};
+
+#endif // MPMC_QUEUE_H
@@ -0,0 +1,197 @@
+#ifndef MULTIPLICATION_H
+#define MULTIPLICATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "kernels.h"
+#include "visitor_state.h"
+
+//////////////////////////////////////////////////////////////////////
+// Product policies
+//
+// As the summation policies do for BasicSumVisitor, a product policy
+// is the accumulator a BasicMultiplyVisitor multiplies its factors
+// into:
+//
+//     BasicMultiplyVisitor<ScaledProduct> multiply_visitor;
+//
+// Every policy is default constructible to one and provides
+//
+//     void Multiply(double factor)
+//     void Multiply(std::span<const double> factors, ReductionMode mode)
+//     void MultiplyDigits(std::string_view text)
+//     void Merge(const Policy &other)
+//     double GetValue() const
+//
+// MultiplyDigits continues the running product with the decimal digits
+// of text, so a string can be given a piece at a time. SaveState and
+// LoadState encode the product, see visitor_state.h.
+//
+// - NaiveProduct keeps one running double, which overflows to infinity
+//   or underflows to zero once the product leaves the range of a
+//   double. This is the policy of MultiplyVisitor.
+// - ScaledProduct keeps the mantissa and the power of two exponent of
+//   the product apart, so the product of any number of factors can be
+//   read as its logarithm, or as a mantissa and exponent. Only powers
+//   of two are moved between the two, which is exact, so the value is
+//   the same as with NaiveProduct wherever that stays in range.
+//////////////////////////////////////////////////////////////////////
+
+class NaiveProduct
+{
+
+public:
+
+    void Multiply(double factor)
+    {
+        product *= factor;
+    }
+
+    void Multiply(std::span<const double> factors, ReductionMode mode)
+    {
+        product *= kernels::Product(factors, mode);
+    }
+
+    void MultiplyDigits(std::string_view text)
+    {
+        product = kernels::DigitProduct(text, product);
+    }
+
+    void Merge(const NaiveProduct& other)
+    {
+        product *= other.product;
+    }
+
+    static constexpr std::uint32_t state_tag = 1;
+
+    void SaveState(StateWriter &writer) const
+    {
+        writer.WriteDouble(product);
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        product = reader.ReadDouble();
+    }
+
+    double GetValue() const
+    {
+        return product;
+    }
+
+private:
+
+    double product = 1.0;
+
+};
+
+
+class ScaledProduct
+{
+
+public:
+
+    void Multiply(double factor)
+    {
+        const kernels::ScaledDouble parts = kernels::Decompose(factor);
+
+        product.mantissa *= parts.mantissa;
+        product.exponent += parts.exponent;
+
+        kernels::Normalize(product);
+    }
+
+    void Multiply(std::span<const double> factors, ReductionMode mode)
+    {
+        MultiplyScaled(kernels::ScaledProduct(factors, mode));
+    }
+
+    // The digits are multiplied into the mantissa by the digit product
+    // kernel, in pieces small enough that the mantissa cannot overflow
+    // before it is normalized again
+    void MultiplyDigits(std::string_view text)
+    {
+        for(std::size_t first = 0; first < text.size(); first += digits_per_piece)
+        {
+            product.mantissa = kernels::DigitProduct(text.substr(first, digits_per_piece), product.mantissa);
+
+            kernels::Normalize(product);
+        }
+    }
+
+    void Merge(const ScaledProduct& other)
+    {
+        MultiplyScaled(other.product);
+    }
+
+    static constexpr std::uint32_t state_tag = 2;
+
+    void SaveState(StateWriter &writer) const
+    {
+        writer.WriteDouble(product.mantissa);
+        writer.WriteSignedVarint(product.exponent);
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        product.mantissa = reader.ReadDouble();
+        product.exponent = reader.ReadSignedVarint();
+    }
+
+    // The product as a double, which is infinite or zero when it is
+    // out of range
+    double GetValue() const
+    {
+        const std::int64_t limit = 4096;
+        const std::int64_t exponent = std::clamp(product.exponent, -limit, limit);
+
+        return std::ldexp(product.mantissa, static_cast<int>(exponent));
+    }
+
+    // The product is GetMantissa() * 2^GetExponent(), with the mantissa
+    // in [1, 2) up to its sign, or zero, infinite or NaN
+    double GetMantissa() const
+    {
+        return product.mantissa;
+    }
+
+    std::int64_t GetExponent() const
+    {
+        return product.exponent;
+    }
+
+    // Base 2 logarithm of the magnitude of the product, minus infinity
+    // for a zero product
+    double GetLog2() const
+    {
+        return std::log2(std::abs(product.mantissa)) + static_cast<double>(product.exponent);
+    }
+
+    bool IsNegative() const
+    {
+        return std::signbit(product.mantissa);
+    }
+
+private:
+
+    // 9^256 is below 2^812
+    static constexpr std::size_t digits_per_piece = 256;
+
+    void MultiplyScaled(const kernels::ScaledDouble &other)
+    {
+        product.mantissa *= other.mantissa;
+        product.exponent += other.exponent;
+
+        kernels::Normalize(product);
+    }
+
+    kernels::ScaledDouble product{1.0, 0};
+
+};
+
+#endif // MULTIPLICATION_H
@@ -0,0 +1,174 @@
+#ifndef PARALLEL_VISIT_H
+#define PARALLEL_VISIT_H
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <span>
+#include <vector>
+
+#include "elements.h"
+#include "element_container.h"
+#include "instrumentation.h"
+#include "thread_pool.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Parallel visitation
+//
+// The collection is split into chunks which are visited concurrently
+// on a ThreadPool. Each chunk is visited by its own clone of the
+// visitor, made by copying the visitor and resetting the copy, and
+// the partial results are then combined into the caller's visitor
+// with Merge, in chunk order.
+//
+// A visitor can only be used here if its partial states can be
+// combined, so MergeableVisitor is checked at compile time:
+//
+// - SumVisitor merges by adding
+// - MultiplyVisitor merges by multiplying
+// - XORVisitor merges by XORing
+//
+// The merge order is fixed, so for a given number of chunks the result
+// does not depend on the scheduling of the workers. Floating point
+// results can still differ from a sequential traversal because the
+// partial sums and products are associated differently.
+//////////////////////////////////////////////////////////////////////
+
+template<typename Visitor>
+concept MergeableVisitor =
+    std::derived_from<Visitor, AbstractVisitor> &&
+    std::copy_constructible<Visitor> &&
+    requires(Visitor &visitor, const Visitor &other)
+    {
+        visitor.Merge(other);
+        visitor.Reset();
+    };
+
+
+namespace detail
+{
+
+template<typename Visitor>
+Visitor CloneVisitor(const Visitor &visitor)
+{
+    Visitor clone(visitor);
+    clone.Reset();
+
+    return clone;
+}
+
+// Submit one task per chunk of elements, each producing a partial
+// visitor. process is given the clone and the whole chunk.
+template<typename Visitor, typename Element, typename Process>
+void SubmitChunks(std::span<const Element> elements, std::size_t chunk_count,
+    const Visitor &visitor, ThreadPool &pool, Process process,
+    std::vector<std::future<Visitor>> &partials)
+{
+    if(elements.empty())
+    {
+        return;
+    }
+
+    chunk_count = std::clamp<std::size_t>(chunk_count, 1, elements.size());
+
+    const std::size_t chunk_size = (elements.size() + chunk_count - 1) / chunk_count;
+
+    for(std::size_t begin = 0; begin < elements.size(); begin += chunk_size)
+    {
+        std::span<const Element> chunk = elements.subspan(begin, std::min(chunk_size, elements.size() - begin));
+
+        partials.push_back(pool.Submit(
+            [chunk, clone = CloneVisitor(visitor), process]() mutable
+            {
+                VISIT_INSTRUMENTATION_SCOPE(clone, chunk);
+
+                process(clone, chunk);
+
+                return clone;
+            }));
+    }
+}
+
+// Wait for every partial, even after a failure, so that no task is
+// still running when the caller's collection goes out of scope
+template<typename Visitor>
+void MergePartials(Visitor &visitor, std::vector<std::future<Visitor>> &partials)
+{
+    std::exception_ptr error;
+
+    for(std::future<Visitor> &partial : partials)
+    {
+        try
+        {
+            Visitor result = partial.get();
+
+            if(!error)
+            {
+                visitor.Merge(result);
+            }
+        }
+        catch(...)
+        {
+            if(!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if(error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace detail
+
+
+// Visit every element of the container on the pool, merging the
+// result into visitor. chunks_per_thread controls how finely each
+// element type is split; more chunks balance the load better at the
+// cost of more partial states to merge. Element types the visitor
+// does not support are skipped and counted in the result.
+template<MergeableVisitor Visitor>
+VisitResult ParallelAccept(const ElementContainer &container, Visitor &visitor, ThreadPool &pool,
+    std::size_t chunks_per_thread = 4)
+{
+    const std::size_t chunk_count = pool.Size() * chunks_per_thread;
+
+    VisitResult result;
+    std::vector<std::future<Visitor>> partials;
+
+    auto submit = [&](ElementType type, auto elements, auto process)
+    {
+        if(VisitorSupports(visitor, type))
+        {
+            detail::SubmitChunks(elements, chunk_count, visitor, pool, process, partials);
+            result.AddVisited(elements.size());
+        }
+        else
+        {
+            VISIT_INSTRUMENTATION_SKIPPED(visitor, elements);
+
+            result.AddSkipped(elements.size());
+        }
+    };
+
+    submit(ElementType::Single, container.GetSingleElements(),
+        [](Visitor &clone, std::span<const SingleElement> chunk) { clone.ProcessSingleElements(chunk); });
+
+    submit(ElementType::Array, container.GetArrayElements(),
+        [](Visitor &clone, std::span<const ArrayElement> chunk) { clone.ProcessArrayElements(chunk); });
+
+    submit(ElementType::String, container.GetStringElements(),
+        [](Visitor &clone, std::span<const StringElement> chunk) { clone.ProcessStringElements(chunk); });
+
+    detail::MergePartials(visitor, partials);
+
+    return result;
+}
+
+#endif // PARALLEL_VISIT_H
@@ -0,0 +1,378 @@
+#ifndef SHARD_VISIT_H
+#define SHARD_VISIT_H
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "elements.h"
+#include "element_container.h"
+#include "element_file.h"
+#include "parallel_visit.h"
+#include "thread_pool.h"
+#include "visit_result.h"
+#include "visitor_state.h"
+
+//////////////////////////////////////////////////////////////////////
+// Sharded visitation across machines
+//
+// The same reduction as ParallelAccept, one level up: a collection too
+// big for one machine is split into shards, each node visits its own
+// shard into a local visitor, and only the partial state of the
+// visitor is sent on to an aggregator, which merges the shards'
+// states with the visitor's Merge:
+//
+//     // on each node
+//     ShardDriver<SumVisitor> driver(SumVisitor(), shard, shard_count);
+//     driver.Run(local_container, pool);
+//     driver.Ship([&](std::span<const std::byte> report) { socket.Send(report); });
+//
+//     // on the aggregator, as the reports arrive
+//     ShardAggregator<SumVisitor> aggregator(SumVisitor(), shard_count);
+//     aggregator.Receive(report);
+//     ...
+//     SumVisitor total = aggregator.GetResult();
+//
+// A report is the shard's position, its visit counts and the visitor
+// state (see visitor_state.h): a SumVisitor report takes 19 bytes for
+// a shard of fewer than 128 elements, and a few bytes more for larger
+// ones. The transport is left to the caller.
+//
+// The aggregator merges the shards' states in shard order, whatever
+// order the reports arrive in, so the result of a given sharding does
+// not depend on the network. As for ParallelAccept, floating point
+// results can differ in the last bits from a single traversal, except
+// with ReproducibleSummation.
+//
+// Visitors must be SerializableVisitor: mergeable, with SaveState and
+// LoadState and a state_tag, which is checked on import so that the
+// state of one visitor type is never merged into another.
+//////////////////////////////////////////////////////////////////////
+
+template<typename Visitor>
+concept SerializableVisitor =
+    MergeableVisitor<Visitor> &&
+    requires(Visitor &visitor, const Visitor &other, StateWriter &writer, StateReader &reader)
+    {
+        { Visitor::state_tag } -> std::convertible_to<std::uint32_t>;
+        other.SaveState(writer);
+        visitor.LoadState(reader);
+    };
+
+
+namespace visitor_state
+{
+
+constexpr char magic[4] = {'V', 'P', 'V', 'S'};
+constexpr std::uint8_t version = 1;
+
+// The header of an exported state: magic, version, then the visitor's
+// state_tag as a varint
+template<SerializableVisitor Visitor>
+void WriteHeader(StateWriter &writer)
+{
+    for(char byte : magic)
+    {
+        writer.WriteByte(static_cast<std::uint8_t>(byte));
+    }
+
+    writer.WriteByte(version);
+    writer.WriteVarint(Visitor::state_tag);
+}
+
+template<SerializableVisitor Visitor>
+void ReadHeader(StateReader &reader)
+{
+    for(char byte : magic)
+    {
+        if(reader.ReadByte() != static_cast<std::uint8_t>(byte))
+        {
+            throw std::runtime_error("Error: not a visitor state");
+        }
+    }
+
+    if(reader.ReadByte() != version)
+    {
+        throw std::runtime_error("Error: unsupported visitor state version");
+    }
+
+    if(reader.ReadVarint() != Visitor::state_tag)
+    {
+        throw std::runtime_error("Error: visitor state of another visitor type");
+    }
+}
+
+} // namespace visitor_state
+
+
+// The partial state of visitor, for ImportState or MergeState on
+// another machine
+template<SerializableVisitor Visitor>
+std::vector<std::byte> ExportState(const Visitor &visitor)
+{
+    StateWriter writer;
+
+    visitor_state::WriteHeader<Visitor>(writer);
+    visitor.SaveState(writer);
+
+    return writer.TakeBytes();
+}
+
+// Replace the partial state of visitor by an exported one
+template<SerializableVisitor Visitor>
+void ImportState(Visitor &visitor, std::span<const std::byte> state)
+{
+    StateReader reader(state);
+
+    visitor_state::ReadHeader<Visitor>(reader);
+    visitor.LoadState(reader);
+
+    if(!reader.AtEnd())
+    {
+        throw std::runtime_error("Error: trailing bytes after visitor state");
+    }
+}
+
+// Merge an exported state into visitor, as if the visitor it came
+// from were merged
+template<SerializableVisitor Visitor>
+void MergeState(Visitor &visitor, std::span<const std::byte> state)
+{
+    Visitor partial = detail::CloneVisitor(visitor);
+
+    ImportState(partial, state);
+    visitor.Merge(partial);
+}
+
+
+// What a shard sends to the aggregator
+template<SerializableVisitor Visitor>
+struct ShardReport
+{
+    std::size_t shard = 0;
+    std::size_t shard_count = 0;
+    VisitResult result;
+    Visitor visitor;
+
+    // shard, shard_count, visited and skipped as varints, followed by
+    // the exported state of the visitor
+    std::vector<std::byte> Encode() const
+    {
+        StateWriter writer;
+
+        writer.WriteVarint(shard);
+        writer.WriteVarint(shard_count);
+        writer.WriteVarint(result.visited);
+        writer.WriteVarint(result.skipped);
+        writer.WriteBytes(ExportState(visitor));
+
+        return writer.TakeBytes();
+    }
+
+    // Decode a report into the state of a clone of prototype
+    static ShardReport Decode(const Visitor &prototype, std::span<const std::byte> bytes)
+    {
+        StateReader reader(bytes);
+
+        ShardReport report{0, 0, VisitResult{}, detail::CloneVisitor(prototype)};
+
+        report.shard = reader.ReadVarint();
+        report.shard_count = reader.ReadVarint();
+        report.result.AddVisited(reader.ReadVarint());
+        report.result.AddSkipped(reader.ReadVarint());
+
+        ImportState(report.visitor, reader.GetRemaining());
+
+        return report;
+    }
+};
+
+
+// Visits the local shard of a sharded collection. Run may be called
+// more than once, for a shard made of several containers or files;
+// the report covers all of them.
+template<SerializableVisitor Visitor>
+class ShardDriver
+{
+
+public:
+
+    ShardDriver(const Visitor &visitor, std::size_t shard, std::size_t shard_count)
+        : report{shard, shard_count, VisitResult{}, detail::CloneVisitor(visitor)}
+    {
+        if(shard_count == 0 || shard >= shard_count)
+        {
+            throw std::out_of_range("Error: shard " + std::to_string(shard) +
+                " out of range for " + std::to_string(shard_count) + " shards");
+        }
+    }
+
+    VisitResult Run(const ElementContainer &container)
+    {
+        return Record(container.Accept(report.visitor));
+    }
+
+    // Visit the container on the local threads of pool
+    VisitResult Run(const ElementContainer &container, ThreadPool &pool)
+    {
+        return Record(ParallelAccept(container, report.visitor, pool));
+    }
+
+    VisitResult Run(const MappedElementFile &file)
+    {
+        return Record(file.Accept(report.visitor));
+    }
+
+    const Visitor& GetVisitor() const
+    {
+        return report.visitor;
+    }
+
+    VisitResult GetResult() const
+    {
+        return report.result;
+    }
+
+    // The encoded report of everything visited so far
+    std::vector<std::byte> GetReport() const
+    {
+        return report.Encode();
+    }
+
+    // Hand the encoded report to send, which is called with a
+    // std::span<const std::byte> and delivers it to the aggregator
+    template<typename Send>
+    void Ship(Send &&send) const
+    {
+        const std::vector<std::byte> bytes = GetReport();
+
+        send(std::span<const std::byte>(bytes));
+    }
+
+private:
+
+    VisitResult Record(const VisitResult &result)
+    {
+        report.result.Merge(result);
+
+        return result;
+    }
+
+    ShardReport<Visitor> report;
+
+};
+
+
+// Collects the reports of every shard. Receive may be called from
+// several threads at once, for example one per connection.
+template<SerializableVisitor Visitor>
+class ShardAggregator
+{
+
+public:
+
+    ShardAggregator(const Visitor &prototype, std::size_t shard_count)
+        : prototype(detail::CloneVisitor(prototype))
+        , reports(shard_count)
+        , received{0}
+    {
+    }
+
+    // Decode and keep the report of one shard. A malformed report, a
+    // report of another sharding or a second report for a shard is an
+    // error, and leaves the aggregator unchanged.
+    void Receive(std::span<const std::byte> bytes)
+    {
+        ShardReport<Visitor> report = ShardReport<Visitor>::Decode(prototype, bytes);
+
+        if(report.shard_count != reports.size() || report.shard >= reports.size())
+        {
+            throw std::runtime_error("Error: report of shard " + std::to_string(report.shard) + " of " +
+                std::to_string(report.shard_count) + " shards, expected " + std::to_string(reports.size()));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::optional<ShardReport<Visitor>> &slot = reports[report.shard];
+
+        if(slot)
+        {
+            throw std::runtime_error("Error: duplicate report of shard " + std::to_string(report.shard));
+        }
+
+        slot.emplace(std::move(report));
+        ++ received;
+    }
+
+    std::size_t GetShardCount() const
+    {
+        return reports.size();
+    }
+
+    std::size_t GetReceivedCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        return received;
+    }
+
+    bool IsComplete() const
+    {
+        return GetReceivedCount() == reports.size();
+    }
+
+    // The states of the shards received so far, merged in shard order
+    Visitor GetResult() const
+    {
+        Visitor result = detail::CloneVisitor(prototype);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for(const std::optional<ShardReport<Visitor>> &report : reports)
+        {
+            if(report)
+            {
+                result.Merge(report->visitor);
+            }
+        }
+
+        return result;
+    }
+
+    // Counts of the elements visited and skipped by the shards
+    // received so far
+    VisitResult GetVisitResult() const
+    {
+        VisitResult result;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for(const std::optional<ShardReport<Visitor>> &report : reports)
+        {
+            if(report)
+            {
+                result.Merge(report->result);
+            }
+        }
+
+        return result;
+    }
+
+private:
+
+    Visitor prototype;
+
+    mutable std::mutex mutex;
+    std::vector<std::optional<ShardReport<Visitor>>> reports;
+    std::size_t received;
+
+};
+
+#endif // SHARD_VISIT_H
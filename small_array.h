@@ -0,0 +1,227 @@
+#ifndef SMALL_ARRAY_H
+#define SMALL_ARRAY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+//////////////////////////////////////////////////////////////////////
+// Array with inline storage for small payloads
+//
+// SmallArray holds up to N values inside the object itself, and only
+// allocates from its memory resource when it is given more. The heap
+// pointer and capacity share the space of the inline values, so the
+// array is no larger than a pmr::vector for N * sizeof(T) <= 16. Most
+// array payloads hold a handful of values, which then cost no heap
+// allocation and are read from the same cache lines as the object
+// holding them, rather than behind a pointer.
+//
+// It is allocator-aware in the same way as the pmr containers: the
+// allocator is kept for the lifetime of the array, a copy uses the
+// default memory resource unless one is given, and a move takes over
+// the heap storage when both use the same resource.
+//////////////////////////////////////////////////////////////////////
+
+template<typename T, std::size_t N>
+class SmallArray
+{
+
+    static_assert(N > 0, "SmallArray needs room for at least one value inline");
+    static_assert(std::is_trivially_copyable_v<T>, "SmallArray only holds trivially copyable values");
+
+public:
+
+    using value_type = T;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    static constexpr std::size_t inline_capacity = N;
+
+    explicit SmallArray(const allocator_type &allocator = {})
+        : allocator(allocator)
+        , size{0}
+    {
+    }
+
+    SmallArray(std::span<const T> values, const allocator_type &allocator = {})
+        : SmallArray(allocator)
+    {
+        Assign(values);
+    }
+
+    SmallArray(const SmallArray &other)
+        : SmallArray(other.GetView())
+    {
+    }
+
+    SmallArray(const SmallArray &other, const allocator_type &allocator)
+        : SmallArray(other.GetView(), allocator)
+    {
+    }
+
+    SmallArray(SmallArray &&other) noexcept
+        : allocator(other.allocator)
+        , size{0}
+    {
+        Steal(other);
+    }
+
+    SmallArray(SmallArray &&other, const allocator_type &allocator)
+        : SmallArray(allocator)
+    {
+        if(allocator == other.allocator)
+        {
+            Steal(other);
+        }
+        else
+        {
+            Assign(other.GetView());
+        }
+    }
+
+    // As for the pmr containers, the array keeps its own allocator
+    SmallArray& operator=(const SmallArray &other)
+    {
+        if(this != &other)
+        {
+            Assign(other.GetView());
+        }
+
+        return *this;
+    }
+
+    SmallArray& operator=(SmallArray &&other)
+    {
+        if(this != &other)
+        {
+            if(allocator == other.allocator)
+            {
+                Release();
+                Steal(other);
+            }
+            else
+            {
+                Assign(other.GetView());
+            }
+        }
+
+        return *this;
+    }
+
+    ~SmallArray()
+    {
+        Release();
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator;
+    }
+
+    // Replace the values. Up to N values are always held inline, and
+    // the heap storage is kept for larger values which fit in it. The
+    // values are copied before any storage is released, so they may be
+    // a part of this array.
+    void Assign(std::span<const T> values)
+    {
+        if(values.size() <= N)
+        {
+            T copied[N];
+            std::copy(values.begin(), values.end(), copied);
+
+            Release();
+            std::copy(copied, copied + values.size(), inline_values);
+        }
+        else if(!IsInline() && values.size() <= heap.capacity)
+        {
+            std::copy(values.begin(), values.end(), heap.values);
+        }
+        else
+        {
+            T *storage = allocator.allocate_object<T>(values.size());
+            std::copy(values.begin(), values.end(), storage);
+
+            Release();
+            heap.values = storage;
+            heap.capacity = values.size();
+        }
+
+        size = values.size();
+    }
+
+    std::size_t Size() const
+    {
+        return size;
+    }
+
+    // Whether the values are held in the object itself
+    bool IsInline() const
+    {
+        return size <= N;
+    }
+
+    T* GetData()
+    {
+        return IsInline() ? inline_values : heap.values;
+    }
+
+    const T* GetData() const
+    {
+        return IsInline() ? inline_values : heap.values;
+    }
+
+    std::span<const T> GetView() const
+    {
+        return std::span<const T>(GetData(), size);
+    }
+
+private:
+
+    // Take the values of other, which uses the same allocator, and
+    // leave it empty
+    void Steal(SmallArray &other)
+    {
+        if(other.IsInline())
+        {
+            std::copy(other.inline_values, other.inline_values + other.size, inline_values);
+        }
+        else
+        {
+            heap = other.heap;
+        }
+
+        size = other.size;
+        other.size = 0;
+    }
+
+    // Free the heap storage, if any, leaving the array empty
+    void Release()
+    {
+        if(!IsInline())
+        {
+            allocator.deallocate_object(heap.values, heap.capacity);
+        }
+
+        size = 0;
+    }
+
+    struct HeapStorage
+    {
+        T *values;
+        std::size_t capacity;
+    };
+
+    allocator_type allocator;
+    std::size_t size;           // the values are inline up to N
+
+    union
+    {
+        T inline_values[N];
+        HeapStorage heap;
+    };
+
+};
+
+#endif // SMALL_ARRAY_H
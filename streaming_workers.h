@@ -0,0 +1,388 @@
+#ifndef STREAMING_WORKERS_H
+#define STREAMING_WORKERS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "elements.h"
+#include "mpmc_queue.h"
+#include "parallel_visit.h"
+#include "variant_visitors.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Long-lived visitor workers fed by a lock-free queue
+//
+// For continuous ingestion, where elements keep arriving rather than
+// being collected into a container first. Any number of producer
+// threads push elements into a bounded MpmcQueue, and a fixed set of
+// worker threads drain it in batches, each into its own clone of the
+// visitor:
+//
+//     StreamingVisitorPool<SumVisitor> pool(sum_visitor, 4);
+//
+//     pool.Push(SingleElement(1.0));      // from any thread
+//     pool.Push(StringElement("123"));
+//
+//     SumVisitor total = pool.Snapshot(); // merged result so far
+//
+// Each worker only takes its own lock, once per batch, so the workers
+// never contend with each other; Snapshot takes the workers' locks in
+// turn to merge their states, in worker order. Which worker visits
+// which element depends on the scheduling, so floating point results
+// can differ in the last bits from one run to another. Drain waits
+// until every element pushed so far has been visited, after which
+// Snapshot includes all of them.
+//
+// A full queue is the backpressure: Push waits for room, TryPush
+// returns false. Workers with nothing to do spin briefly and then
+// sleep until the next push. With pin_threads set, worker i is pinned
+// to CPU i modulo the number of CPUs (Linux only).
+//
+// Elements are moved through the queue, so their payloads must use a
+// memory resource which outlives the pool. Element types the visitor
+// does not support are skipped and counted (GetResult).
+//////////////////////////////////////////////////////////////////////
+
+template<MergeableVisitor Visitor>
+class StreamingVisitorPool
+{
+
+public:
+
+    struct Options
+    {
+        std::size_t queue_capacity = 1 << 16;
+        std::size_t batch_size = 256;               // elements visited per lock
+        bool pin_threads = false;
+    };
+
+    StreamingVisitorPool(const Visitor &visitor, std::size_t thread_count)
+        : StreamingVisitorPool(visitor, thread_count, Options{})
+    {
+    }
+
+    StreamingVisitorPool(const Visitor &visitor, std::size_t thread_count, const Options &options)
+        : prototype(detail::CloneVisitor(visitor))
+        , options(options)
+        , queue(options.queue_capacity)
+        , pushed{0}
+        , visited{0}
+        , wakeups{0}
+        , sleeping{0}
+        , stopping{false}
+    {
+        if(thread_count == 0)
+        {
+            thread_count = 1;
+        }
+
+        if(this->options.batch_size == 0)
+        {
+            this->options.batch_size = 1;
+        }
+
+        workers.reserve(thread_count);
+
+        for(std::size_t i = 0; i < thread_count; ++ i)
+        {
+            workers.push_back(std::make_unique<Worker>(prototype));
+        }
+
+        for(std::size_t i = 0; i < thread_count; ++ i)
+        {
+            workers[i]->thread = std::thread([this, i]() { Run(*workers[i]); });
+
+            if(options.pin_threads)
+            {
+                Pin(workers[i]->thread, i);
+            }
+        }
+    }
+
+    StreamingVisitorPool(const StreamingVisitorPool&) = delete;
+    StreamingVisitorPool& operator=(const StreamingVisitorPool&) = delete;
+
+    // The elements still queued are visited before the workers are
+    // joined
+    ~StreamingVisitorPool()
+    {
+        stopping.store(true);
+        Wake();
+
+        for(std::unique_ptr<Worker> &worker : workers)
+        {
+            worker->thread.join();
+        }
+    }
+
+    std::size_t Size() const
+    {
+        return workers.size();
+    }
+
+    // Queue an element, waiting for room if the queue is full
+    void Push(Element element)
+    {
+        while(!TryPush(element))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // Queue an element unless the queue is full, in which case element
+    // is left untouched
+    bool TryPush(Element &element)
+    {
+        // Counted before the element is published, so that visited can
+        // never run ahead of pushed, and taken back if the queue is
+        // full. Sequentially consistent, as is the sleep in Run, so
+        // either this sees the worker going to sleep or the worker sees
+        // the count.
+        pushed.fetch_add(1);
+
+        if(!queue.TryPush(element))
+        {
+            pushed.fetch_sub(1);
+
+            return false;
+        }
+
+        if(sleeping.load() > 0)
+        {
+            Wake();
+        }
+
+        return true;
+    }
+
+    bool TryPush(Element &&element)
+    {
+        return TryPush(element);
+    }
+
+    // Wait until every element pushed before the call has been visited
+    void Drain() const
+    {
+        // Counts cannot tell which elements were visited, since a
+        // later element can be visited before an earlier one, so wait
+        // for the position: once the dequeue position has passed the
+        // enqueue position read here, every element pushed before has
+        // been taken by a worker
+        const std::size_t target = queue.EnqueuePosition();
+
+        while(static_cast<std::ptrdiff_t>(queue.DequeuePosition() - target) < 0)
+        {
+            std::this_thread::yield();
+        }
+
+        // Elements are taken under the worker's lock and visited before
+        // it is released, so taking each lock once waits for the
+        // batches still being visited
+        for(const std::unique_ptr<Worker> &worker : workers)
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+        }
+    }
+
+    // The visitor's state merged over every element visited so far
+    Visitor Snapshot() const
+    {
+        Visitor snapshot = detail::CloneVisitor(prototype);
+
+        for(const std::unique_ptr<Worker> &worker : workers)
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            snapshot.Merge(worker->visitor);
+        }
+
+        return snapshot;
+    }
+
+    // Counts of the elements visited and skipped so far
+    VisitResult GetResult() const
+    {
+        VisitResult result;
+
+        for(const std::unique_ptr<Worker> &worker : workers)
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            result.Merge(worker->result);
+        }
+
+        return result;
+    }
+
+    // Number of elements queued and not yet taken by a worker
+    std::size_t Backlog() const
+    {
+        return queue.SizeApprox();
+    }
+
+private:
+
+    // Each worker on its own cache lines, since the lock is written on
+    // every batch
+    struct alignas(detail::cache_line_size) Worker
+    {
+        explicit Worker(const Visitor &prototype)
+            : visitor(detail::CloneVisitor(prototype))
+        {
+        }
+
+        std::thread thread;
+        mutable std::mutex mutex;
+        Visitor visitor;
+        VisitResult result;
+    };
+
+    // Polls of an empty queue before a worker goes to sleep
+    static constexpr std::size_t spin_limit = 1024;
+
+    void Run(Worker &worker)
+    {
+        std::size_t idle = 0;
+
+        for(;;)
+        {
+            std::size_t count = 0;
+
+            {
+                std::lock_guard<std::mutex> lock(worker.mutex);
+
+                while(count < options.batch_size &&
+                    queue.TryConsume([&worker](const Element &element) { Visit(worker, element); }))
+                {
+                    ++ count;
+                }
+            }
+
+            if(count > 0)
+            {
+                visited.fetch_add(count, std::memory_order_release);
+                idle = 0;
+                continue;
+            }
+
+            if(stopping.load() && queue.SizeApprox() == 0)
+            {
+                return;
+            }
+
+            if(++ idle < spin_limit)
+            {
+                continue;
+            }
+
+            // Sleep until a push finds this worker sleeping, once every
+            // element pushed has been visited. Checked after announcing
+            // the sleep, so a push cannot be missed; a push counted but
+            // not yet published keeps the worker polling.
+            const std::uint32_t wakeup = wakeups.load();
+
+            sleeping.fetch_add(1);
+
+            if(pushed.load() == visited.load() && !stopping.load())
+            {
+                wakeups.wait(wakeup);
+            }
+
+            sleeping.fetch_sub(1);
+            idle = 0;
+        }
+    }
+
+    // Visit one element with the worker's visitor. Called with the
+    // worker's lock held.
+    static void Visit(Worker &worker, const Element &element)
+    {
+        std::visit(
+            [&worker](const auto &typed)
+            {
+                using Typed = std::decay_t<decltype(typed)>;
+
+                if constexpr(std::is_same_v<Typed, SingleElement>)
+                {
+                    VisitTyped(worker, ElementType::Single, typed,
+                        [](Visitor &visitor, const SingleElement &e) { visitor.ProcessSingleElement(e); });
+                }
+                else if constexpr(std::is_same_v<Typed, ArrayElement>)
+                {
+                    VisitTyped(worker, ElementType::Array, typed,
+                        [](Visitor &visitor, const ArrayElement &e) { visitor.ProcessArrayElement(e); });
+                }
+                else
+                {
+                    VisitTyped(worker, ElementType::String, typed,
+                        [](Visitor &visitor, const StringElement &e) { visitor.ProcessStringElement(e); });
+                }
+            },
+            element);
+    }
+
+    template<typename Typed, typename Process>
+    static void VisitTyped(Worker &worker, ElementType type, const Typed &element, Process process)
+    {
+        if(VisitorSupports(worker.visitor, type))
+        {
+            process(worker.visitor, element);
+            worker.result.AddVisited(1);
+        }
+        else
+        {
+            worker.result.AddSkipped(1);
+        }
+    }
+
+    void Wake()
+    {
+        wakeups.fetch_add(1);
+        wakeups.notify_all();
+    }
+
+    static void Pin(std::thread &thread, std::size_t index)
+    {
+#if defined(__linux__)
+        const std::size_t cpu_count = std::max(1u, std::thread::hardware_concurrency());
+
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % cpu_count, &cpus);
+
+        // Pinning is a hint: a failure, for example outside the
+        // process's cpuset, leaves the thread unpinned
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#else
+        (void)thread;
+        (void)index;
+#endif
+    }
+
+    Visitor prototype;
+    Options options;
+
+    MpmcQueue<Element> queue;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    alignas(detail::cache_line_size) std::atomic<std::uint64_t> pushed;
+    alignas(detail::cache_line_size) std::atomic<std::uint64_t> visited;
+    std::atomic<std::uint32_t> wakeups;
+    std::atomic<std::uint32_t> sleeping;
+    std::atomic<bool> stopping;
+
+};
+
+#endif // STREAMING_WORKERS_H
@@ -0,0 +1,102 @@
+#ifndef STRING_STREAM_H
+#define STRING_STREAM_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "elements.h"
+
+//////////////////////////////////////////////////////////////////////
+// Incremental string visiting
+//
+// StringStream feeds a string which arrives in pieces, for example
+// from a socket, to a visitor's string path:
+//
+//     StringStream stream(xor_visitor);
+//
+//     stream.Write(first_chunk);
+//     stream.Write(second_chunk);
+//     stream.Finish();
+//
+// The visitor's result is the same as if the whole string had been
+// visited as one StringElement. Visitors which support chunks (see
+// AbstractVisitor::SupportsStringChunks), such as the built-in ones,
+// process each chunk as it arrives and nothing is buffered. For any
+// other visitor the chunks are buffered and the string is visited
+// through ProcessStringView by Finish.
+//
+// A visitor should only be fed one stream at a time, and a visitor
+// which does not support strings at all is never called.
+//////////////////////////////////////////////////////////////////////
+
+class StringStream
+{
+
+public:
+
+    explicit StringStream(AbstractVisitor &visitor)
+        : visitor(visitor)
+        , supported(visitor.Supports(ElementType::String))
+        , incremental(supported && visitor.SupportsStringChunks())
+        , size{0}
+    {
+    }
+
+    StringStream(const StringStream&) = delete;
+    StringStream& operator=(const StringStream&) = delete;
+
+    void Write(std::string_view chunk)
+    {
+        size += chunk.size();
+
+        if(incremental)
+        {
+            visitor.ProcessStringChunk(chunk);
+        }
+        else if(supported)
+        {
+            buffer.append(chunk);
+        }
+    }
+
+    // Complete the string, after which the stream can be reused for the
+    // next one
+    void Finish()
+    {
+        if(incremental)
+        {
+            visitor.FinishString();
+        }
+        else if(supported)
+        {
+            visitor.ProcessStringView(buffer);
+            buffer.clear();
+        }
+
+        size = 0;
+    }
+
+    // Number of bytes written since the last Finish
+    std::size_t Size() const
+    {
+        return size;
+    }
+
+    // Whether chunks are processed as they arrive rather than buffered
+    bool IsIncremental() const
+    {
+        return incremental;
+    }
+
+private:
+
+    AbstractVisitor &visitor;
+    bool supported;
+    bool incremental;
+    std::size_t size;
+    std::string buffer;
+
+};
+
+#endif // STRING_STREAM_H
@@ -0,0 +1,544 @@
+#ifndef SUMMATION_H
+#define SUMMATION_H
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+#include "kernels.h"
+#include "visitor_state.h"
+
+//////////////////////////////////////////////////////////////////////
+// Summation policies
+//
+// A summation policy is the accumulator a BasicSumVisitor adds its
+// terms to, and decides how much precision is lost on the way:
+//
+//     BasicSumVisitor<CompensatedSummation> sum_visitor;
+//
+// Every policy is default constructible to zero and provides
+//
+//     void Add(double term)
+//     void Add(std::span<const double> terms, ReductionMode mode)
+//     void Merge(const Policy &other)
+//     double GetValue() const
+//
+// and, for exchanging partial sums between machines, SaveState and
+// LoadState (see visitor_state.h) and a state_tag telling the
+// policies' encodings apart.
+//
+// - NaiveSummation keeps one running double. The error grows linearly
+//   with the number of terms. This is the policy of SumVisitor.
+// - PairwiseSummation adds the terms in a balanced tree, so the error
+//   only grows with the logarithm of the number of terms, for a few
+//   more additions per term.
+// - CompensatedSummation (Neumaier) carries the rounding error of each
+//   addition in a second double, so the result is as accurate as with
+//   twice the precision whatever the number of terms.
+// - ReproducibleSummation accumulates the terms exactly in a fixed
+//   point integer wide enough for any double, and rounds once when the
+//   value is read. The result is the correctly rounded exact sum, so
+//   it is bit-identical for any order, chunking or number of threads.
+//
+// ReductionMode only applies to the policies which reduce arrays with
+// the kernels (NaiveSummation and PairwiseSummation). The compensated
+// and reproducible policies define their own order of operations.
+//////////////////////////////////////////////////////////////////////
+
+class NaiveSummation
+{
+
+public:
+
+    void Add(double term)
+    {
+        sum += term;
+    }
+
+    void Add(std::span<const double> terms, ReductionMode mode)
+    {
+        sum += kernels::Sum(terms, mode);
+    }
+
+    void Merge(const NaiveSummation& other)
+    {
+        sum += other.sum;
+    }
+
+    static constexpr std::uint32_t state_tag = 1;
+
+    void SaveState(StateWriter &writer) const
+    {
+        writer.WriteDouble(sum);
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        sum = reader.ReadDouble();
+    }
+
+    double GetValue() const
+    {
+        return sum;
+    }
+
+private:
+
+    double sum = 0.0;
+
+};
+
+
+class PairwiseSummation
+{
+
+public:
+
+    // Terms are added naively in blocks of block_size, and the blocks
+    // are combined as a binary counter: a carry merges two subtrees of
+    // the same size, so partials of very different magnitudes are only
+    // added at the end
+    static constexpr std::size_t block_size = 128;
+
+    void Add(double term)
+    {
+        block += term;
+
+        if(++ block_count == block_size)
+        {
+            Push(block);
+
+            block = 0.0;
+            block_count = 0;
+        }
+    }
+
+    // An array is summed pairwise on its own and added as one term
+    void Add(std::span<const double> terms, ReductionMode mode)
+    {
+        Add(Sum(terms, mode));
+    }
+
+    void Merge(const PairwiseSummation& other)
+    {
+        Add(other.GetValue());
+    }
+
+    static constexpr std::uint32_t state_tag = 2;
+
+    // Only the levels holding a subtree are written
+    void SaveState(StateWriter &writer) const
+    {
+        writer.WriteDouble(block);
+        writer.WriteVarint(block_count);
+        writer.WriteVarint(tree_count);
+
+        for(std::size_t level = 0; level < levels.size(); ++ level)
+        {
+            if((tree_count >> level) & 1)
+            {
+                writer.WriteDouble(levels[level]);
+            }
+        }
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        block = reader.ReadDouble();
+        block_count = reader.ReadVarint();
+        tree_count = reader.ReadVarint();
+
+        if(block_count >= block_size)
+        {
+            throw std::runtime_error("Error: malformed pairwise summation state");
+        }
+
+        levels.fill(0.0);
+
+        for(std::size_t level = 0; level < levels.size(); ++ level)
+        {
+            if((tree_count >> level) & 1)
+            {
+                levels[level] = reader.ReadDouble();
+            }
+        }
+    }
+
+    // The partials are added from the smallest subtree up
+    double GetValue() const
+    {
+        double sum = block;
+
+        for(std::size_t level = 0; level < levels.size(); ++ level)
+        {
+            if((tree_count >> level) & 1)
+            {
+                sum += levels[level];
+            }
+        }
+
+        return sum;
+    }
+
+private:
+
+    static double Sum(std::span<const double> terms, ReductionMode mode)
+    {
+        if(terms.size() <= block_size)
+        {
+            return kernels::Sum(terms, mode);
+        }
+
+        const std::size_t half = terms.size() / 2;
+
+        return Sum(terms.first(half), mode) + Sum(terms.subspan(half), mode);
+    }
+
+    void Push(double partial)
+    {
+        std::size_t level = 0;
+
+        for(; (tree_count >> level) & 1; ++ level)
+        {
+            partial = levels[level] + partial;
+        }
+
+        levels[level] = partial;
+        ++ tree_count;
+    }
+
+    double block = 0.0;
+    std::size_t block_count = 0;
+
+    // Bit i of tree_count is set when levels[i] holds the sum of
+    // 2^i blocks
+    std::array<double, 64> levels{};
+    std::uint64_t tree_count = 0;
+
+};
+
+
+class CompensatedSummation
+{
+
+public:
+
+    // Neumaier's variant of Kahan summation, which also compensates
+    // when the term is larger than the running sum
+    void Add(double term)
+    {
+        const double total = sum + term;
+
+        if(std::abs(sum) >= std::abs(term))
+        {
+            compensation += (sum - total) + term;
+        }
+        else
+        {
+            compensation += (term - total) + sum;
+        }
+
+        sum = total;
+    }
+
+    void Add(std::span<const double> terms, ReductionMode mode)
+    {
+        for(double term : terms)
+        {
+            Add(term);
+        }
+    }
+
+    void Merge(const CompensatedSummation& other)
+    {
+        Add(other.sum);
+        compensation += other.compensation;
+    }
+
+    static constexpr std::uint32_t state_tag = 3;
+
+    void SaveState(StateWriter &writer) const
+    {
+        writer.WriteDouble(sum);
+        writer.WriteDouble(compensation);
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        sum = reader.ReadDouble();
+        compensation = reader.ReadDouble();
+    }
+
+    double GetValue() const
+    {
+        return sum + compensation;
+    }
+
+private:
+
+    double sum = 0.0;
+    double compensation = 0.0;
+
+};
+
+
+class ReproducibleSummation
+{
+
+public:
+
+    void Add(double term)
+    {
+        const std::uint64_t bits = std::bit_cast<std::uint64_t>(term);
+        const int biased_exponent = static_cast<int>((bits >> 52) & 0x7ff);
+
+        if(biased_exponent == 0x7ff)
+        {
+            // Infinities and NaNs give the same result in any order
+            special += term;
+            return;
+        }
+
+        std::uint64_t mantissa = bits & ((std::uint64_t{1} << 52) - 1);
+
+        // The term is mantissa * 2^(position - 1074)
+        int position = 0;
+
+        if(biased_exponent != 0)
+        {
+            mantissa |= std::uint64_t{1} << 52;
+            position = biased_exponent - 1;
+        }
+
+        if(mantissa == 0)
+        {
+            return;
+        }
+
+        const unsigned __int128 shifted = static_cast<unsigned __int128>(mantissa) << (position % limb_bits);
+        const std::size_t limb = position / limb_bits;
+        const bool negative = (bits >> 63) != 0;
+
+        for(std::size_t part = 0; part < 3; ++ part)
+        {
+            const std::int64_t digit = static_cast<std::int64_t>((shifted >> (part * limb_bits)) & limb_mask);
+
+            limbs[limb + part] += negative ? -digit : digit;
+        }
+
+        if(++ pending_count == max_pending)
+        {
+            Normalize(limbs);
+            pending_count = 0;
+        }
+    }
+
+    void Add(std::span<const double> terms, ReductionMode mode)
+    {
+        for(double term : terms)
+        {
+            Add(term);
+        }
+    }
+
+    void Merge(const ReproducibleSummation& other)
+    {
+        Normalize(limbs);
+
+        Limbs normalized = other.limbs;
+        Normalize(normalized);
+
+        for(std::size_t index = 0; index < limb_count; ++ index)
+        {
+            limbs[index] += normalized[index];
+        }
+
+        // Each digit now holds at most two terms' worth
+        pending_count = 2;
+        special += other.special;
+    }
+
+    static constexpr std::uint32_t state_tag = 4;
+
+    // The accumulator is written normalized, as the range of limbs
+    // between the lowest and the highest nonzero one, each a varint, so
+    // a sum of terms of similar magnitudes takes a few dozen bytes
+    // rather than the whole accumulator
+    void SaveState(StateWriter &writer) const
+    {
+        Limbs normalized = limbs;
+        Normalize(normalized);
+
+        std::size_t first = 0;
+        std::size_t end = limb_count;
+
+        while(end > 0 && normalized[end - 1] == 0)
+        {
+            -- end;
+        }
+
+        while(first < end && normalized[first] == 0)
+        {
+            ++ first;
+        }
+
+        writer.WriteVarint(first);
+        writer.WriteVarint(end - first);
+
+        for(std::size_t index = first; index < end; ++ index)
+        {
+            writer.WriteSignedVarint(normalized[index]);
+        }
+
+        writer.WriteDouble(special);
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        const std::uint64_t first = reader.ReadVarint();
+        const std::uint64_t count = reader.ReadVarint();
+
+        if(first > limb_count || count > limb_count - first)
+        {
+            throw std::runtime_error("Error: malformed reproducible summation state");
+        }
+
+        limbs.fill(0);
+
+        for(std::size_t index = first; index < first + count; ++ index)
+        {
+            const std::int64_t digit = reader.ReadSignedVarint();
+
+            // Every limb but the top one is a digit
+            if(index + 1 < limb_count && (digit < 0 || digit > limb_mask))
+            {
+                throw std::runtime_error("Error: malformed reproducible summation state");
+            }
+
+            limbs[index] = digit;
+        }
+
+        pending_count = 1;
+        special = reader.ReadDouble();
+    }
+
+    // The exact sum rounded to the nearest double, ties to even
+    double GetValue() const
+    {
+        if(special != 0.0)
+        {
+            return special;
+        }
+
+        Limbs magnitude = limbs;
+        Normalize(magnitude);
+
+        // After normalizing, only the top limb carries the sign
+        const bool negative = magnitude[limb_count - 1] < 0;
+
+        if(negative)
+        {
+            for(std::int64_t &digit : magnitude)
+            {
+                digit = -digit;
+            }
+
+            Normalize(magnitude);
+        }
+
+        std::size_t top = limb_count;
+
+        while(top > 0 && magnitude[top - 1] == 0)
+        {
+            -- top;
+        }
+
+        if(top == 0)
+        {
+            return 0.0;
+        }
+
+        -- top;
+
+        // Gather the 128 bits below the top limb, shifted so that the
+        // leading bit is bit 127, and whether anything is left below
+        unsigned __int128 window = 0;
+        bool sticky = false;
+
+        for(std::size_t part = 0; part < 4; ++ part)
+        {
+            window <<= limb_bits;
+
+            if(top >= part)
+            {
+                window |= static_cast<std::uint64_t>(magnitude[top - part]);
+            }
+        }
+
+        for(std::size_t index = 0; index + 3 < top; ++ index)
+        {
+            sticky = sticky || magnitude[index] != 0;
+        }
+
+        const int leading_zeros = std::countl_zero(static_cast<std::uint64_t>(window >> 64));
+        window <<= leading_zeros;
+
+        const std::uint64_t high = static_cast<std::uint64_t>(window >> 64);
+        sticky = sticky || static_cast<std::uint64_t>(window) != 0;
+
+        // Round the 64 leading bits to the 53 of a double
+        std::uint64_t mantissa = high >> 11;
+        const std::uint64_t rest = high & 0x7ff;
+
+        if(rest > 0x400 || (rest == 0x400 && (sticky || (mantissa & 1))))
+        {
+            ++ mantissa;
+        }
+
+        // Position of the leading bit above 2^-1074. A result below
+        // the normal range has all its bits in the window, so the
+        // rounding above is exact and ldexp only scales.
+        const int leading_position = static_cast<int>(top * limb_bits) + limb_bits - 1 - leading_zeros;
+
+        const double value = std::ldexp(static_cast<double>(mantissa), leading_position - 52 - 1074);
+
+        return negative ? -value : value;
+    }
+
+private:
+
+    // Digits of 32 bits in 64 bit limbs leave room to add 2^30 terms
+    // before the carries need to be propagated
+    static constexpr int limb_bits = 32;
+    static constexpr std::int64_t limb_mask = (std::int64_t{1} << limb_bits) - 1;
+    static constexpr std::size_t max_pending = std::size_t{1} << 30;
+
+    // 2^-1074 to 2^1024, and room for the carries of 2^64 terms
+    static constexpr std::size_t limb_count = (2098 + 64) / limb_bits + 1;
+
+    using Limbs = std::array<std::int64_t, limb_count>;
+
+    // Propagate the carries so that every limb but the top one is a
+    // digit in [0, 2^32), and the top one holds the sign
+    static void Normalize(Limbs &digits)
+    {
+        for(std::size_t index = 0; index + 1 < limb_count; ++ index)
+        {
+            const std::int64_t carry = digits[index] >> limb_bits;
+
+            digits[index] -= carry * (std::int64_t{1} << limb_bits);
+            digits[index + 1] += carry;
+        }
+    }
+
+    Limbs limbs{};
+    std::size_t pending_count = 0;
+    double special = 0.0;
+
+};
+
+#endif // SUMMATION_H
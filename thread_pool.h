@@ -0,0 +1,122 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstddef>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////
+// Fixed size pool of worker threads
+//
+// Tasks are queued in submission order and picked up by whichever
+// worker is free. The result of each task, or the exception it threw,
+// is returned through a std::future.
+//////////////////////////////////////////////////////////////////////
+
+class ThreadPool
+{
+
+public:
+
+    explicit ThreadPool(std::size_t thread_count = std::thread::hardware_concurrency())
+        : stopping{false}
+    {
+        if(thread_count == 0)
+        {
+            thread_count = 1;
+        }
+
+        threads.reserve(thread_count);
+
+        for(std::size_t i = 0; i < thread_count; ++ i)
+        {
+            threads.emplace_back([this]() { Run(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queued tasks are completed before the workers are joined
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        condition.notify_all();
+
+        for(std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    std::size_t Size() const
+    {
+        return threads.size();
+    }
+
+    template<typename Function>
+    std::future<std::invoke_result_t<Function>> Submit(Function function)
+    {
+        using Result = std::invoke_result_t<Function>;
+
+        // std::function must be copyable, std::packaged_task is not
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+
+        std::future<Result> result = task->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([task]() { (*task)(); });
+        }
+
+        condition.notify_one();
+
+        return result;
+    }
+
+private:
+
+    void Run()
+    {
+        for(;;)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+                if(tasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            task();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,443 @@
+#ifndef TYPE_LIST_VISITOR_H
+#define TYPE_LIST_VISITOR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "elements.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Visitors generated from a type list of elements
+//
+// In the classic engine, a new element type means a new pure virtual
+// in AbstractVisitor, an override in every visitor and a new Accept.
+// Here the element types are a compile time list, and everything else
+// is generated from it:
+//
+//     using Elements = TypeList<SingleElement, ArrayElement, StringElement, BasicArrayElement<float>>;
+//
+//     class CountingVisitor : public TypeListVisitorBase<CountingVisitor, Elements>
+//     {
+//     public:
+//         void Visit(const SingleElement &element) { ... }
+//         void Visit(const StringElement &element) { ... }
+//     };
+//
+// A visitor implements Visit for the element types it handles and
+// nothing else. For every other type of the list, whether an element
+// type is supported is a constexpr flag (TypeListVisitorBase::supports)
+// rather than a run time error, and an element of that type given to
+// the visitor is counted in GetUnsupportedCount. Adding an element
+// type to the list changes no visitor.
+//
+// Dispatch goes through a flat table, generated at compile time for
+// each visitor type, of one function per element type, so an element
+// whose type is only known at run time costs a single indirect call:
+//
+//     ElementSequence<Elements> sequence;
+//     sequence.Add(SingleElement(1.0));
+//     sequence.Add(BasicArrayElement<float>(...));
+//
+//     sequence.Accept(counting_visitor);
+//
+// ElementSequence keeps the elements in the order they were added, in
+// one buffer per element type. ClassicVisitorAdapter wraps any
+// AbstractVisitor, so the existing visitors can be used with type
+// lists of the built-in element types.
+//
+// Visit overloads must be public, and are looked up exactly as a call
+// visitor.Visit(element) would be, so an overload taking a base class
+// handles every element type derived from it.
+//////////////////////////////////////////////////////////////////////
+
+template<typename... Types>
+struct TypeList
+{
+    static constexpr std::size_t size = sizeof...(Types);
+};
+
+
+namespace detail
+{
+
+template<typename T, typename... Types>
+struct TypeIndex;
+
+template<typename T, typename... Types>
+struct TypeIndex<T, T, Types...> : std::integral_constant<std::size_t, 0>
+{
+    static_assert((!std::is_same_v<T, Types> && ...), "A type appears more than once in the TypeList");
+};
+
+template<typename T, typename First, typename... Types>
+struct TypeIndex<T, First, Types...> : std::integral_constant<std::size_t, 1 + TypeIndex<T, Types...>::value>
+{
+};
+
+template<typename T>
+struct TypeIndex<T>
+{
+    static_assert(sizeof(T) == 0, "The type is not in the TypeList");
+};
+
+template<typename T, typename List>
+struct TypeListIndex;
+
+template<typename T, typename... Types>
+struct TypeListIndex<T, TypeList<Types...>> : TypeIndex<T, Types...>
+{
+};
+
+template<typename T, typename List>
+struct TypeListContains;
+
+template<typename T, typename... Types>
+struct TypeListContains<T, TypeList<Types...>> : std::bool_constant<(std::is_same_v<T, Types> || ...)>
+{
+};
+
+} // namespace detail
+
+
+// Position of T in List
+template<typename T, typename List>
+inline constexpr std::size_t type_list_index = detail::TypeListIndex<T, List>::value;
+
+template<typename T, typename List>
+inline constexpr bool type_list_contains = detail::TypeListContains<T, List>::value;
+
+// The element types of the classic engine
+using BuiltinElementList = TypeList<SingleElement, ArrayElement, StringElement>;
+
+// Whether Visitor has a Visit overload for Element
+template<typename Visitor, typename Element>
+concept VisitsElement = requires(Visitor &visitor, const Element &element)
+{
+    visitor.Visit(element);
+};
+
+
+template<typename List>
+class TypeListVisitor;
+
+// Interface of every visitor of the element types in the list, through
+// which elements are dispatched. The table is provided by
+// TypeListVisitorBase for the concrete visitor type.
+template<typename... Elements>
+class TypeListVisitor<TypeList<Elements...>>
+{
+
+public:
+
+    using ElementList = TypeList<Elements...>;
+
+    static constexpr std::size_t element_count = sizeof...(Elements);
+
+    using Entry = void (*)(TypeListVisitor&, const void*);
+    using DispatchTable = std::array<Entry, element_count>;
+    using SupportTable = std::array<bool, element_count>;
+
+    virtual
+    ~TypeListVisitor()
+    {
+        // I do nothing
+    }
+
+    template<typename Element>
+    void Process(const Element &element)
+    {
+        Dispatch(type_list_index<Element, ElementList>, &element);
+    }
+
+    // Visit the element of type index in the list at element
+    void Dispatch(std::size_t index, const void *element)
+    {
+        (*table)[index](*this, element);
+    }
+
+    bool Supports(std::size_t index) const
+    {
+        return (*supported)[index];
+    }
+
+    template<typename Element>
+    bool Supports() const
+    {
+        return Supports(type_list_index<Element, ElementList>);
+    }
+
+    // Number of elements given to this visitor of a type it does not
+    // support
+    std::size_t GetUnsupportedCount() const
+    {
+        return unsupported_count;
+    }
+
+protected:
+
+    TypeListVisitor(const DispatchTable &table, const SupportTable &supported)
+        : table(&table)
+        , supported(&supported)
+        , unsupported_count{0}
+    {
+    }
+
+    TypeListVisitor(const TypeListVisitor &other) = default;
+    TypeListVisitor& operator=(const TypeListVisitor &other) = default;
+
+    void CountUnsupported()
+    {
+        ++ unsupported_count;
+    }
+
+    void ResetUnsupportedCount()
+    {
+        unsupported_count = 0;
+    }
+
+private:
+
+    const DispatchTable *table;
+    const SupportTable *supported;
+    std::size_t unsupported_count;
+
+};
+
+
+// CRTP base generating the dispatch table of Derived over the element
+// types of List
+template<typename Derived, typename List>
+class TypeListVisitorBase;
+
+template<typename Derived, typename... Elements>
+class TypeListVisitorBase<Derived, TypeList<Elements...>> : public TypeListVisitor<TypeList<Elements...>>
+{
+
+    using Base = TypeListVisitor<TypeList<Elements...>>;
+
+public:
+
+    // Whether Derived supports Element, known at compile time. Only
+    // usable once Derived is complete.
+    template<typename Element>
+    static constexpr bool supports = VisitsElement<Derived, Element>;
+
+protected:
+
+    TypeListVisitorBase()
+        : Base(GetDispatchTable(), GetSupportTable())
+    {
+    }
+
+private:
+
+    template<typename Element>
+    static void Invoke(Base &visitor, const void *element)
+    {
+        if constexpr(supports<Element>)
+        {
+            static_cast<Derived&>(visitor).Visit(*static_cast<const Element*>(element));
+        }
+        else
+        {
+            static_cast<TypeListVisitorBase&>(visitor).CountUnsupported();
+        }
+    }
+
+    // Built on first use, from the constructor, by which point Derived
+    // is complete
+    static const typename Base::DispatchTable& GetDispatchTable()
+    {
+        static constexpr typename Base::DispatchTable table{&Invoke<Elements>...};
+
+        return table;
+    }
+
+    static const typename Base::SupportTable& GetSupportTable()
+    {
+        static constexpr typename Base::SupportTable supported{supports<Elements>...};
+
+        return supported;
+    }
+
+};
+
+
+// Elements of the types in the list, kept in the order they were
+// added. Each element type has its own buffer, and the order is a list
+// of (type, position) pairs.
+template<typename List>
+class ElementSequence;
+
+template<typename... Elements>
+class ElementSequence<TypeList<Elements...>>
+{
+
+public:
+
+    using ElementList = TypeList<Elements...>;
+    using Visitor = TypeListVisitor<ElementList>;
+
+    template<typename Element>
+    void Add(Element element)
+    {
+        static_assert(type_list_contains<Element, ElementList>, "The element type is not in the sequence's TypeList");
+
+        constexpr std::size_t type = type_list_index<Element, ElementList>;
+
+        std::vector<Element> &elements = std::get<type>(buffers);
+
+        order.push_back(Entry{static_cast<std::uint32_t>(type), elements.size()});
+        elements.push_back(std::move(element));
+    }
+
+    std::size_t Size() const
+    {
+        return order.size();
+    }
+
+    template<typename Element>
+    std::span<const Element> GetElements() const
+    {
+        return std::get<type_list_index<Element, ElementList>>(buffers);
+    }
+
+    // Visit every element in order, with one indirect call each.
+    // Elements the visitor does not support are counted as skipped, and
+    // in the visitor's unsupported count. The skipped count is taken
+    // from the dispatch itself, since a visitor may only decide at run
+    // time (ClassicVisitorAdapter without SupportsElementType).
+    VisitResult Accept(Visitor &visitor) const
+    {
+        const std::array<const unsigned char*, sizeof...(Elements)> bases{
+            reinterpret_cast<const unsigned char*>(std::get<std::vector<Elements>>(buffers).data())...};
+
+        const std::size_t unsupported = visitor.GetUnsupportedCount();
+
+        for(const Entry &entry : order)
+        {
+            visitor.Dispatch(entry.type, bases[entry.type] + entry.position * sizes[entry.type]);
+        }
+
+        const std::size_t skipped = visitor.GetUnsupportedCount() - unsupported;
+
+        VisitResult result;
+
+        result.AddVisited(order.size() - skipped);
+        result.AddSkipped(skipped);
+
+        return result;
+    }
+
+private:
+
+    struct Entry
+    {
+        std::uint32_t type;
+        std::size_t position;
+    };
+
+    static constexpr std::array<std::size_t, sizeof...(Elements)> sizes{sizeof(Elements)...};
+
+    std::tuple<std::vector<Elements>...> buffers;
+    std::vector<Entry> order;
+
+};
+
+
+// Type list visitor forwarding to an AbstractVisitor, so that the
+// classic visitors can visit the built-in element types of a list.
+// When Visitor declares SupportsElementType, the element types it does
+// not support have no overload here, and are unsupported at compile
+// time; otherwise Supports is checked at run time.
+template<typename Visitor, typename List>
+class ClassicVisitorAdapter : public TypeListVisitorBase<ClassicVisitorAdapter<Visitor, List>, List>
+{
+
+    static_assert(std::is_base_of_v<AbstractVisitor, Visitor>, "ClassicVisitorAdapter wraps classes derived from AbstractVisitor");
+
+public:
+
+    explicit ClassicVisitorAdapter(Visitor &visitor)
+        : visitor(visitor)
+    {
+    }
+
+    void Visit(const SingleElement &element) requires(SupportsElementType<Visitor>(ElementType::Single))
+    {
+        Forward(ElementType::Single, element);
+    }
+
+    void Visit(const ArrayElement &element) requires(SupportsElementType<Visitor>(ElementType::Array))
+    {
+        Forward(ElementType::Array, element);
+    }
+
+    void Visit(const BasicArrayElement<float> &element) requires(SupportsElementType<Visitor>(ElementType::Array))
+    {
+        Forward(ElementType::Array, element);
+    }
+
+    void Visit(const BasicArrayElement<std::int32_t> &element) requires(SupportsElementType<Visitor>(ElementType::Array))
+    {
+        Forward(ElementType::Array, element);
+    }
+
+    void Visit(const BasicArrayElement<std::int64_t> &element) requires(SupportsElementType<Visitor>(ElementType::Array))
+    {
+        Forward(ElementType::Array, element);
+    }
+
+    void Visit(const StringElement &element) requires(SupportsElementType<Visitor>(ElementType::String))
+    {
+        Forward(ElementType::String, element);
+    }
+
+private:
+
+    template<typename Element>
+    void Forward(ElementType type, const Element &element)
+    {
+        if constexpr(DeclaresSupportedElements<Visitor>)
+        {
+            ForwardToClassic(visitor, element);
+        }
+        else if(visitor.Supports(type))
+        {
+            ForwardToClassic(visitor, element);
+        }
+        else
+        {
+            this->CountUnsupported();
+        }
+    }
+
+    // Through AbstractVisitor, so no overload is hidden by the visitor
+    static void ForwardToClassic(AbstractVisitor &visitor, const SingleElement &element)
+    {
+        visitor.ProcessSingleElement(element);
+    }
+
+    template<typename T>
+    static void ForwardToClassic(AbstractVisitor &visitor, const BasicArrayElement<T> &element)
+    {
+        visitor.ProcessArrayElement(element);
+    }
+
+    static void ForwardToClassic(AbstractVisitor &visitor, const StringElement &element)
+    {
+        visitor.ProcessStringElement(element);
+    }
+
+    Visitor &visitor;
+
+};
+
+#endif // TYPE_LIST_VISITOR_H
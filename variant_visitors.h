@@ -0,0 +1,263 @@
+#ifndef VARIANT_VISITORS_H
+#define VARIANT_VISITORS_H
+
+#include <variant>
+#include <vector>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include "elements.h"
+#include "kernels.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Statically dispatched engine
+//
+// The classic engine costs two virtual calls per element (Accept and
+// then ProcessXxxElement). Here the element types are held by value in
+// a std::variant and the visitors are plain function objects, so
+// std::visit resolves the call with a jump on the variant index and
+// the compiler is free to inline the reduction into the loop.
+//
+// The classic AbstractVisitor hierarchy remains the extension point
+// for visitors which are not known at compile time.
+//
+// As the classic visitors do, the static visitors read the digit index
+// of a string which has one rather than scanning it.
+//////////////////////////////////////////////////////////////////////
+
+using Element = std::variant<SingleElement, ArrayElement, StringElement>;
+
+
+class StaticSumVisitor
+{
+
+public:
+
+    // Strict keeps the ordering of std::accumulate; Reassociate lets
+    // array reductions use the vectorized kernels
+    StaticSumVisitor(ReductionMode mode = ReductionMode::Strict)
+        : value{0.0}
+        , mode(mode)
+    {
+    }
+
+    void operator()(const SingleElement& element)
+    {
+        value += element.GetValue();
+    }
+
+    void operator()(const ArrayElement& element)
+    {
+        std::span<const double> v = element.GetView();
+
+        value += kernels::Sum(v, mode);
+    }
+
+    void operator()(const ArrayElementPool& pool)
+    {
+        value += kernels::Sum(pool.GetValues(), mode);
+    }
+
+    void operator()(const StringElement& element)
+    {
+        if(const StringDigitIndex *index = element.GetDigitIndex())
+        {
+            value += index->digit_sum;
+            return;
+        }
+
+        std::string_view v = element.GetView();
+
+        value += kernels::DigitSum(v);
+    }
+
+    double GetValue() const
+    {
+        return value;
+    }
+
+    void Reset()
+    {
+        value = 0.0;
+    }
+
+    ReductionMode GetMode() const
+    {
+        return mode;
+    }
+
+private:
+
+    double value;
+    ReductionMode mode;
+
+};
+
+
+class StaticMultiplyVisitor
+{
+
+public:
+
+    StaticMultiplyVisitor(ReductionMode mode = ReductionMode::Strict)
+        : value(1.0)
+        , mode(mode)
+    {
+    }
+
+    void operator()(const SingleElement& element)
+    {
+        value *= element.GetValue();
+    }
+
+    void operator()(const ArrayElement& element)
+    {
+        std::span<const double> v = element.GetView();
+
+        value *= kernels::Product(v, mode);
+    }
+
+    void operator()(const ArrayElementPool& pool)
+    {
+        value *= kernels::Product(pool.GetValues(), mode);
+    }
+
+    void operator()(const StringElement& element)
+    {
+        if(const StringDigitIndex *index = element.GetDigitIndex())
+        {
+            value *= index->digit_product.GetValue();
+            return;
+        }
+
+        std::string_view v = element.GetView();
+
+        value *= kernels::DigitProduct(v);
+    }
+
+    double GetValue() const
+    {
+        return value;
+    }
+
+    void Reset()
+    {
+        value = 1.0;
+    }
+
+    ReductionMode GetMode() const
+    {
+        return mode;
+    }
+
+private:
+
+    double value;
+    ReductionMode mode;
+
+};
+
+
+class StaticXORVisitor
+{
+
+public:
+
+    StaticXORVisitor()
+        : value{0}
+    {
+    }
+
+    // Numeric elements are skipped by the engines, which count them in
+    // VisitResult::skipped, so there is no overload for them
+    static constexpr bool SupportsElementType(ElementType type)
+    {
+        return type == ElementType::String;
+    }
+
+    void operator()(const StringElement& element)
+    {
+        if(const StringDigitIndex *index = element.GetDigitIndex())
+        {
+            value ^= index->checksum;
+            return;
+        }
+
+        std::string_view v = element.GetView();
+
+        value ^= kernels::XorChecksum(v);
+    }
+
+    unsigned char GetValue() const
+    {
+        return value;
+    }
+
+    void Reset()
+    {
+        value = 0;
+    }
+
+private:
+
+    unsigned char value;
+
+};
+
+
+// Maps each alternative of Element to its ElementType
+template<typename T>
+constexpr ElementType ElementTypeOf()
+{
+    if constexpr(std::is_same_v<T, SingleElement>)
+    {
+        return ElementType::Single;
+    }
+    else if constexpr(std::is_same_v<T, ArrayElement>)
+    {
+        return ElementType::Array;
+    }
+    else
+    {
+        static_assert(std::is_same_v<T, StringElement>, "not an Element alternative");
+        return ElementType::String;
+    }
+}
+
+
+// Apply a static visitor to every element of a collection. The visitor
+// is taken by reference so that its accumulated state is kept by the
+// caller, in the same way as with the classic engine. Element types
+// the visitor does not declare support for are skipped at compile
+// time, without calling the visitor.
+template<typename Visitor>
+VisitResult VisitAll(std::span<const Element> elements, Visitor &visitor)
+{
+    VisitResult result;
+
+    for(const Element &element : elements)
+    {
+        std::visit(
+            [&visitor, &result](const auto &concrete)
+            {
+                using T = std::decay_t<decltype(concrete)>;
+
+                if constexpr(SupportsElementType<Visitor>(ElementTypeOf<T>()))
+                {
+                    visitor(concrete);
+                    result.AddVisited(1);
+                }
+                else
+                {
+                    result.AddSkipped(1);
+                }
+            },
+            element);
+    }
+
+    return result;
+}
+
+#endif // VARIANT_VISITORS_H
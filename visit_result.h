@@ -0,0 +1,122 @@
+#ifndef VISIT_RESULT_H
+#define VISIT_RESULT_H
+
+#include <concepts>
+#include <cstddef>
+#include <type_traits>
+
+#include "elements.h"
+
+//////////////////////////////////////////////////////////////////////
+// Outcome of visiting a batch of elements
+//
+// Elements which the visitor does not support are skipped and
+// counted, so one unsupported element no longer aborts the whole
+// batch. The caller decides whether a batch with skipped elements is
+// an error.
+//////////////////////////////////////////////////////////////////////
+
+enum class VisitStatus
+{
+    Ok,
+    UnsupportedElements
+};
+
+inline const char* ToString(VisitStatus status)
+{
+    switch(status)
+    {
+        case VisitStatus::Ok:
+            return "ok";
+        case VisitStatus::UnsupportedElements:
+            return "unsupported elements";
+    }
+
+    return "unknown";
+}
+
+
+struct VisitResult
+{
+    VisitStatus status = VisitStatus::Ok;
+    std::size_t visited = 0;
+    std::size_t skipped = 0;
+
+    explicit operator bool() const
+    {
+        return status == VisitStatus::Ok;
+    }
+
+    void AddVisited(std::size_t count)
+    {
+        visited += count;
+    }
+
+    void AddSkipped(std::size_t count)
+    {
+        if(count > 0)
+        {
+            skipped += count;
+            status = VisitStatus::UnsupportedElements;
+        }
+    }
+
+    void Merge(const VisitResult &other)
+    {
+        AddVisited(other.visited);
+        AddSkipped(other.skipped);
+    }
+};
+
+
+//////////////////////////////////////////////////////////////////////
+// Element type capabilities
+//
+// A visitor declares the element types it supports with
+//
+//     static constexpr bool SupportsElementType(ElementType type);
+//
+// A visitor without the declaration supports every element type,
+// unless it is an AbstractVisitor whose Supports override says
+// otherwise at run time.
+//////////////////////////////////////////////////////////////////////
+
+template<typename Visitor>
+concept DeclaresSupportedElements = requires
+{
+    { std::bool_constant<Visitor::SupportsElementType(ElementType::Single)>::value } -> std::convertible_to<bool>;
+};
+
+template<typename Visitor>
+constexpr bool SupportsElementType(ElementType type)
+{
+    if constexpr(DeclaresSupportedElements<Visitor>)
+    {
+        return Visitor::SupportsElementType(type);
+    }
+    else
+    {
+        return true;
+    }
+}
+
+// The compile time declaration if there is one, otherwise the run time
+// capability of an AbstractVisitor
+template<typename Visitor>
+bool VisitorSupports(const Visitor &visitor, ElementType type)
+{
+    if constexpr(DeclaresSupportedElements<Visitor>)
+    {
+        return Visitor::SupportsElementType(type);
+    }
+    else if constexpr(std::is_base_of_v<AbstractVisitor, Visitor>)
+    {
+        return visitor.Supports(type);
+    }
+    else
+    {
+        return true;
+    }
+}
+
+#endif // VISIT_RESULT_H
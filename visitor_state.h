@@ -0,0 +1,176 @@
+#ifndef VISITOR_STATE_H
+#define VISITOR_STATE_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////
+// Binary encoding of partial visitor states
+//
+// The reducible visitors and their accumulators write their partial
+// state with SaveState and read it back with LoadState, so that a
+// state computed on one machine can be merged into a visitor on
+// another (see shard_visit.h):
+//
+//     void SaveState(StateWriter &writer) const
+//     void LoadState(StateReader &reader)
+//
+// The encoding is meant to be small on the wire rather than fast to
+// read in place: counts and integers are LEB128 varints, signed ones
+// zigzag encoded, and doubles and hashes are their 8 bytes. Everything
+// is little endian whatever the machine, so states can be exchanged
+// between machines of different byte orders.
+//
+// A malformed or truncated state is reported with std::runtime_error.
+//////////////////////////////////////////////////////////////////////
+
+class StateWriter
+{
+
+public:
+
+    void WriteByte(std::uint8_t value)
+    {
+        bytes.push_back(static_cast<std::byte>(value));
+    }
+
+    void WriteVarint(std::uint64_t value)
+    {
+        while(value >= 0x80)
+        {
+            WriteByte(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+
+        WriteByte(static_cast<std::uint8_t>(value));
+    }
+
+    void WriteSignedVarint(std::int64_t value)
+    {
+        WriteVarint((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+    }
+
+    // For values whose bits are all significant, such as hashes
+    void WriteFixed64(std::uint64_t value)
+    {
+        for(std::size_t i = 0; i < sizeof(value); ++ i)
+        {
+            WriteByte(static_cast<std::uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void WriteDouble(double value)
+    {
+        WriteFixed64(std::bit_cast<std::uint64_t>(value));
+    }
+
+    void WriteBytes(std::span<const std::byte> data)
+    {
+        bytes.insert(bytes.end(), data.begin(), data.end());
+    }
+
+    std::span<const std::byte> GetBytes() const
+    {
+        return bytes;
+    }
+
+    std::vector<std::byte> TakeBytes()
+    {
+        return std::move(bytes);
+    }
+
+private:
+
+    std::vector<std::byte> bytes;
+
+};
+
+
+class StateReader
+{
+
+public:
+
+    explicit StateReader(std::span<const std::byte> bytes)
+        : bytes(bytes)
+        , offset{0}
+    {
+    }
+
+    std::uint8_t ReadByte()
+    {
+        if(offset == bytes.size())
+        {
+            throw std::runtime_error("Error: truncated visitor state");
+        }
+
+        return static_cast<std::uint8_t>(bytes[offset ++]);
+    }
+
+    std::uint64_t ReadVarint()
+    {
+        std::uint64_t value = 0;
+
+        for(unsigned shift = 0; shift < 64; shift += 7)
+        {
+            const std::uint8_t byte = ReadByte();
+
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+
+            if((byte & 0x80) == 0)
+            {
+                return value;
+            }
+        }
+
+        throw std::runtime_error("Error: malformed varint in visitor state");
+    }
+
+    std::int64_t ReadSignedVarint()
+    {
+        const std::uint64_t value = ReadVarint();
+
+        return static_cast<std::int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    std::uint64_t ReadFixed64()
+    {
+        std::uint64_t value = 0;
+
+        for(std::size_t i = 0; i < sizeof(value); ++ i)
+        {
+            value |= static_cast<std::uint64_t>(ReadByte()) << (8 * i);
+        }
+
+        return value;
+    }
+
+    double ReadDouble()
+    {
+        return std::bit_cast<double>(ReadFixed64());
+    }
+
+    // The bytes not read yet
+    std::span<const std::byte> GetRemaining() const
+    {
+        return bytes.subspan(offset);
+    }
+
+    bool AtEnd() const
+    {
+        return offset == bytes.size();
+    }
+
+private:
+
+    std::span<const std::byte> bytes;
+    std::size_t offset;
+
+};
+
+#endif // VISITOR_STATE_H
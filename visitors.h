@@ -0,0 +1,764 @@
+#ifndef VISITORS_H
+#define VISITORS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "elements.h"
+#include "kernels.h"
+#include "summation.h"
+#include "multiplication.h"
+#include "visitor_state.h"
+
+//////////////////////////////////////////////////////////
+// Visitor classes which define the logic for operations
+//////////////////////////////////////////////////////////
+
+
+// The terms of the sum are added to an accumulator chosen by Policy,
+// see summation.h. SumVisitor keeps one running double.
+template<typename Policy = NaiveSummation>
+class BasicSumVisitor : public AbstractVisitor
+{
+
+public:
+
+    // Strict keeps the ordering of std::accumulate; Reassociate lets
+    // array reductions use the vectorized kernels
+    BasicSumVisitor(ReductionMode mode = ReductionMode::Strict)
+        : value{}
+        , pending{0.0}
+        , mode(mode)
+    {
+    }
+
+    ~BasicSumVisitor()
+    {
+        // I do nothing
+    }
+
+    void ProcessSingleElement(const SingleElement& element)
+    {
+        value.Add(element.GetValue());
+    }
+
+    // With NaiveSummation in Reassociate mode the values are added to
+    // four independent partial sums, which breaks the dependency
+    // between consecutive additions, and the partials are added to the
+    // result once. The other policies take the values one at a time.
+    void ProcessSingleElements(std::span<const SingleElement> elements)
+    {
+        if constexpr(std::is_same_v<Policy, NaiveSummation>)
+        {
+            if(mode == ReductionMode::Reassociate)
+            {
+                double sums[4] = {0.0, 0.0, 0.0, 0.0};
+
+                std::size_t index = 0;
+
+                for(; index + 4 <= elements.size(); index += 4)
+                {
+                    sums[0] += elements[index].GetValue();
+                    sums[1] += elements[index + 1].GetValue();
+                    sums[2] += elements[index + 2].GetValue();
+                    sums[3] += elements[index + 3].GetValue();
+                }
+
+                for(; index < elements.size(); ++ index)
+                {
+                    sums[0] += elements[index].GetValue();
+                }
+
+                value.Add((sums[0] + sums[1]) + (sums[2] + sums[3]));
+                return;
+            }
+        }
+
+        // Accumulating in a local keeps the sum in a register; the
+        // additions are still made one at a time in order
+        Policy sum = value;
+
+        for(const SingleElement &element : elements)
+        {
+            sum.Add(element.GetValue());
+        }
+
+        value = sum;
+    }
+
+    void ProcessArrayElement(const ArrayElement& element)
+    {
+        ProcessArrayView(element.GetView());
+    }
+
+    void ProcessArrayElements(std::span<const ArrayElement> elements)
+    {
+        for(const ArrayElement &element : elements)
+        {
+            value.Add(element.GetView(), mode);
+        }
+    }
+
+    void ProcessArrayView(std::span<const double> v)
+    {
+        value.Add(v, mode);
+    }
+
+    // Integer arrays are summed exactly as integers, and the sum is
+    // added to the result as one term. Float arrays are summed by the
+    // float kernels with NaiveSummation, and widened to double for the
+    // other policies, which gives the same result as widening either way.
+    void ProcessArrayElement(const BasicArrayElement<float>& element)
+    {
+        ProcessTypedArray(element.GetView());
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<std::int32_t>& element)
+    {
+        ProcessTypedArray(element.GetView());
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<std::int64_t>& element)
+    {
+        ProcessTypedArray(element.GetView());
+    }
+
+    // The sum of a pool is the sum of all its values, so the whole
+    // buffer is reduced in one pass. The additions are associated
+    // over the concatenated buffer rather than per array, which can
+    // differ from visiting each array in the last bits of the result.
+    void ProcessArrayElementPool(const ArrayElementPool& pool)
+    {
+        value.Add(pool.GetValues(), mode);
+    }
+
+    // Strings with a digit index are not scanned again
+    void ProcessStringElement(const StringElement& element)
+    {
+        value.Add(DigitSum(element));
+    }
+
+    void ProcessStringElements(std::span<const StringElement> elements)
+    {
+        for(const StringElement &element : elements)
+        {
+            value.Add(DigitSum(element));
+        }
+    }
+
+    void ProcessStringView(std::string_view v)
+    {
+        value.Add(kernels::DigitSum(v));
+    }
+
+    // The digit sum of the chunks is an exact integer, added to the
+    // result only once the string is finished
+    bool SupportsStringChunks() const
+    {
+        return true;
+    }
+
+    void ProcessStringChunk(std::string_view chunk)
+    {
+        pending += kernels::DigitSum(chunk);
+    }
+
+    void FinishString()
+    {
+        value.Add(pending);
+        pending = 0.0;
+    }
+
+    // Fold in a partial sum computed elsewhere, for example by the
+    // shared pass of a FusedVisitor
+    void Accumulate(double sum)
+    {
+        value.Add(sum);
+    }
+
+    // Combine the partial result of another visitor, for example a
+    // per-thread clone in ParallelAccept
+    void Merge(const BasicSumVisitor& other)
+    {
+        value.Merge(other.value);
+    }
+
+    static constexpr std::uint32_t state_tag = 0x100 + Policy::state_tag;
+
+    // The partial sum, for merging on another machine. The digit sum
+    // of an unfinished chunked string is not part of it, and neither is
+    // the reduction mode.
+    void SaveState(StateWriter &writer) const
+    {
+        value.SaveState(writer);
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        value.LoadState(reader);
+    }
+
+    double GetValue() const
+    {
+        return value.GetValue();
+    }
+
+    void Reset()
+    {
+        value = Policy{};
+        pending = 0.0;
+    }
+
+    ReductionMode GetMode() const
+    {
+        return mode;
+    }
+
+private:
+
+    static double DigitSum(const StringElement& element)
+    {
+        if(const StringDigitIndex *index = element.GetDigitIndex())
+        {
+            return index->digit_sum;
+        }
+
+        return kernels::DigitSum(element.GetView());
+    }
+
+    template<typename T>
+    void ProcessTypedArray(std::span<const T> values)
+    {
+        if constexpr(std::is_integral_v<T>)
+        {
+            value.Add(static_cast<double>(kernels::Sum(values)));
+        }
+        else if constexpr(std::is_same_v<Policy, NaiveSummation>)
+        {
+            value.Add(kernels::Sum(values, mode));
+        }
+        else
+        {
+            const std::vector<double> widened(values.begin(), values.end());
+
+            value.Add(widened, mode);
+        }
+    }
+
+    Policy value;
+    double pending;     // digit sum of an unfinished chunked string
+    ReductionMode mode;
+
+};
+
+using SumVisitor = BasicSumVisitor<>;
+
+
+// The factors of the product are multiplied into an accumulator chosen
+// by Policy, see multiplication.h. MultiplyVisitor keeps one running
+// double.
+template<typename Policy = NaiveProduct>
+class BasicMultiplyVisitor : public AbstractVisitor
+{
+
+public:
+
+    BasicMultiplyVisitor(ReductionMode mode = ReductionMode::Strict)
+        : value{}
+        , pending{}
+        , mode(mode)
+    {
+    }
+
+    ~BasicMultiplyVisitor()
+    {
+        // I do nothing
+    }
+
+    void ProcessSingleElement(const SingleElement& element)
+    {
+        value.Multiply(element.GetValue());
+    }
+
+    // As for SumVisitor, NaiveProduct in Reassociate mode keeps four
+    // partial products
+    void ProcessSingleElements(std::span<const SingleElement> elements)
+    {
+        if constexpr(std::is_same_v<Policy, NaiveProduct>)
+        {
+            if(mode == ReductionMode::Reassociate)
+            {
+                double products[4] = {1.0, 1.0, 1.0, 1.0};
+
+                std::size_t index = 0;
+
+                for(; index + 4 <= elements.size(); index += 4)
+                {
+                    products[0] *= elements[index].GetValue();
+                    products[1] *= elements[index + 1].GetValue();
+                    products[2] *= elements[index + 2].GetValue();
+                    products[3] *= elements[index + 3].GetValue();
+                }
+
+                for(; index < elements.size(); ++ index)
+                {
+                    products[0] *= elements[index].GetValue();
+                }
+
+                value.Multiply((products[0] * products[1]) * (products[2] * products[3]));
+                return;
+            }
+        }
+
+        Policy product = value;
+
+        for(const SingleElement &element : elements)
+        {
+            product.Multiply(element.GetValue());
+        }
+
+        value = product;
+    }
+
+    void ProcessArrayElement(const ArrayElement& element)
+    {
+        ProcessArrayView(element.GetView());
+    }
+
+    void ProcessArrayElements(std::span<const ArrayElement> elements)
+    {
+        for(const ArrayElement &element : elements)
+        {
+            value.Multiply(element.GetView(), mode);
+        }
+    }
+
+    void ProcessArrayView(std::span<const double> v)
+    {
+        value.Multiply(v, mode);
+    }
+
+    // Float arrays are multiplied by the float kernels with
+    // NaiveProduct. Integer arrays, and float arrays with the other
+    // policies, are multiplied as their values widened to double.
+    void ProcessArrayElement(const BasicArrayElement<float>& element)
+    {
+        ProcessTypedArray(element.GetView());
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<std::int32_t>& element)
+    {
+        ProcessTypedArray(element.GetView());
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<std::int64_t>& element)
+    {
+        ProcessTypedArray(element.GetView());
+    }
+
+    // As for SumVisitor, the pool is reduced as one buffer
+    void ProcessArrayElementPool(const ArrayElementPool& pool)
+    {
+        value.Multiply(pool.GetValues(), mode);
+    }
+
+    void ProcessStringElement(const StringElement& element)
+    {
+        ProcessString(element);
+    }
+
+    void ProcessStringElements(std::span<const StringElement> elements)
+    {
+        for(const StringElement &element : elements)
+        {
+            ProcessString(element);
+        }
+    }
+
+    // The digit product of a string is computed on its own and then
+    // multiplied into the result
+    void ProcessStringView(std::string_view v)
+    {
+        Policy digits;
+        digits.MultiplyDigits(v);
+
+        value.Merge(digits);
+    }
+
+    // The digits of each chunk are multiplied into the running product
+    // of the string in order, so the result is the same as for the
+    // whole string
+    bool SupportsStringChunks() const
+    {
+        return true;
+    }
+
+    void ProcessStringChunk(std::string_view chunk)
+    {
+        pending.MultiplyDigits(chunk);
+    }
+
+    void FinishString()
+    {
+        value.Merge(pending);
+        pending = Policy{};
+    }
+
+    void Accumulate(double product)
+    {
+        value.Multiply(product);
+    }
+
+    void Merge(const BasicMultiplyVisitor& other)
+    {
+        value.Merge(other.value);
+    }
+
+    static constexpr std::uint32_t state_tag = 0x200 + Policy::state_tag;
+
+    // As for BasicSumVisitor, an unfinished chunked string is left out
+    void SaveState(StateWriter &writer) const
+    {
+        value.SaveState(writer);
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        value.LoadState(reader);
+    }
+
+    double GetValue() const
+    {
+        return value.GetValue();
+    }
+
+    // The accumulator, for the policies which can tell more about the
+    // product than its value as a double
+    const Policy& GetProduct() const
+    {
+        return value;
+    }
+
+    void Reset()
+    {
+        value = Policy{};
+        pending = Policy{};
+    }
+
+    ReductionMode GetMode() const
+    {
+        return mode;
+    }
+
+private:
+
+    // Through the digit index when it holds the product in Policy
+    void ProcessString(const StringElement& element)
+    {
+        if(const StringDigitIndex *index = element.GetDigitIndex())
+        {
+            if(const Policy *digits = index->template GetDigitProduct<Policy>())
+            {
+                value.Merge(*digits);
+                return;
+            }
+        }
+
+        ProcessStringView(element.GetView());
+    }
+
+    template<typename T>
+    void ProcessTypedArray(std::span<const T> values)
+    {
+        if constexpr(std::is_same_v<T, float> && std::is_same_v<Policy, NaiveProduct>)
+        {
+            value.Multiply(kernels::Product(values, mode));
+        }
+        else
+        {
+            const std::vector<double> widened(values.begin(), values.end());
+
+            value.Multiply(widened, mode);
+        }
+    }
+
+    Policy value;
+    Policy pending;     // digit product of an unfinished chunked string
+    ReductionMode mode;
+};
+
+using MultiplyVisitor = BasicMultiplyVisitor<>;
+
+
+// SumVisitor and MultiplyVisitor use the exact value of each single
+// element. The truncating visitors keep the original behaviour, where
+// a single element counts as its value truncated to an int, for code
+// which depends on it; arrays and strings are visited as before.
+class TruncatingSumVisitor : public SumVisitor
+{
+
+public:
+
+    using SumVisitor::SumVisitor;
+
+    ~TruncatingSumVisitor()
+    {
+        // I do nothing
+    }
+
+    void ProcessSingleElement(const SingleElement& element)
+    {
+        int v = element.GetValue();
+
+        Accumulate(v);
+    }
+
+    // In Reassociate mode the truncated values are summed exactly as
+    // integers and added to the result once
+    void ProcessSingleElements(std::span<const SingleElement> elements)
+    {
+        if(GetMode() == ReductionMode::Strict)
+        {
+            for(const SingleElement &element : elements)
+            {
+                ProcessSingleElement(element);
+            }
+
+            return;
+        }
+
+        long long sum = 0;
+
+        for(const SingleElement &element : elements)
+        {
+            sum += static_cast<int>(element.GetValue());
+        }
+
+        Accumulate(static_cast<double>(sum));
+    }
+
+};
+
+
+class TruncatingMultiplyVisitor : public MultiplyVisitor
+{
+
+public:
+
+    using MultiplyVisitor::MultiplyVisitor;
+
+    ~TruncatingMultiplyVisitor()
+    {
+        // I do nothing
+    }
+
+    void ProcessSingleElement(const SingleElement& element)
+    {
+        int v = element.GetValue();
+
+        Accumulate(v);
+    }
+
+    void ProcessSingleElements(std::span<const SingleElement> elements)
+    {
+        for(const SingleElement &element : elements)
+        {
+            int v = element.GetValue();
+
+            Accumulate(v);
+        }
+    }
+
+};
+
+class XORVisitor : public AbstractVisitor
+{
+
+public:
+
+    XORVisitor()
+        : value{0}
+        , pending{0}
+        , unsupported_count{0}
+    {
+    }
+
+    ~XORVisitor()
+    {
+        // I do nothing
+    }
+
+    // The checksum is defined for strings, and for the typed integer
+    // arrays visited directly. The arrays of the containers hold
+    // doubles, so traversals only give it strings.
+    static constexpr bool SupportsElementType(ElementType type)
+    {
+        return type == ElementType::String;
+    }
+
+    bool Supports(ElementType type) const
+    {
+        return SupportsElementType(type);
+    }
+
+    // Traversals skip the numeric element types using Supports. A
+    // numeric element passed here directly is counted as unsupported
+    // and leaves the checksum unchanged.
+    void ProcessSingleElement(const SingleElement& element)
+    {
+        ++ unsupported_count;
+    }
+
+    void ProcessSingleElements(std::span<const SingleElement> elements)
+    {
+        unsupported_count += elements.size();
+    }
+
+    void ProcessArrayElement(const ArrayElement& element)
+    {
+        ProcessArrayView(element.GetView());
+    }
+
+    void ProcessArrayElements(std::span<const ArrayElement> elements)
+    {
+        unsupported_count += elements.size();
+    }
+
+    void ProcessArrayView(std::span<const double> v)
+    {
+        ++ unsupported_count;
+    }
+
+    void ProcessArrayElementPool(const ArrayElementPool& pool)
+    {
+        unsupported_count += pool.Size();
+    }
+
+    // Float arrays are unsupported, as double arrays are: equal
+    // floating point values can have different bytes (0.0 and -0.0,
+    // NaN payloads), so a checksum of the bytes would not be one of
+    // the values
+    void ProcessArrayElement(const BasicArrayElement<float>& element)
+    {
+        ++ unsupported_count;
+    }
+
+    // The bytes of an integer are its value, so the checksum of an
+    // integer array is the XOR of the bytes of its values, computed by
+    // the string kernel
+    void ProcessArrayElement(const BasicArrayElement<std::int32_t>& element)
+    {
+        value ^= kernels::XorChecksum(AsBytes(element.GetView()));
+    }
+
+    void ProcessArrayElement(const BasicArrayElement<std::int64_t>& element)
+    {
+        value ^= kernels::XorChecksum(AsBytes(element.GetView()));
+    }
+
+    void ProcessStringElement(const StringElement& element)
+    {
+        value ^= Checksum(element);
+    }
+
+    void ProcessStringElements(std::span<const StringElement> elements)
+    {
+        for(const StringElement &element : elements)
+        {
+            value ^= Checksum(element);
+        }
+    }
+
+    void ProcessStringView(std::string_view v)
+    {
+        value ^= kernels::XorChecksum(v);
+    }
+
+    bool SupportsStringChunks() const
+    {
+        return true;
+    }
+
+    void ProcessStringChunk(std::string_view chunk)
+    {
+        pending ^= kernels::XorChecksum(chunk);
+    }
+
+    void FinishString()
+    {
+        value ^= pending;
+        pending = 0;
+    }
+
+    void Accumulate(unsigned char checksum)
+    {
+        value ^= checksum;
+    }
+
+    void Merge(const XORVisitor& other)
+    {
+        value ^= other.value;
+        unsupported_count += other.unsupported_count;
+    }
+
+    static constexpr std::uint32_t state_tag = 0x300;
+
+    void SaveState(StateWriter &writer) const
+    {
+        writer.WriteByte(value);
+        writer.WriteVarint(unsupported_count);
+    }
+
+    void LoadState(StateReader &reader)
+    {
+        value = reader.ReadByte();
+        unsupported_count = reader.ReadVarint();
+    }
+
+    unsigned char GetValue() const
+    {
+        return value;
+    }
+
+    // Number of elements passed directly to this visitor which it does
+    // not support
+    std::size_t GetUnsupportedCount() const
+    {
+        return unsupported_count;
+    }
+
+    void Reset()
+    {
+        value = 0;
+        pending = 0;
+        unsupported_count = 0;
+    }
+
+private:
+
+    static unsigned char Checksum(const StringElement& element)
+    {
+        if(const StringDigitIndex *index = element.GetDigitIndex())
+        {
+            return index->checksum;
+        }
+
+        return kernels::XorChecksum(element.GetView());
+    }
+
+    template<typename T>
+    static std::string_view AsBytes(std::span<const T> values)
+    {
+        return std::string_view(reinterpret_cast<const char*>(values.data()), values.size_bytes());
+    }
+
+    unsigned char value;
+    unsigned char pending;      // checksum of an unfinished chunked string
+    std::size_t unsupported_count;
+};
+
+#endif // VISITORS_H
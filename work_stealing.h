@@ -0,0 +1,475 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "elements.h"
+#include "visitors.h"
+#include "element_container.h"
+#include "parallel_visit.h"
+#include "visit_result.h"
+
+//////////////////////////////////////////////////////////////////////
+// Work-stealing scheduler
+//
+// Runs a batch of indexed tasks on a set of worker threads. Each worker
+// owns a deque of task indices, initially a contiguous range of the
+// batch chosen so that every worker starts with about the same total
+// cost. A worker pops tasks from the front of its own deque, and when
+// that is empty it steals from the back of another worker's deque, so
+// an underestimated cost on one worker is absorbed by the others.
+//
+// The deques are protected by one mutex each. Tasks are expected to
+// be coarse (see WorkStealingAccept), so the lock is uncontended
+// apart from steals.
+//////////////////////////////////////////////////////////////////////
+
+class WorkStealingScheduler
+{
+
+public:
+
+    explicit WorkStealingScheduler(std::size_t thread_count = std::thread::hardware_concurrency())
+        : queues(std::max<std::size_t>(thread_count, 1))
+        , generation{0}
+        , remaining{0}
+        , stopping{false}
+    {
+        threads.reserve(queues.size());
+
+        for(std::size_t worker = 0; worker < queues.size(); ++ worker)
+        {
+            threads.emplace_back([this, worker]() { Run(worker); });
+        }
+    }
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    ~WorkStealingScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for(std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    std::size_t Size() const
+    {
+        return threads.size();
+    }
+
+    // Run task(index) for every index in [0, costs.size()) and wait
+    // for all of them. costs only drives the initial distribution. If
+    // tasks throw, the exception of the lowest index is rethrown once
+    // the whole batch has finished. Batches must not overlap.
+    void Run(std::span<const std::size_t> costs, std::function<void(std::size_t)> task)
+    {
+        if(costs.empty())
+        {
+            return;
+        }
+
+        errors.assign(costs.size(), nullptr);
+
+        // A worker still looking for work from the previous batch may
+        // pick up a task as soon as it is queued, so the task must be
+        // in place first
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current_task = std::move(task);
+            remaining = costs.size();
+        }
+
+        Distribute(costs);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++ generation;
+        }
+
+        wake.notify_all();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this]() { return remaining == 0; });
+            current_task = nullptr;
+        }
+
+        for(std::exception_ptr &error : errors)
+        {
+            if(error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+private:
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    // Give each worker a contiguous range of tasks with about
+    // 1 / Size() of the total cost
+    void Distribute(std::span<const std::size_t> costs)
+    {
+        std::size_t total = 0;
+
+        for(std::size_t cost : costs)
+        {
+            total += cost;
+        }
+
+        std::size_t worker = 0;
+        std::size_t assigned = 0;
+
+        for(std::size_t index = 0; index < costs.size(); ++ index)
+        {
+            while(worker + 1 < queues.size() && assigned * queues.size() >= total * (worker + 1))
+            {
+                ++ worker;
+            }
+
+            std::lock_guard<std::mutex> lock(queues[worker].mutex);
+            queues[worker].tasks.push_back(index);
+
+            assigned += costs[index];
+        }
+    }
+
+    bool Pop(std::size_t worker, std::size_t &index)
+    {
+        WorkerQueue &queue = queues[worker];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if(queue.tasks.empty())
+        {
+            return false;
+        }
+
+        index = queue.tasks.front();
+        queue.tasks.pop_front();
+
+        return true;
+    }
+
+    bool Steal(std::size_t thief, std::size_t &index)
+    {
+        for(std::size_t offset = 1; offset < queues.size(); ++ offset)
+        {
+            WorkerQueue &queue = queues[(thief + offset) % queues.size()];
+
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if(!queue.tasks.empty())
+            {
+                index = queue.tasks.back();
+                queue.tasks.pop_back();
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Run(std::size_t worker)
+    {
+        std::size_t seen_generation = 0;
+
+        for(;;)
+        {
+            const std::function<void(std::size_t)> *task = nullptr;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                wake.wait(lock, [&]() { return stopping || generation != seen_generation; });
+
+                if(stopping)
+                {
+                    return;
+                }
+
+                seen_generation = generation;
+                task = &current_task;
+            }
+
+            // No new tasks are added during a batch, so once every
+            // deque is empty this worker is finished with it
+            std::size_t index;
+
+            while(Pop(worker, index) || Steal(worker, index))
+            {
+                try
+                {
+                    (*task)(index);
+                }
+                catch(...)
+                {
+                    errors[index] = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if(-- remaining == 0)
+                {
+                    done.notify_all();
+                }
+            }
+        }
+    }
+
+    std::vector<WorkerQueue> queues;
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors;
+
+    std::function<void(std::size_t)> current_task;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::size_t generation;
+    std::size_t remaining;
+    bool stopping;
+
+};
+
+
+//////////////////////////////////////////////////////////////////////
+// Byte-balanced parallel visitation
+//
+// WorkStealingAccept divides a container into tasks of about
+// grain_bytes of payload each, rather than by element count:
+//
+// - runs of small elements are grouped into one task
+// - an ArrayElement or StringElement larger than grain_bytes is split
+//   into sub-ranges, visited through ProcessArrayView and
+//   ProcessStringView, when the visitor allows it
+//
+// Each task is visited by its own reset clone of the visitor, and the
+// clones are merged in task order. The task boundaries only depend on
+// the container and grain_bytes, so the result is identical whatever
+// the number of threads and however the tasks were stolen.
+//////////////////////////////////////////////////////////////////////
+
+// Whether a visitor's result over a payload equals the Merge of its
+// results over consecutive sub-ranges of the payload. This holds for
+// the built-in reductions: sums, products and XOR checksums of the
+// parts combine into those of the whole (up to floating point
+// association). Other visitors are only given whole elements.
+template<typename Visitor>
+struct SplittablePayloads : std::false_type {};
+
+template<typename Policy>
+struct SplittablePayloads<BasicSumVisitor<Policy>> : std::true_type {};
+
+template<typename Policy>
+struct SplittablePayloads<BasicMultiplyVisitor<Policy>> : std::true_type {};
+
+template<>
+struct SplittablePayloads<XORVisitor> : std::true_type {};
+
+template<>
+struct SplittablePayloads<TruncatingSumVisitor> : std::true_type {};
+
+template<>
+struct SplittablePayloads<TruncatingMultiplyVisitor> : std::true_type {};
+
+
+namespace detail
+{
+
+enum class TaskKind
+{
+    SingleElements,     // whole elements [first, last)
+    ArrayElements,      // whole elements [first, last)
+    StringElements,     // whole elements [first, last)
+    ArrayRange,         // values [first, last) of array element
+    StringRange         // bytes [first, last) of string element
+};
+
+struct VisitTask
+{
+    TaskKind kind;
+    std::size_t element;
+    std::size_t first;
+    std::size_t last;
+    std::size_t cost;
+};
+
+// Group whole elements into tasks of about grain_bytes each, and split
+// elements larger than grain_bytes into ranges when allowed
+template<typename Element, typename Size>
+void MakeTasks(std::span<const Element> elements, TaskKind whole_kind, TaskKind range_kind,
+    std::size_t unit_bytes, std::size_t grain_bytes, bool split, Size size,
+    std::vector<VisitTask> &tasks)
+{
+    std::size_t group_begin = 0;
+    std::size_t group_cost = 0;
+
+    auto flush = [&](std::size_t end)
+    {
+        if(end > group_begin)
+        {
+            tasks.push_back(VisitTask{whole_kind, 0, group_begin, end, group_cost});
+        }
+
+        group_begin = end;
+        group_cost = 0;
+    };
+
+    const std::size_t grain_units = std::max<std::size_t>(grain_bytes / unit_bytes, 1);
+
+    for(std::size_t index = 0; index < elements.size(); ++ index)
+    {
+        const std::size_t units = size(elements[index]);
+        const std::size_t cost = std::max<std::size_t>(units * unit_bytes, 1);
+
+        if(split && units > grain_units)
+        {
+            flush(index);
+
+            for(std::size_t first = 0; first < units; first += grain_units)
+            {
+                std::size_t last = std::min(first + grain_units, units);
+
+                tasks.push_back(VisitTask{range_kind, index, first, last, (last - first) * unit_bytes});
+            }
+
+            group_begin = index + 1;
+            continue;
+        }
+
+        group_cost += cost;
+
+        if(group_cost >= grain_bytes)
+        {
+            flush(index + 1);
+        }
+    }
+
+    flush(elements.size());
+}
+
+} // namespace detail
+
+
+template<MergeableVisitor Visitor>
+VisitResult WorkStealingAccept(const ElementContainer &container, Visitor &visitor,
+    WorkStealingScheduler &scheduler, std::size_t grain_bytes = 64 * 1024)
+{
+    using detail::TaskKind;
+    using detail::VisitTask;
+
+    constexpr bool split = SplittablePayloads<Visitor>::value;
+
+    std::span<const SingleElement> singles = container.GetSingleElements();
+    std::span<const ArrayElement> arrays = container.GetArrayElements();
+    std::span<const StringElement> strings = container.GetStringElements();
+
+    VisitResult result;
+    std::vector<VisitTask> tasks;
+
+    // Unsupported element types are skipped and counted, no tasks are
+    // made for them
+    auto make_tasks = [&](ElementType type, auto elements, TaskKind whole_kind, TaskKind range_kind,
+        std::size_t unit_bytes, bool split_elements, auto size)
+    {
+        if(VisitorSupports(visitor, type))
+        {
+            detail::MakeTasks(elements, whole_kind, range_kind, unit_bytes, grain_bytes, split_elements, size, tasks);
+            result.AddVisited(elements.size());
+        }
+        else
+        {
+            result.AddSkipped(elements.size());
+        }
+    };
+
+    make_tasks(ElementType::Single, singles, TaskKind::SingleElements, TaskKind::SingleElements,
+        sizeof(double), false,
+        [](const SingleElement&) { return std::size_t{1}; });
+
+    make_tasks(ElementType::Array, arrays, TaskKind::ArrayElements, TaskKind::ArrayRange,
+        sizeof(double), split,
+        [](const ArrayElement &element) { return element.GetView().size(); });
+
+    make_tasks(ElementType::String, strings, TaskKind::StringElements, TaskKind::StringRange,
+        sizeof(char), split,
+        [](const StringElement &element) { return element.GetView().size(); });
+
+    std::vector<std::size_t> costs;
+    costs.reserve(tasks.size());
+
+    for(const VisitTask &task : tasks)
+    {
+        costs.push_back(task.cost);
+    }
+
+    std::vector<Visitor> partials(tasks.size(), detail::CloneVisitor(visitor));
+
+    scheduler.Run(costs,
+        [&](std::size_t index)
+        {
+            const VisitTask &task = tasks[index];
+            Visitor &partial = partials[index];
+
+            switch(task.kind)
+            {
+                case TaskKind::SingleElements:
+                    partial.ProcessSingleElements(singles.subspan(task.first, task.last - task.first));
+                    break;
+
+                case TaskKind::ArrayElements:
+                    partial.ProcessArrayElements(arrays.subspan(task.first, task.last - task.first));
+                    break;
+
+                case TaskKind::StringElements:
+                    partial.ProcessStringElements(strings.subspan(task.first, task.last - task.first));
+                    break;
+
+                case TaskKind::ArrayRange:
+                    partial.ProcessArrayView(
+                        arrays[task.element].GetView().subspan(task.first, task.last - task.first));
+                    break;
+
+                case TaskKind::StringRange:
+                    partial.ProcessStringView(
+                        strings[task.element].GetView().substr(task.first, task.last - task.first));
+                    break;
+            }
+        });
+
+    for(const Visitor &partial : partials)
+    {
+        visitor.Merge(partial);
+    }
+
+    return result;
+}
+
+#endif // WORK_STEALING_H